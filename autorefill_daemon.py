@@ -16,34 +16,135 @@ Usage:
 
     # Run on Raspberry Pi with auto-start
     sudo python3 autorefill_daemon.py /dev/ttyUSB0 --daemon
+
+    # Several stations from one daemon
+    python3 autorefill_daemon.py /dev/ttyUSB0 /dev/ttyUSB1
+
+While running, the daemon owns the bridges and serves a local control
+socket (see stratatools/helper/control_socket.py); the GUI and the
+console tools go through it instead of opening the serial port.
+
+With --index the daemon keeps a record of every cartridge it has seen
+(machine type, image hash, refill count) and can replicate it with other
+stations (--listen/--peer, see stratatools/helper/cartridge_index.py),
+so a cartridge refilled at one station takes the fast path at any other.
+
+With --metadata the daemon also keeps the machine type, refill count and
+a digest of the record in the cartridge's last EEPROM page (see
+stratatools/helper/station_metadata.py). Any station then finds the
+machine type on the cartridge itself, without an index or a trial decode.
+
+Each refill cycle is timed phase by phase (detect, read, decode, encode,
+write, verify) along with the bridge's own command timings; the GUI's
+Advanced tab shows them per station (see
+stratatools/helper/cycle_timeline.py).
+
+Cartridges inserted while the daemon is down or the USB link is out are
+not lost: on (re)connect the daemon fetches the events the firmware
+recorded meanwhile and picks up a cartridge still waiting in the socket.
 """
 
+import copy
+import hashlib
+import queue
 import serial
+import socket
 import time
 import sys
 import argparse
 import logging
+import threading
 from datetime import datetime
 
-from stratatools.helper.esp32_bridge import ESP32Bridge
-from stratatools.manager import Manager
+from stratatools.helper.esp32_bridge import ESP32Bridge, CONTACT_POOR_SCORE
+from stratatools.helper.control_socket import ControlServer, DEFAULT_SOCKET_PATH, UNIX_SOCKETS
+from stratatools.helper.cartridge_index import CartridgeIndex, IndexReplicator
+from stratatools.helper.cycle_timeline import CycleTimeline, Cycle
+from stratatools.helper.pico_station import PicoStation, split_port, expand_ports
+from stratatools.helper import station_metadata
+from stratatools.helper.station_metadata import StationMetadata, METADATA_ADDRESS, METADATA_SIZE
+from stratatools.manager import Manager, QUANTITY_BLOCK_START, QUANTITY_BLOCK_END
 from stratatools.crypto import Desx_Crypto
 from stratatools.checksum import Crc16_Checksum
 from stratatools import machine, cartridge_pb2
 from google.protobuf.timestamp_pb2 import Timestamp
 
+# Seconds between attempts to reopen a bridge that went away
+RECONNECT_INTERVAL = 2.0
 
-class AutoRefillDaemon:
-    """Monitors ESP32 and auto-refills cartridges"""
 
-    def __init__(self, port, machine_type='prodigy', threshold=10.0, auto_detect=False):
+class RefillWorker:
+    """
+    Runs the refills of one port, one after another, on its own thread
+
+    Refills on different bridges (or sockets of one station) run side by
+    side. A lost link is handed back to the daemon's main loop, which owns
+    disconnects and reconnects.
+    """
+
+    def __init__(self, daemon, port):
+        self.daemon = daemon
         self.port = port
+        self.pending = queue.Queue()
+        self.thread = threading.Thread(target=self._run, name=f"refill {port}", daemon=True)
+        self.thread.start()
+
+    def submit(self, bridge, rom_address):
+        self.pending.put((bridge, rom_address))
+
+    def _run(self):
+        while True:
+            bridge, rom_address = self.pending.get()
+            try:
+                self.daemon.process_cartridge(self.port, bridge, rom_address)
+            except (serial.SerialException, OSError) as e:
+                self.daemon.link_failures.put((self.port, bridge, e))
+            except Exception:
+                self.daemon.log.exception(f"Refill worker for {self.port} failed")
+
+
+class AutoRefillDaemon:
+    """Monitors ESP32 bridges and auto-refills cartridges"""
+
+    def __init__(self, ports, machine_type='prodigy', threshold=10.0, auto_detect=False,
+                 socket_path=DEFAULT_SOCKET_PATH, index=None, replicator=None,
+                 metadata=False, station=None):
+        if isinstance(ports, str):
+            ports = [ports]
+        self.ports = ports
         self.machine_type = machine_type
         self.threshold = threshold
         self.auto_detect = auto_detect
-        self.bridge = None
+        self.socket_path = socket_path
+        self.bridges = {}
+        self.pico_stations = {}
         self.manager = Manager(Desx_Crypto(), Crc16_Checksum())
         self.running = False
+        self.server = None
+
+        # Cartridge index (optional), replicated with other stations
+        self.index = index
+        self.replicator = replicator
+
+        # Phase timings of every refill cycle, served to the GUI
+        self.timeline = CycleTimeline()
+
+        # Station metadata on the cartridge (optional)
+        self.metadata = metadata
+        self.station = station or (index.station if index else socket.gethostname())
+
+        # One lock per bridge: the refill loop and socket clients take
+        # turns on the serial link
+        self.locks = {port: threading.RLock() for port in ports}
+        self.stations = {port: {"connected": False, "rom": None, "refills": 0, "last_result": None,
+                                "event_seq": 0, "boot_id": None}
+                         for port in ports}
+
+        # Guards self.bridges and self.stations, which the main loop, the
+        # refill workers and socket clients share
+        self.state_lock = threading.Lock()
+        self.workers = {}
+        self.link_failures = queue.Queue()
 
         # Setup logging
         logging.basicConfig(
@@ -53,68 +154,346 @@ class AutoRefillDaemon:
         )
         self.log = logging.getLogger(__name__)
 
-    def connect(self):
-        """Connect to ESP32 device"""
+    def connect(self, ports=None):
+        """Connect to ESP32 devices (default: all), returns True if any connected"""
+        for port in ports or self.ports:
+            try:
+                self.log.info(f"Connecting to {port}...")
+                device, socket_number = split_port(port)
+                if socket_number is None:
+                    bridge = ESP32Bridge(port, timeout=5)
+                else:
+                    bridge = self.open_station(device).socket(socket_number)
+
+                if not bridge.initialize():
+                    bridge.close()
+                    raise Exception("Failed to initialize bridge")
+
+                # Resume the event stream where the last connection left off
+                bridge.boot_id = self.stations[port]["boot_id"]
+                bridge.event_seq = self.stations[port]["event_seq"]
+                self.catch_up(port, bridge)
+
+                with self.state_lock:
+                    self.bridges[port] = bridge
+                    self.stations[port]["connected"] = True
+                self.log.info(f"Connected to auto-refill device on {port}")
+            except Exception as e:
+                self.log.error(f"Connection to {port} failed: {e}")
+
+        return len(self.bridges) > 0
+
+    def open_station(self, device):
+        """Link to a multi-socket station, shared by all its sockets"""
+        station = self.pico_stations.get(device)
+        if station is None or station.closed:
+            station = PicoStation(device, timeout=5)
+            self.pico_stations[device] = station
+        return station
+
+    def disconnect(self, port):
+        """Drop a bridge whose link failed; run() reopens it"""
+        with self.state_lock:
+            bridge = self.bridges.pop(port)
+            self.stations[port]["connected"] = False
+            self.stations[port]["event_seq"] = bridge.event_seq
+            self.stations[port]["boot_id"] = bridge.boot_id
         try:
-            self.log.info(f"Connecting to {self.port}...")
-            self.bridge = ESP32Bridge(self.port, timeout=5)
+            bridge.close()
+        except Exception:
+            pass
 
-            if not self.bridge.initialize():
-                raise Exception("Failed to initialize bridge")
+    def catch_up(self, port, bridge):
+        """
+        Replay events the firmware recorded while nobody was listening
 
-            self.log.info("Connected to auto-refill device")
-            return True
-        except Exception as e:
-            self.log.error(f"Connection failed: {e}")
-            return False
+        Only a cartridge still waiting for the daemon is queued: one that
+        was removed again, or already got a refill result, is skipped.
+        """
+        pending = None
+        replayed = bridge.catch_up_events()
+
+        for event in replayed:
+            if event.startswith("CARTRIDGE_INSERTED:"):
+                pending = event
+            elif event.startswith(("CARTRIDGE_REMOVED:", "REFILL_DONE", "ERROR")):
+                pending = None
+
+        if replayed:
+            self.log.info(f"Caught up on {len(replayed)} event(s) from {port}")
+        if pending:
+            self.log.info(f"Cartridge waiting on {port}: {pending.split(':')[1]}")
+            bridge.events.append(pending)
+
+    def start_server(self):
+        """Serve the control socket for GUI and console clients"""
+        if not self.socket_path or not UNIX_SOCKETS:
+            return
+
+        try:
+            self.server = ControlServer(self, self.socket_path).start()
+            self.log.info(f"Control socket: {self.socket_path}")
+        except OSError as e:
+            self.log.warning(f"Control socket unavailable: {e}")
+
+    def publish(self, port, event):
+        """Forward an event to control socket subscribers"""
+        if self.server:
+            self.server.publish(port, event)
+
+    def handle_request(self, request):
+        """Serve one control socket request (see control_socket.py)"""
+        op = request.get("op")
+
+        if op == "ping":
+            return {}
+
+        if op == "status":
+            with self.state_lock:
+                for port, bridge in self.bridges.items():
+                    self.stations[port]["event_seq"] = bridge.event_seq
+                    self.stations[port]["boot_id"] = bridge.boot_id
+                return {"ports": copy.deepcopy(self.stations)}
+
+        with self.state_lock:
+            bridges = dict(self.bridges)
+
+        if op == "timeline":
+            # Commands the bridges timed since their last cycle, from
+            # those not busy right now
+            for port, bridge in bridges.items():
+                if self.locks[port].acquire(blocking=False):
+                    try:
+                        self.pull_trace(port, bridge)
+                    finally:
+                        self.locks[port].release()
+            return {"timeline": self.timeline.to_dict()}
+
+        port = request.get("port")
+        if port is None and len(bridges) == 1:
+            port = next(iter(bridges))
+
+        bridge = bridges.get(port)
+        if bridge is None:
+            raise Exception(f"Port not owned by daemon: {port}")
+
+        with self.locks[port]:
+            if op == "reset":
+                return {"result": bridge.onewire_reset_bus()}
+
+            if op == "search":
+                rom = bridge.onewire_macro_search()
+                if rom is None:
+                    raise Exception("No device found")
+                return {"rom": rom}
+
+            if op == "read":
+                data = bridge.onewire_read(int(request.get("length", 512)), int(request.get("address", 0)))
+                if data is None:
+                    raise Exception("Failed to read EEPROM")
+                return {"data": data.hex()}
+
+            if op == "write":
+                return {"result": bridge.onewire_write(bytes.fromhex(request["data"]))}
+
+            if op == "debug":
+                return {"output": bridge.debug()}
+
+            if op == "job":
+                pending = bridge.queue_job(request["rom"], bytes.fromhex(request["data"]))
+                if pending is None:
+                    raise Exception("Job rejected")
+                return {"pending": pending}
+
+            if op == "jobs":
+                pending, completed = bridge.job_status()
+                return {"pending": pending, "completed": completed}
+
+            if op == "clear_jobs":
+                return {"result": bridge.clear_jobs()}
+
+            if op == "results":
+                return {"results": bridge.job_results()}
+
+            if op == "backups":
+                result = bridge.job_backups(int(request.get("since", 0)))
+                if result is None:
+                    return {"backups": None}
+                last_seq, records = result
+                return {"backups": [last_seq, [[seq, millis, rom, image.hex()]
+                                               for seq, millis, rom, image in records]]}
+
+            if op == "contact":
+                return {"contact": bridge.contact_quality()}
+
+            if op == "stats":
+                return {"stats": bridge.stats()}
+
+            if op == "trace":
+                return {"trace": bridge.trace(int(request.get("since", 0)))}
+
+        raise Exception(f"Unknown operation: {op}")
+
+    def _report(self, port, bridge, status):
+        """Tell the device and socket subscribers how a refill ended"""
+        bridge.notify_status(status)
+        with self.state_lock:
+            self.stations[port]["last_result"] = status
+        self.publish(port, status)
+
+    def candidate_machine_types(self, rom_address=None, known=None):
+        """Machine types to try, in order (the known or indexed one first)"""
+        if self.auto_detect:
+            types = list(machine.get_machine_types())
+        else:
+            types = [self.machine_type]
+
+        if not known and self.index and rom_address:
+            known = self.index.machine_type(rom_address)
+        if known:
+            types = [known] + [t for t in types if t != known]
+        return types
+
+    def remember(self, rom_address, machine_type, image=None, refilled=False):
+        """Update the cartridge index, if there is one"""
+        if not self.index:
+            return
+        image_hash = hashlib.sha256(bytes(image)).hexdigest() if image is not None else None
+        self.index.record(rom_address, machine_type, image_hash, refilled)
+
+    def decode_any(self, rom_address, data, machine_types):
+        """
+        Decode with the first machine type that works
+
+        The likeliest type is tried alone; the others go in one batch,
+        which the native codec decrypts in parallel outside the GIL.
+
+        Returns:
+            (cartridge, machine_type), (None, None) if no type works
+        """
+        eeprom_uid = bytes.fromhex(rom_address)
+        results = []
+
+        for batch in (machine_types[:1], machine_types[1:]):
+            items = [(machine.get_number_from_type(mtype), eeprom_uid, data) for mtype in batch]
+            results += self.manager.decode_batch(items)
+
+            for mtype, result in zip(machine_types, results):
+                if not isinstance(result, Exception):
+                    self.log.info(f"Decoded successfully with machine type: {mtype}")
+                    return (result, mtype)
+
+        # Without auto-detect, report why the configured type failed
+        if not self.auto_detect and results:
+            raise results[-1]
+        return (None, None)
+
+    def read_metadata(self, bridge, rom_address):
+        """Station metadata from the cartridge, None if off or missing"""
+        if not self.metadata or not station_metadata.fits(rom_address):
+            return None
+
+        block = bridge.onewire_read(METADATA_SIZE, METADATA_ADDRESS)
+        if not block:
+            return None
+
+        meta = StationMetadata.unpack(bytes.fromhex(rom_address), block)
+        if meta:
+            self.log.info(f"Station metadata: {meta.machine_type}, {meta.refills} refill(s), "
+                          f"last by {meta.station or 'unknown'}")
+        return meta
+
+    def read_quantity(self, bridge, rom_address, known=None):
+        """
+        Fast threshold check: read and decrypt only the quantity block
+
+        Args:
+            known: Machine type to try first (from station metadata)
+
+        Returns:
+            (quantity, machine_type), or (None, None) if it can't be decoded
+        """
+        block = bridge.onewire_read(QUANTITY_BLOCK_END - QUANTITY_BLOCK_START, QUANTITY_BLOCK_START)
+        if not block:
+            return (None, None)
+
+        eeprom_uid = bytes.fromhex(rom_address)
+        for mtype in self.candidate_machine_types(rom_address, known):
+            try:
+                machine_number = machine.get_number_from_type(mtype)
+                return (self.manager.decode_quantity(machine_number, eeprom_uid, block), mtype)
+            except Exception:
+                continue
+
+        return (None, None)
+
+    def refill_cartridge(self, rom_address, port=None, bridge=None):
+        """
+        Read, refill, and write back cartridge
+
+        Raises:
+            serial.SerialException, OSError: the link to the bridge failed
+            (no result is sent to it)
+        """
+        port = port or self.ports[0]
+        if bridge is None:
+            with self.state_lock:
+                bridge = self.bridges.get(port)
+            if bridge is None:
+                self.log.error(f"Refill skipped, {port} is not connected")
+                return False
+        cycle = Cycle(port, rom_address)
 
-    def refill_cartridge(self, rom_address):
-        """Read, refill, and write back cartridge"""
         try:
             self.log.info(f"Processing cartridge {rom_address}")
 
             # Notify device we're starting
-            self.bridge.serial.write(b'REFILLING\n')
+            bridge.notify_status('REFILLING')
 
             # Reset bus before operations
             time.sleep(0.3)
-            self.bridge.onewire_reset_bus()
+            with cycle.phase("detect"):
+                bridge.onewire_reset_bus()
             time.sleep(0.3)
 
             # Search to ensure device is still there
-            found_rom = self.bridge.onewire_macro_search()
+            with cycle.phase("detect"):
+                found_rom = bridge.onewire_macro_search()
             if not found_rom or found_rom != rom_address:
                 raise Exception("Cartridge removed or ROM mismatch")
 
+            with cycle.phase("read"):
+                # The machine type may be on the cartridge itself
+                meta = self.read_metadata(bridge, rom_address)
+                known_machine_type = meta.machine_type if meta else None
+
+                # Most cartridges don't need a refill: check the quantity
+                # block alone before reading and decoding the whole EEPROM
+                quantity, quantity_machine_type = self.read_quantity(bridge, rom_address, known_machine_type)
+            if quantity is not None and quantity >= self.threshold:
+                self.log.info(f"Current: {quantity:.2f} cu.in (machine type: {quantity_machine_type})")
+                self.log.info(f"Cartridge above threshold ({self.threshold:.2f} cu.in)")
+                self.log.info("No refill needed")
+                self.remember(rom_address, quantity_machine_type)
+                self._report(port, bridge, 'REFILL_DONE:NO_REFILL_NEEDED')
+                return False
+
             # Read EEPROM
             self.log.info("Reading EEPROM...")
-            data = self.bridge.onewire_read(512)
+            with cycle.phase("read"):
+                data = bridge.onewire_read(512)
             if not data:
                 raise Exception("Failed to read EEPROM")
 
-            # Try to decode with specified machine type
-            machine_types = [self.machine_type]
-
-            # If auto-detect enabled, try all types
-            if self.auto_detect:
-                machine_types = list(machine.get_machine_types())
-
-            cartridge = None
-            working_machine_type = None
+            # Try to decode with specified machine type (or all types if
+            # auto-detect is enabled), the one found by the fast path first
+            machine_types = self.candidate_machine_types(rom_address, known_machine_type)
+            if quantity_machine_type:
+                machine_types.remove(quantity_machine_type)
+                machine_types.insert(0, quantity_machine_type)
 
-            for mtype in machine_types:
-                try:
-                    machine_number = machine.get_number_from_type(mtype)
-                    eeprom_uid = bytes.fromhex(rom_address)
-
-                    cartridge = self.manager.decode(machine_number, eeprom_uid, bytearray(data))
-                    working_machine_type = mtype
-                    self.log.info(f"Decoded successfully with machine type: {mtype}")
-                    break
-                except Exception as e:
-                    if not self.auto_detect:
-                        raise
-                    continue
+            with cycle.phase("decode"):
+                cartridge, working_machine_type = self.decode_any(rom_address, data, machine_types)
 
             if not cartridge:
                 raise Exception("Failed to decode with any machine type")
@@ -140,7 +519,8 @@ class AutoRefillDaemon:
             if current >= self.threshold:
                 self.log.info(f"Cartridge above threshold ({self.threshold:.2f} cu.in)")
                 self.log.info("No refill needed")
-                self.bridge.serial.write(b'REFILL_DONE:NO_REFILL_NEEDED\n')
+                self.remember(rom_address, working_machine_type, data)
+                self._report(port, bridge, 'REFILL_DONE:NO_REFILL_NEEDED')
                 return False
 
             # Perform refill
@@ -155,17 +535,38 @@ class AutoRefillDaemon:
             now.GetCurrentTime()
             cartridge.last_use_date.CopyFrom(now)
 
+            # A write through a poor contact tends to fail part way; ask
+            # for a reseat before starting one
+            contact = bridge.contact_quality()
+            if contact and contact["score"] < CONTACT_POOR_SCORE:
+                raise Exception(f"Poor contact (score {contact['score']}), reseat cartridge")
+
             # Encode cartridge
             self.log.info("Encoding cartridge...")
-            machine_number = machine.get_number_from_type(working_machine_type)
-            eeprom_uid = bytes.fromhex(rom_address)
-            encoded = self.manager.encode(machine_number, eeprom_uid, cartridge)
+            with cycle.phase("encode"):
+                machine_number = machine.get_number_from_type(working_machine_type)
+                eeprom_uid = bytes.fromhex(rom_address)
+                encoded = self.manager.encode(machine_number, eeprom_uid, cartridge)
+
+                # Metadata goes in the same write: with delta writes only
+                # its page is added to the record's own
+                if (self.metadata and station_metadata.fits(rom_address)
+                        and len(data) >= METADATA_ADDRESS + METADATA_SIZE):
+                    if meta and not meta.matches(data):
+                        self.log.info("Cartridge was used since its last refill")
+                    meta = StationMetadata.for_refill(meta, working_machine_type, self.station, encoded)
+                    image = bytearray(data)
+                    image[:len(encoded)] = encoded
+                    image[METADATA_ADDRESS:METADATA_ADDRESS + METADATA_SIZE] = meta.pack(eeprom_uid)
+                    encoded = image
 
             # Write to EEPROM
             self.log.info("Writing to EEPROM...")
             time.sleep(0.5)
 
-            if not self.bridge.onewire_write(bytes(encoded)):
+            with cycle.phase("write"):
+                written = bridge.onewire_write(bytes(encoded))
+            if not written:
                 raise Exception("Write failed")
 
             # Wait for EEPROM to commit
@@ -173,71 +574,91 @@ class AutoRefillDaemon:
 
             # Verify
             self.log.info("Verifying write...")
-            verify_data = self.bridge.onewire_read(512)
+            with cycle.phase("verify"):
+                verify_data = bridge.onewire_read(512)
+                verified = verify_data and bytes(verify_data) == bytes(encoded)
 
-            if verify_data and bytes(verify_data) == bytes(encoded):
+            if verified:
                 self.log.info("✓ REFILL SUCCESSFUL!")
                 self.log.info(f"New quantity: {cartridge.current_material_quantity:.2f} cu.in (100%)")
-                self.bridge.serial.write(b'REFILL_DONE:SUCCESS\n')
+                with self.state_lock:
+                    self.stations[port]["refills"] += 1
+                self.remember(rom_address, working_machine_type, encoded, refilled=True)
+                self._report(port, bridge, 'REFILL_DONE:SUCCESS')
                 return True
             else:
                 raise Exception("Verification failed")
 
+        except (serial.SerialException, OSError):
+            cycle.result = "ERROR:Link lost"
+            raise
+
         except Exception as e:
             self.log.error(f"Refill failed: {e}")
-            self.bridge.serial.write(f'ERROR:{str(e)}\n'.encode())
+            self._report(port, bridge, f'ERROR:{str(e)}')
             return False
 
+        finally:
+            if cycle.result is None:
+                with self.state_lock:
+                    cycle.result = self.stations[port]["last_result"]
+            self.timeline.add(cycle)
+            self.pull_trace(port, bridge)
+
+    def pull_trace(self, port, bridge):
+        """Keep the bridge's own timings of the cycle that just ended"""
+        try:
+            self.timeline.pull(port, bridge)
+        except Exception as e:
+            self.log.debug(f"No timings from {port}: {e}")
+
     def run(self):
         """Main daemon loop"""
         self.log.info("=" * 60)
         self.log.info("Stratasys Auto-Refill Daemon v1.0")
         self.log.info("=" * 60)
-        self.log.info(f"Port: {self.port}")
+        self.log.info(f"Ports: {', '.join(self.ports)}")
         self.log.info(f"Machine type: {self.machine_type}")
         self.log.info(f"Auto-detect: {'Enabled' if self.auto_detect else 'Disabled'}")
         self.log.info(f"Threshold: {self.threshold:.2f} cu.in")
+        if self.index:
+            self.log.info(f"Cartridge index: {self.index.path} ({len(self.index.entries)} cartridges)")
         self.log.info("=" * 60)
         self.log.info("")
 
         if not self.connect():
             return False
 
+        self.start_server()
+        if self.replicator:
+            self.replicator.start()
+
         self.running = True
         self.log.info("Monitoring for cartridges...")
         self.log.info("Press Ctrl+C to stop")
         self.log.info("")
 
+        last_reconnect = time.time()
+
         try:
             while self.running:
-                # Read from device
-                if self.bridge.serial.in_waiting:
-                    line = self.bridge.serial.readline().decode('ascii', errors='ignore').strip()
-
-                    # Check for cartridge insertion notification
-                    if line.startswith("CARTRIDGE_INSERTED:"):
-                        rom_address = line.split(':')[1].strip()
-                        self.log.info("")
-                        self.log.info("*" * 60)
-                        self.log.info("CARTRIDGE DETECTED!")
-                        self.log.info("*" * 60)
-                        self.log.info("")
-
-                        # Wait a moment for cartridge to settle
-                        time.sleep(1)
-
-                        # Process refill
-                        self.refill_cartridge(rom_address)
+                self.drop_failed_links()
 
-                        self.log.info("")
-                        self.log.info("Waiting for next cartridge...")
-                        self.log.info("")
+                missing = [port for port in self.ports if port not in self.bridges]
+                if missing and time.time() - last_reconnect > RECONNECT_INTERVAL:
+                    last_reconnect = time.time()
+                    self.connect(missing)
 
-                    # Echo other messages
-                    elif line and not line.startswith("Waiting"):
-                        self.log.debug(f"Device: {line}")
+                if not self.bridges:
+                    time.sleep(0.1)
+                    continue
 
-                time.sleep(0.1)
+                for port, bridge in list(self.bridges.items()):
+                    try:
+                        self.poll(port, bridge)
+                    except (serial.SerialException, OSError) as e:
+                        self.log.error(f"Lost connection to {port}: {e}")
+                        self.disconnect(port)
 
         except KeyboardInterrupt:
             self.log.info("")
@@ -245,11 +666,87 @@ class AutoRefillDaemon:
             self.running = False
 
         finally:
-            if self.bridge:
-                self.bridge.close()
+            if self.server:
+                self.server.close()
+            if self.replicator:
+                self.replicator.close()
+            for bridge in self.bridges.values():
+                bridge.close()
 
         return True
 
+    def drop_failed_links(self):
+        """Disconnect the bridges whose refill worker lost the link"""
+        while True:
+            try:
+                port, bridge, error = self.link_failures.get_nowait()
+            except queue.Empty:
+                return
+
+            # Already dropped (and maybe reopened) by the main loop
+            if self.bridges.get(port) is bridge:
+                self.log.error(f"Lost connection to {port}: {error}")
+                self.disconnect(port)
+
+    def poll(self, port, bridge):
+        """Handle the next notification from one bridge, if any"""
+        # A bridge whose lock is taken is busy with a refill or a socket
+        # client; its events wait until it is free
+        if not self.locks[port].acquire(blocking=False):
+            return
+
+        # Wait for a notification from the device; with channel
+        # framing these arrive on the event channel even while
+        # other output is in flight
+        try:
+            event = bridge.next_event(timeout=0.1 / len(self.bridges))
+        finally:
+            self.locks[port].release()
+
+        if not event:
+            return
+
+        self.publish(port, event)
+
+        # Check for cartridge insertion notification
+        if event.startswith("CARTRIDGE_INSERTED:"):
+            rom_address = event.split(':')[1].strip()
+            with self.state_lock:
+                self.stations[port]["rom"] = rom_address
+            self.log.info("")
+            self.log.info("*" * 60)
+            self.log.info(f"CARTRIDGE DETECTED on {port}!")
+            self.log.info("*" * 60)
+            self.log.info("")
+
+            worker = self.workers.get(port)
+            if worker is None:
+                worker = self.workers[port] = RefillWorker(self, port)
+            worker.submit(bridge, rom_address)
+
+        elif event.startswith("CARTRIDGE_REMOVED:"):
+            with self.state_lock:
+                self.stations[port]["rom"] = None
+
+        else:
+            self.log.debug(f"Device event: {event}")
+
+    def process_cartridge(self, port, bridge, rom_address):
+        """Refill on the port's worker, holding the bridge for the whole cycle"""
+        with self.locks[port]:
+            # The link was dropped (and maybe reopened) since the insertion
+            if self.bridges.get(port) is not bridge:
+                return
+
+            # Wait a moment for cartridge to settle
+            time.sleep(1)
+
+            self.refill_cartridge(rom_address, port, bridge)
+
+        self.log.info("")
+        self.log.info(f"Waiting for next cartridge on {port}...")
+        self.log.info("")
+
 
 def main():
     parser = argparse.ArgumentParser(
@@ -261,13 +758,21 @@ Examples:
   python3 autorefill_daemon.py COM3 --machine prodigy
   python3 autorefill_daemon.py /dev/ttyUSB0 --threshold 15.0 --auto-detect
   sudo python3 autorefill_daemon.py /dev/ttyUSB0 --daemon
+  python3 autorefill_daemon.py /dev/ttyUSB0 /dev/ttyUSB1 --socket /run/stratatools.sock
+  python3 autorefill_daemon.py /dev/ttyUSB0 --index cartridges.json --listen 0.0.0.0:7600 --peer station-b:7600
+  python3 autorefill_daemon.py /dev/ttyACM0#0-7
+  python3 autorefill_daemon.py /dev/ttyUSB0 --auto-detect --metadata
+
+Ports:
+  <port>#<n> is socket n of a Pico 2 multi-socket station, <port>#0-7 all eight
 
 Machine Types:
   fox, prodigy, quantum, uprint, uprintse, dimension, fortus
         """
     )
 
-    parser.add_argument('port', help='Serial port (e.g., /dev/cu.usbserial-0001, COM3)')
+    parser.add_argument('ports', nargs='+', metavar='port',
+                        help='Serial port(s) (e.g., /dev/cu.usbserial-0001, COM3)')
     parser.add_argument('-m', '--machine', default='prodigy',
                         help='Machine type (default: prodigy)')
     parser.add_argument('-t', '--threshold', type=float, default=10.0,
@@ -276,6 +781,16 @@ Machine Types:
                         help='Auto-detect machine type (tries all types)')
     parser.add_argument('-d', '--daemon', action='store_true',
                         help='Run as background daemon (Linux/Pi only)')
+    parser.add_argument('-s', '--socket', default=DEFAULT_SOCKET_PATH,
+                        help=f'Control socket path, empty to disable (default: {DEFAULT_SOCKET_PATH})')
+    parser.add_argument('-i', '--index',
+                        help='Cartridge index file (machine type, image hash, refill count per UID)')
+    parser.add_argument('--station', help='Station name in the replicated index (default: host name)')
+    parser.add_argument('--listen', help='Serve the cartridge index to other stations on host:port')
+    parser.add_argument('--peer', action='append', default=[],
+                        help='Replicate the cartridge index from another station (host:port, repeatable)')
+    parser.add_argument('--metadata', action='store_true',
+                        help='Keep machine type, refill count and record digest on the cartridge (last EEPROM page)')
 
     args = parser.parse_args()
 
@@ -285,12 +800,24 @@ Machine Types:
         print(f"Valid types: {', '.join(machine.get_machine_types())}")
         sys.exit(1)
 
+    if (args.listen or args.peer) and not args.index:
+        print("Error: --listen/--peer need a cartridge index (--index)")
+        sys.exit(1)
+
+    index = CartridgeIndex(args.index, args.station) if args.index else None
+    replicator = IndexReplicator(index, args.listen, args.peer) if index and (args.listen or args.peer) else None
+
     # Create and run daemon
     daemon = AutoRefillDaemon(
-        port=args.port,
+        ports=expand_ports(args.ports),
         machine_type=args.machine,
         threshold=args.threshold,
-        auto_detect=args.auto_detect
+        auto_detect=args.auto_detect,
+        socket_path=args.socket,
+        index=index,
+        replicator=replicator,
+        metadata=args.metadata,
+        station=args.station
     )
 
     # Run as daemon on Linux/Raspberry Pi
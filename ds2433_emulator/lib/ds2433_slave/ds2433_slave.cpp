@@ -0,0 +1,373 @@
+/*
+ * DS2433 Slave Model Implementation
+ */
+
+#include "ds2433_slave.h"
+#include <string.h>
+
+// E/S byte: authorization accepted, partial byte, ending offset
+#define ES_AA 0x80
+#define ES_PF 0x20
+
+Ds2433Slave::Ds2433Slave() {
+  present = false;
+  memset(rom, 0, sizeof(rom));
+  family = &DEFAULT_FAMILY;
+  memory = NULL;
+  state = IDLE;
+  send = SEND_ONES;
+  sending = false;
+  txByte = 0xFF;
+  txMask = 1;
+  rxByte = 0;
+  rxBits = 0;
+  command = 0;
+  index = 0;
+  searchStep = 0;
+  target = 0;
+  es = ES_PF;
+  written = false;
+  memset(scratchpad, 0xFF, sizeof(scratchpad));
+  offset = 0;
+  memset(copyTa, 0, sizeof(copyTa));
+  readAddress = 0;
+  crc = 0;
+  programming = false;
+  progStartUs = 0;
+  progUs = 0;
+  progMinUs = 0;
+  progMaxUs = 0;
+  progFromFamily = true;
+  random = 0x2433;
+  resets = 0;
+  reads = 0;
+  copies = 0;
+  rejected = 0;
+}
+
+void Ds2433Slave::insert(const uint8_t newRom[8], uint8_t* newMemory) {
+  memcpy(rom, newRom, sizeof(rom));
+  family = &findFamily(rom[0]);
+  memory = newMemory;
+  present = true;
+  state = IDLE;
+  sending = false;
+  rxBits = 0;
+  target = 0;
+  es = ES_PF;
+  written = false;
+  memset(scratchpad, 0xFF, sizeof(scratchpad));
+  programming = false;
+
+  if (progFromFamily) {
+    progMinUs = family->progTypicalUs;
+    progMaxUs = family->progTypicalUs;
+  }
+}
+
+void Ds2433Slave::remove() {
+  present = false;
+  state = IDLE;
+  sending = false;
+}
+
+void Ds2433Slave::setProgDelay(uint32_t minUs, uint32_t maxUs) {
+  progFromFamily = false;
+  progMinUs = minUs;
+  progMaxUs = maxUs < minUs ? minUs : maxUs;
+}
+
+bool Ds2433Slave::isProgramming(uint32_t nowUs) {
+  if (programming && nowUs - progStartUs >= progUs) {
+    finishCopy();
+  }
+  return programming;
+}
+
+bool Ds2433Slave::reset(uint32_t nowUs) {
+  // A copy keeps programming across resets, like the EEPROM does
+  isProgramming(nowUs);
+  resets++;
+
+  // A write scratchpad cut short inside a byte can't be copied
+  if (state == WRITE_DATA && rxBits) {
+    es |= ES_PF;
+  }
+
+  sending = false;
+  rxBits = 0;
+  state = present ? ROM_COMMAND : IDLE;
+  return present;
+}
+
+bool Ds2433Slave::driveLow(uint32_t nowUs) {
+  if (!sending) return false;
+
+  // Copy status is live: each poll byte shows whether programming is over
+  if (txMask == 1 && state == SEND && send == SEND_COPY_STATUS) {
+    txByte = isProgramming(nowUs) ? 0xFF : OW_COPY_DONE;
+  }
+  return !(txByte & txMask);
+}
+
+void Ds2433Slave::sample(bool bit, uint32_t nowUs) {
+  if (state == IDLE) return;
+
+  if (state == SEARCH_ROM) {
+    searchBit(bit);
+    return;
+  }
+
+  if (sending) {
+    txMask <<= 1;
+    if (!txMask) {
+      nextByte();
+    }
+    return;
+  }
+
+  rxByte = (rxByte >> 1) | (bit ? 0x80 : 0);
+  if (++rxBits == 8) {
+    rxBits = 0;
+    receive(rxByte, nowUs);
+  }
+}
+
+void Ds2433Slave::startSend(Send what, uint8_t first) {
+  state = SEND;
+  send = what;
+  sending = true;
+  txByte = first;
+  txMask = 1;
+  index = 0;
+}
+
+void Ds2433Slave::searchBit(bool bit) {
+  bool ours = romBit(index);
+
+  switch (searchStep) {
+    case 0:
+      // Our bit went out; its complement follows
+      searchStep = 1;
+      txByte = ours ? 0 : 1;
+      break;
+
+    case 1:
+      // The master writes the branch it takes
+      searchStep = 2;
+      sending = false;
+      break;
+
+    default:
+      if (bit != ours) {
+        state = IDLE;  // another branch: out until the next reset
+        return;
+      }
+      if (++index == 64) {
+        state = MEMORY_COMMAND;
+        return;
+      }
+      searchStep = 0;
+      sending = true;
+      txByte = romBit(index) ? 1 : 0;
+      break;
+  }
+  txMask = 1;
+}
+
+void Ds2433Slave::receive(uint8_t byte, uint32_t nowUs) {
+  isProgramming(nowUs);
+
+  switch (state) {
+    case ROM_COMMAND:
+      if (byte == OW_CMD_READ_ROM) {
+        state = READ_ROM;
+        sending = true;
+        txByte = rom[0];
+        txMask = 1;
+        index = 0;
+      } else if (byte == OW_CMD_MATCH_ROM) {
+        state = MATCH_ROM;
+        index = 0;
+      } else if (byte == OW_CMD_SKIP_ROM) {
+        state = MEMORY_COMMAND;
+      } else if (byte == OW_CMD_SEARCH_ROM) {
+        state = SEARCH_ROM;
+        index = 0;
+        searchStep = 0;
+        sending = true;
+        txByte = romBit(0) ? 1 : 0;
+        txMask = 1;
+      } else {
+        state = IDLE;
+      }
+      break;
+
+    case MATCH_ROM:
+      if (byte != rom[index]) {
+        state = IDLE;
+      } else if (++index == 8) {
+        state = MEMORY_COMMAND;
+      }
+      break;
+
+    case MEMORY_COMMAND:
+      command = byte;
+      if (byte == family->cmdReadScratchpad) {
+        crc = crc16(&command, 1);
+        startSend(SEND_SCRATCHPAD, target & 0xFF);
+      } else if (byte == family->cmdReadMemory || byte == family->cmdWriteScratchpad ||
+                 byte == family->cmdCopyScratchpad) {
+        state = ADDRESS;
+        index = 0;
+      } else {
+        state = IDLE;
+      }
+      break;
+
+    case ADDRESS:
+      copyTa[index++] = byte;
+      if (command == family->cmdReadMemory && index == 2) {
+        reads++;
+        readAddress = copyTa[0] | (copyTa[1] << 8);
+        startSend(SEND_MEMORY, readAddress < family->memorySize ? memory[readAddress] : 0xFF);
+      } else if (command == family->cmdWriteScratchpad && index == 2) {
+        target = copyTa[0] | (copyTa[1] << 8);
+        offset = target & (family->pageSize - 1);
+        es = ES_PF | offset;  // nothing written yet
+        written = false;
+        crc = crc16(&command, 1);
+        crc = crc16(copyTa, 2, crc);
+        state = WRITE_DATA;
+      } else if (command == family->cmdCopyScratchpad && index == 3) {
+        startCopy(nowUs);
+      }
+      break;
+
+    case WRITE_DATA:
+      scratchpad[offset] = byte;
+      crc = crc16(&byte, 1, crc);
+      es = offset;
+      written = true;
+      if (++offset == family->pageSize) {
+        // Scratchpad full: the inverted CRC16 follows
+        startSend(SEND_CRC, (uint8_t) ~crc);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void Ds2433Slave::nextByte() {
+  txMask = 1;
+
+  if (state == READ_ROM) {
+    if (++index == 8) {
+      state = MEMORY_COMMAND;
+      sending = false;
+    } else {
+      txByte = rom[index];
+    }
+    return;
+  }
+
+  switch (send) {
+    case SEND_MEMORY:
+      readAddress++;
+      txByte = readAddress < family->memorySize ? memory[readAddress] : 0xFF;
+      break;
+
+    case SEND_SCRATCHPAD: {
+      crc = crc16(&txByte, 1, crc);
+      index++;
+      uint8_t start = target & (family->pageSize - 1);
+      if (index == 1) {
+        txByte = target >> 8;
+      } else if (index == 2) {
+        txByte = es;
+      } else if (start + index - 3 <= endOffset() && start + index - 3 < family->pageSize) {
+        txByte = scratchpad[start + index - 3];
+      } else {
+        startSend(SEND_CRC, (uint8_t) ~crc);
+      }
+      break;
+    }
+
+    case SEND_CRC:
+      if (++index == 1) {
+        txByte = (uint8_t) (~crc >> 8);
+      } else {
+        send = SEND_ONES;
+        txByte = 0xFF;
+      }
+      break;
+
+    case SEND_COPY_STATUS:
+      break;  // refreshed by driveLow()
+
+    default:
+      txByte = 0xFF;
+      break;
+  }
+}
+
+void Ds2433Slave::startCopy(uint32_t nowUs) {
+  uint8_t start = target & (family->pageSize - 1);
+  bool authorized = written && !(es & ES_PF) && !programming &&
+                    copyTa[0] == (target & 0xFF) && copyTa[1] == (target >> 8) && copyTa[2] == es;
+  if (family->fullPageWrite && (start != 0 || endOffset() != family->pageSize - 1)) {
+    authorized = false;
+  }
+
+  if (!authorized) {
+    rejected++;
+    startSend(SEND_ONES, 0xFF);
+    return;
+  }
+
+  copies++;
+  programming = true;
+  progStartUs = nowUs;
+  progUs = progMinUs;
+  if (progMaxUs > progMinUs) {
+    random = random * 1103515245 + 12345;
+    progUs += (random >> 8) % (progMaxUs - progMinUs + 1);
+  }
+  startSend(SEND_COPY_STATUS, isProgramming(nowUs) ? 0xFF : OW_COPY_DONE);
+}
+
+void Ds2433Slave::finishCopy() {
+  programming = false;
+  uint16_t page = target & ~(uint16_t) (family->pageSize - 1);
+  for (uint8_t i = target & (family->pageSize - 1); i <= endOffset() && i < family->pageSize; i++) {
+    if (page + i < family->memorySize) {
+      memory[page + i] = scratchpad[i];
+    }
+  }
+  es |= ES_AA;
+}
+
+uint8_t Ds2433Slave::crc8(const uint8_t* data, uint16_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    uint8_t byte = *data++;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = ((crc ^ byte) & 1) ? (crc >> 1) ^ 0x8C : crc >> 1;
+      byte >>= 1;
+    }
+  }
+  return crc;
+}
+
+uint16_t Ds2433Slave::crc16(const uint8_t* data, uint16_t len, uint16_t crc) {
+  while (len--) {
+    uint8_t byte = *data++;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = ((crc ^ byte) & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+      byte >>= 1;
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,146 @@
+/*
+ * DS2433 Slave Model
+ * The cartridge side of the 1-Wire protocol, one time slot at a time
+ *
+ * Answers the commands OneWireHandler sends (onewire_families.h): the ROM
+ * commands (search, read, match, skip), then read memory, write, read and
+ * copy scratchpad with the E/S authorization byte and the inverted CRC16
+ * the datasheet specifies. Geometry comes from the family of ROM byte 0,
+ * so a DS2431 or DS28EC20 ROM makes it answer as that part.
+ *
+ * The model knows nothing about pins or timing: the bus driver calls
+ * reset() for every reset pulse and, for every time slot, driveLow() at
+ * the falling edge (true: hold the line low, the slave sends a 0) and
+ * sample() once the slot is over. Times are microseconds of any
+ * free-running clock; they only pace the copy scratchpad, which keeps
+ * polls reading 1s for the programming delay before the alternating
+ * 1/0 pattern and the new data appear. It builds without Arduino, so
+ * the host tests (test/) drive it with a software bus master.
+ */
+
+#ifndef DS2433_SLAVE_H
+#define DS2433_SLAVE_H
+
+#include <stdint.h>
+#include "onewire_families.h"
+
+// Largest user memory of any supported part (DS28EC20)
+#define SLAVE_MAX_MEMORY 2560
+
+class Ds2433Slave {
+public:
+  enum State {
+    IDLE,           // waiting for a reset (not selected)
+    ROM_COMMAND,
+    READ_ROM,
+    MATCH_ROM,
+    SEARCH_ROM,
+    MEMORY_COMMAND,
+    ADDRESS,        // TA1, TA2 (and E/S for a copy)
+    WRITE_DATA,
+    SEND,           // read memory, read scratchpad, CRC or copy status
+  };
+
+  Ds2433Slave();
+
+  // Answer as the cartridge with this ROM (byte 0 picks the family) and
+  // memory, which must hold at least the family's memory size. Clears the
+  // scratchpad and any copy in progress.
+  void insert(const uint8_t rom[8], uint8_t* memory);
+
+  // No presence pulse until the next insert()
+  void remove();
+
+  bool isPresent() const { return present; }
+  const uint8_t* getRom() const { return rom; }
+  const OneWireFamily& getFamily() const { return *family; }
+  State getState() const { return state; }
+
+  // Copy scratchpad programming time, drawn between minUs and maxUs for
+  // every copy (the family's typical time until set)
+  void setProgDelay(uint32_t minUs, uint32_t maxUs);
+  uint32_t getProgMinUs() const { return progMinUs; }
+  uint32_t getProgMaxUs() const { return progMaxUs; }
+
+  // A copy is still programming at nowUs
+  bool isProgramming(uint32_t nowUs);
+
+  // Bus events (driveLow is called at the falling edge: keep it short)
+  bool reset(uint32_t nowUs);             // true: answer with a presence pulse
+  bool driveLow(uint32_t nowUs);
+  void sample(bool bit, uint32_t nowUs);  // line level at the sample point
+
+  // Counters since power-up
+  uint32_t getResets() const { return resets; }
+  uint32_t getReads() const { return reads; }
+  uint32_t getCopies() const { return copies; }
+  uint32_t getRejectedCopies() const { return rejected; }
+
+  // Dallas CRC8 (ROM byte 7) and CRC16 (scratchpad commands)
+  static uint8_t crc8(const uint8_t* data, uint16_t len);
+  static uint16_t crc16(const uint8_t* data, uint16_t len, uint16_t crc = 0);
+
+private:
+  enum Send {
+    SEND_MEMORY,
+    SEND_SCRATCHPAD,  // TA1, TA2, E/S, data, then the CRC
+    SEND_CRC,
+    SEND_COPY_STATUS,
+    SEND_ONES,
+  };
+
+  bool present;
+  uint8_t rom[8];
+  const OneWireFamily* family;
+  uint8_t* memory;
+
+  State state;
+  Send send;
+
+  // Bit engine: one byte in or out at a time, LSB first
+  bool sending;
+  uint8_t txByte;
+  uint8_t txMask;
+  uint8_t rxByte;
+  uint8_t rxBits;
+
+  uint8_t command;
+  uint8_t index;       // ROM byte, address byte or search bit
+  uint8_t searchStep;  // 0: bit, 1: complement, 2: master's choice
+
+  // Scratchpad: target address, E/S (AA, PF, ending offset) and data
+  uint16_t target;
+  uint8_t es;
+  bool written;
+  uint8_t scratchpad[OW_MAX_PAGE_SIZE];
+  uint8_t offset;      // next scratchpad byte written or sent
+  uint8_t copyTa[3];
+  uint16_t readAddress;
+  uint16_t crc;
+
+  // Copy in progress
+  bool programming;
+  uint32_t progStartUs;
+  uint32_t progUs;
+  uint32_t progMinUs;
+  uint32_t progMaxUs;
+  bool progFromFamily;
+  uint32_t random;
+
+  uint32_t resets;
+  uint32_t reads;
+  uint32_t copies;
+  uint32_t rejected;
+
+  uint8_t endOffset() const { return es & 0x1F; }
+
+  void startSend(Send what, uint8_t first);
+  void nextByte();
+  void receive(uint8_t byte, uint32_t nowUs);
+  void searchBit(bool bit);
+  bool romBit(uint8_t n) const { return (rom[n >> 3] >> (n & 7)) & 1; }
+  void startCopy(uint32_t nowUs);
+  void finishCopy();
+};
+
+#endif
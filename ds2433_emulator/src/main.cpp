@@ -0,0 +1,382 @@
+/*
+ * DS2433 Cartridge Emulator
+ *
+ * Answers on a 1-Wire line as a cartridge EEPROM (lib/ds2433_slave), so
+ * a station or bridge can run refill cycles without wearing out real
+ * cartridges or waiting for someone to reseat them. Wire the emulator's
+ * bus pin to the station's socket data line and join the grounds; the
+ * station provides the pull-up.
+ *
+ * Up to EMULATOR_SLOTS cartridges are held, each with its ROM and image.
+ * One of them at a time is inserted (answers presence pulses); switching
+ * slots is a cartridge swap. AUTO swaps on its own: remove, wait, insert
+ * the next loaded slot, optionally with its original image restored so
+ * every insertion needs a full refill.
+ *
+ * Commands (115200 baud, one per line):
+ *   VERSION                      - Firmware version
+ *   ROM <n> <rom>                - Set the ROM of slot n (16 hex digits,
+ *                                  or 14 and the CRC8 is appended)
+ *   IMAGE <n> <offset> <hex>     - Load image bytes into slot n (up to
+ *                                  256 per command); memory follows
+ *   DUMP <n> [<offset> <len>]    - Memory of slot n as the station left it
+ *   RESTORE <n>                  - Memory of slot n back to its image
+ *   INSERT <n>                   - Insert slot n (the current one is removed)
+ *   REMOVE                       - Remove the current cartridge
+ *   PROG <min_us> [<max_us>]     - Copy scratchpad programming time, drawn
+ *                                  between min and max for every copy
+ *   AUTO <present_ms> <absent_ms> [RESTORE] - Cycle through loaded slots
+ *   AUTO OFF                     - Stop cycling (the current slot stays)
+ *   STATUS                       - STATUS:SLOT=<n>,ROM=<rom>,FAMILY=<name>,
+ *                                  PROG=<min>/<max>,AUTO=<ON|OFF>,CYCLES=<n>,
+ *                                  RESETS=<n>,READS=<n>,COPIES=<n>,REJECTED=<n>,
+ *                                  PRESENCE=<n>,SLOTS=<n>,STUCK=<n>
+ *
+ * Responses: OK, DATA:<hex>, STATUS:..., ERROR <msg>
+ *
+ * The bus is served by a core of its own (core 0 of the ESP32, core 1 of
+ * the Pico 2) with interrupts off while the master talks. Commands are
+ * parsed on the other core and applied by the bus core between bursts.
+ */
+
+#include <Arduino.h>
+#include <atomic>
+#include "ds2433_slave.h"
+#include "slave_bus.h"
+
+#ifndef ONEWIRE_PIN
+  #define ONEWIRE_PIN 4
+#endif
+
+#ifndef BOARD_NAME
+  #define BOARD_NAME "ESP32"
+#endif
+
+#ifndef EMULATOR_SLOTS
+  #define EMULATOR_SLOTS 4
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+  static_assert(ONEWIRE_PIN < 32, "The bus driver reads GPIO0-GPIO31 only");
+#endif
+
+#define FIRMWARE_VERSION "v1.0"
+
+// Image bytes per IMAGE command
+#define IMAGE_CHUNK 256
+
+struct Cartridge {
+  bool loaded;                          // has a ROM
+  uint8_t rom[8];
+  uint8_t image[SLAVE_MAX_MEMORY];      // as loaded
+  uint8_t memory[SLAVE_MAX_MEMORY];     // as the station left it
+};
+
+Cartridge cartridges[EMULATOR_SLOTS];
+Ds2433Slave slave;
+SlaveBus bus;
+int8_t inserted = -1;
+
+// AUTO cycling
+bool autoCycle = false;
+bool autoRestore = false;
+uint32_t autoPresentMs = 0;
+uint32_t autoAbsentMs = 0;
+uint32_t autoNextMs = 0;
+uint32_t cycles = 0;
+
+// Command handed from the console core to the bus core
+String request;
+String reply;
+std::atomic<bool> requestPending(false);
+
+String hexString(const uint8_t* data, uint16_t len) {
+  static const char digits[] = "0123456789abcdef";
+  String out;
+  out.reserve(len * 2);
+  for (uint16_t i = 0; i < len; i++) {
+    out += digits[data[i] >> 4];
+    out += digits[data[i] & 0x0F];
+  }
+  return out;
+}
+
+// Returns the number of bytes, or -1 if hex isn't whole hex pairs
+int parseHex(const String& hex, uint8_t* buffer, uint16_t maxLen) {
+  if (hex.length() % 2 || hex.length() / 2 > maxLen) return -1;
+
+  for (uint16_t i = 0; i < hex.length(); i += 2) {
+    char pair[3] = { hex[i], hex[i + 1], 0 };
+    char* end;
+    buffer[i / 2] = (uint8_t) strtol(pair, &end, 16);
+    if (*end) return -1;
+  }
+  return hex.length() / 2;
+}
+
+// Space-separated argument i of a command (0 is the command itself)
+String argument(const String& command, uint8_t i) {
+  int start = 0;
+  for (uint8_t n = 0; n < i; n++) {
+    start = command.indexOf(' ', start);
+    if (start == -1) return "";
+    while (command[start] == ' ') start++;
+  }
+  int end = command.indexOf(' ', start);
+  return end == -1 ? command.substring(start) : command.substring(start, end);
+}
+
+int slotArgument(const String& command) {
+  String text = argument(command, 1);
+  if (text.length() == 0) return -1;
+  int n = text.toInt();
+  return n >= 0 && n < EMULATOR_SLOTS ? n : -1;
+}
+
+void insertSlot(int8_t n) {
+  inserted = n;
+  slave.insert(cartridges[n].rom, cartridges[n].memory);
+#ifdef STATUS_LED
+  digitalWrite(STATUS_LED, HIGH);
+#endif
+}
+
+void removeSlot() {
+  inserted = -1;
+  slave.remove();
+#ifdef STATUS_LED
+  digitalWrite(STATUS_LED, LOW);
+#endif
+}
+
+// Next loaded slot after the current (or last inserted) one, -1 if none
+int8_t nextLoadedSlot(int8_t after) {
+  for (uint8_t i = 1; i <= EMULATOR_SLOTS; i++) {
+    int8_t n = (after + i + EMULATOR_SLOTS) % EMULATOR_SLOTS;
+    if (cartridges[n].loaded) return n;
+  }
+  return -1;
+}
+
+void stepAutoCycle() {
+  static int8_t last = -1;
+
+  if (!autoCycle || (int32_t) (millis() - autoNextMs) < 0) return;
+
+  if (inserted >= 0) {
+    last = inserted;
+    removeSlot();
+    autoNextMs = millis() + autoAbsentMs;
+    return;
+  }
+
+  int8_t n = nextLoadedSlot(last);
+  if (n < 0) return;
+  if (autoRestore) {
+    memcpy(cartridges[n].memory, cartridges[n].image, SLAVE_MAX_MEMORY);
+  }
+  insertSlot(n);
+  cycles++;
+  autoNextMs = millis() + autoPresentMs;
+}
+
+void execute(String command, String& out) {
+  command.trim();
+  command.toUpperCase();
+  String name = argument(command, 0);
+
+  if (name == "VERSION") {
+    out = "DS2433 Emulator " BOARD_NAME " " FIRMWARE_VERSION;
+  }
+  else if (name == "ROM") {
+    int n = slotArgument(command);
+    uint8_t rom[8];
+    int len = parseHex(argument(command, 2), rom, sizeof(rom));
+    if (n < 0 || len < 7) {
+      out = "ERROR Invalid ROM command";
+      return;
+    }
+    if (len == 7) rom[7] = Ds2433Slave::crc8(rom, 7);
+
+    Cartridge& cartridge = cartridges[n];
+    if (!cartridge.loaded) {
+      memset(cartridge.image, 0xFF, SLAVE_MAX_MEMORY);
+      memset(cartridge.memory, 0xFF, SLAVE_MAX_MEMORY);
+    }
+    memcpy(cartridge.rom, rom, sizeof(rom));
+    cartridge.loaded = true;
+
+    // New ROM on the inserted slot: a different cartridge
+    if (inserted == n) insertSlot(n);
+    out = "OK";
+  }
+  else if (name == "IMAGE") {
+    int n = slotArgument(command);
+    int offset = argument(command, 2).toInt();
+    uint8_t data[IMAGE_CHUNK];
+    int len = parseHex(argument(command, 3), data, sizeof(data));
+    if (n < 0 || !cartridges[n].loaded || len <= 0 || offset < 0 || offset + len > SLAVE_MAX_MEMORY) {
+      out = "ERROR Invalid IMAGE command";
+      return;
+    }
+    memcpy(cartridges[n].image + offset, data, len);
+    memcpy(cartridges[n].memory + offset, data, len);
+    out = "OK";
+  }
+  else if (name == "DUMP") {
+    int n = slotArgument(command);
+    if (n < 0 || !cartridges[n].loaded) {
+      out = "ERROR Invalid DUMP command";
+      return;
+    }
+    const OneWireFamily& family = findFamily(cartridges[n].rom[0]);
+    int offset = argument(command, 2).toInt();
+    int len = argument(command, 3).length() ? argument(command, 3).toInt() : family.memorySize;
+    if (offset < 0 || len <= 0 || offset + len > family.memorySize) {
+      out = "ERROR Invalid range";
+      return;
+    }
+    out = "DATA:" + hexString(cartridges[n].memory + offset, len);
+  }
+  else if (name == "RESTORE") {
+    int n = slotArgument(command);
+    if (n < 0 || !cartridges[n].loaded) {
+      out = "ERROR Invalid RESTORE command";
+      return;
+    }
+    memcpy(cartridges[n].memory, cartridges[n].image, SLAVE_MAX_MEMORY);
+    out = "OK";
+  }
+  else if (name == "INSERT") {
+    int n = slotArgument(command);
+    if (n < 0 || !cartridges[n].loaded) {
+      out = "ERROR No ROM in that slot";
+      return;
+    }
+    insertSlot(n);
+    out = "OK";
+  }
+  else if (name == "REMOVE") {
+    removeSlot();
+    out = "OK";
+  }
+  else if (name == "PROG") {
+    String minText = argument(command, 1);
+    String maxText = argument(command, 2);
+    if (minText.length() == 0) {
+      out = "ERROR Invalid PROG command";
+      return;
+    }
+    uint32_t minUs = minText.toInt();
+    slave.setProgDelay(minUs, maxText.length() ? maxText.toInt() : minUs);
+    out = "OK";
+  }
+  else if (name == "AUTO") {
+    if (argument(command, 1) == "OFF") {
+      autoCycle = false;
+      out = "OK";
+      return;
+    }
+    int presentMs = argument(command, 1).toInt();
+    int absentMs = argument(command, 2).toInt();
+    if (presentMs <= 0 || absentMs <= 0 || nextLoadedSlot(-1) < 0) {
+      out = "ERROR Invalid AUTO command";
+      return;
+    }
+    autoPresentMs = presentMs;
+    autoAbsentMs = absentMs;
+    autoRestore = argument(command, 3) == "RESTORE";
+    autoCycle = true;
+    autoNextMs = millis();
+    out = "OK";
+  }
+  else if (name == "STATUS") {
+    out = "STATUS:SLOT=";
+    out += inserted >= 0 ? String(inserted) : String("-");
+    out += ",ROM=" + (inserted >= 0 ? hexString(slave.getRom(), 8) : String("-"));
+    out += ",FAMILY=" + String(inserted >= 0 ? slave.getFamily().name : "-");
+    out += ",PROG=" + String(slave.getProgMinUs()) + "/" + String(slave.getProgMaxUs());
+    out += ",AUTO=" + String(autoCycle ? "ON" : "OFF");
+    out += ",CYCLES=" + String(cycles);
+    out += ",RESETS=" + String(slave.getResets());
+    out += ",READS=" + String(slave.getReads());
+    out += ",COPIES=" + String(slave.getCopies());
+    out += ",REJECTED=" + String(slave.getRejectedCopies());
+    out += ",PRESENCE=" + String(bus.getPresencePulses());
+    out += ",SLOTS=" + String(bus.getSlots());
+    out += ",STUCK=" + String(bus.getStuck());
+  }
+  else {
+    out = "ERROR Unknown command";
+  }
+}
+
+// Bus core: serve the line, then apply a pending command
+void busLoop() {
+  bus.service(slave);
+
+  if (requestPending.load()) {
+    execute(request, reply);
+    requestPending.store(false);
+  }
+  stepAutoCycle();
+}
+
+// Console core
+void consoleLoop() {
+  if (!Serial.available()) {
+    delay(1);
+    return;
+  }
+
+  String line = Serial.readStringUntil('\n');
+  line.trim();
+  if (line.length() == 0) return;
+
+  request = line;
+  requestPending.store(true);
+  while (requestPending.load()) {
+    delay(1);
+  }
+  Serial.println(reply);
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+void busTask(void*) {
+  while (true) {
+    busLoop();
+  }
+}
+#endif
+
+void setup() {
+  Serial.begin(115200);
+  Serial.setTimeout(100);
+
+#ifdef STATUS_LED
+  pinMode(STATUS_LED, OUTPUT);
+  digitalWrite(STATUS_LED, LOW);
+#endif
+
+  for (uint8_t i = 0; i < EMULATOR_SLOTS; i++) {
+    cartridges[i].loaded = false;
+  }
+  bus.begin(ONEWIRE_PIN);
+
+#if defined(ARDUINO_ARCH_ESP32)
+  // Core 0 is ours (no WiFi): the bus task never lets its idle task run
+  disableCore0WDT();
+  xTaskCreatePinnedToCore(busTask, "bus", 8192, NULL, 1, NULL, 0);
+#endif
+}
+
+void loop() {
+  consoleLoop();
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+// Core 1: USB stays on core 0 with its interrupts
+void loop1() {
+  busLoop();
+}
+#endif
@@ -0,0 +1,121 @@
+/*
+ * 1-Wire Slave Bus Driver Implementation
+ */
+
+#include "slave_bus.h"
+
+// Standard speed slave timing (us from the master's falling edge)
+#define SLOT_SAMPLE_US 30      // master writes: 1 released by ~15, 0 held to 60
+#define SLOT_HOLD_US 30        // we send a 0: master samples at ~13
+#define RESET_MIN_US 400       // longest slot is 120, shortest reset 480
+#define PRESENCE_WAIT_US 30    // tPDH 15-60
+#define PRESENCE_US 120        // tPDL 60-240
+#define STUCK_US 5000          // held low longer: shorted line or no master
+
+// Direct register access: digitalRead() and pinMode() are too slow to
+// answer inside a slot. Interrupts stay off for a whole burst.
+#if defined(ARDUINO_ARCH_ESP32)
+  #include <soc/gpio_struct.h>
+  static portMUX_TYPE busMux = portMUX_INITIALIZER_UNLOCKED;
+  #define BUS_BEGIN() portENTER_CRITICAL(&busMux)
+  #define BUS_END() portEXIT_CRITICAL(&busMux)
+  #define LINE_HIGH() ((GPIO.in >> pin) & 1)
+  #define DRIVE_LOW() (GPIO.enable_w1ts = (uint32_t) 1 << pin)
+  #define RELEASE() (GPIO.enable_w1tc = (uint32_t) 1 << pin)
+#elif defined(ARDUINO_ARCH_RP2040)
+  #include "hardware/gpio.h"
+  #include "hardware/sync.h"
+  #define BUS_BEGIN() uint32_t irqState = save_and_disable_interrupts()
+  #define BUS_END() restore_interrupts(irqState)
+  #define LINE_HIGH() gpio_get(pin)
+  #define DRIVE_LOW() gpio_set_dir(pin, GPIO_OUT)
+  #define RELEASE() gpio_set_dir(pin, GPIO_IN)
+#else
+  #error "DS2433 emulator: ESP32 or RP2040/RP2350 only"
+#endif
+
+SlaveBus::SlaveBus() {
+  pin = 0;
+  slots = 0;
+  presencePulses = 0;
+  stuck = 0;
+}
+
+void SlaveBus::begin(uint8_t busPin) {
+  pin = busPin;
+
+  // Output latch low, driver off: DRIVE_LOW() only enables the driver
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  pinMode(pin, INPUT);
+}
+
+bool SlaveBus::service(Ds2433Slave& slave) {
+  bool active = false;
+
+  BUS_BEGIN();
+  uint32_t burstStart = micros();
+
+  // Entered partway through a low phase: its start is unknown, so a reset
+  // could pass for a slot. Skip it; the master retries a missed reset.
+  while (!LINE_HIGH()) {
+    active = true;
+    if (micros() - burstStart >= STUCK_US) {
+      stuck++;
+      BUS_END();
+      return true;
+    }
+  }
+  uint32_t idleSince = micros();
+
+  while (true) {
+    uint32_t fall = micros();
+    while (LINE_HIGH()) {
+      fall = micros();
+      if (fall - idleSince >= BUS_IDLE_US || fall - burstStart >= BUS_BURST_MAX_US) {
+        BUS_END();
+        return active;
+      }
+    }
+    active = true;
+
+    bool zero = slave.driveLow(fall);
+    bool bit = false;
+    if (zero) {
+      DRIVE_LOW();
+      while (micros() - fall < SLOT_HOLD_US) {}
+      RELEASE();
+    } else {
+      while (micros() - fall < SLOT_SAMPLE_US) {}
+      bit = LINE_HIGH();
+    }
+
+    uint32_t rise = micros();
+    while (!LINE_HIGH()) {
+      rise = micros();
+      if (rise - fall >= STUCK_US) {
+        stuck++;
+        BUS_END();
+        return true;
+      }
+    }
+
+    if (rise - fall >= RESET_MIN_US) {
+      // Reset pulse (a slot we started answering is dropped with it)
+      if (slave.reset(rise)) {
+        while (micros() - rise < PRESENCE_WAIT_US) {}
+        DRIVE_LOW();
+        uint32_t pulse = micros();
+        while (micros() - pulse < PRESENCE_US) {}
+        RELEASE();
+        presencePulses++;
+        while (!LINE_HIGH() && micros() - pulse < STUCK_US) {}
+      }
+    } else {
+      slots++;
+      slave.sample(zero ? false : bit, rise);
+    }
+
+    idleSince = micros();
+  }
+}
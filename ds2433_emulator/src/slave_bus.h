@@ -0,0 +1,55 @@
+/*
+ * 1-Wire Slave Bus Driver
+ * Standard-speed slave timing around Ds2433Slave
+ *
+ * The line is polled with interrupts off while the master is talking:
+ *
+ * - Falling edge: if the model sends a 0, hold the line low until
+ *   SLOT_HOLD_US, otherwise wait until SLOT_SAMPLE_US and sample it
+ *   (the master releases a 1 after ~10 us and holds a 0 for 60 us).
+ * - Rising edge: a low phase of RESET_MIN_US or more was a reset pulse,
+ *   answered with a presence pulse; anything shorter was a time slot.
+ *
+ * The bridge's OneWire library samples read slots 13 us after its own
+ * falling edge, so the edge has to be seen within a few microseconds:
+ * the loop runs on a core of its own (see main.cpp).
+ */
+
+#ifndef SLAVE_BUS_H
+#define SLAVE_BUS_H
+
+#include <Arduino.h>
+#include "ds2433_slave.h"
+
+// A burst ends when the line has been idle this long...
+#ifndef BUS_IDLE_US
+  #define BUS_IDLE_US 2000
+#endif
+
+// ...or after this long, so the caller's core gets its interrupts back
+#ifndef BUS_BURST_MAX_US
+  #define BUS_BURST_MAX_US 50000
+#endif
+
+class SlaveBus {
+private:
+  uint8_t pin;
+  uint32_t slots;
+  uint32_t presencePulses;
+  uint32_t stuck;
+
+public:
+  SlaveBus();
+
+  void begin(uint8_t busPin);
+
+  // Answer the master until the line goes idle. Returns false if no
+  // falling edge was seen within BUS_IDLE_US.
+  bool service(Ds2433Slave& slave);
+
+  uint32_t getSlots() const { return slots; }
+  uint32_t getPresencePulses() const { return presencePulses; }
+  uint32_t getStuck() const { return stuck; }
+};
+
+#endif
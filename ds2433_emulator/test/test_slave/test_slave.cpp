@@ -0,0 +1,336 @@
+/*
+ * Host tests of the slave model: pio test -e native
+ *
+ * BusMaster plays the bridge's side one time slot at a time, with the
+ * same command sequences as OneWireHandler (select, write, read back and
+ * copy scratchpad, then read the status).
+ */
+
+#include <unity.h>
+#include <string.h>
+#include "ds2433_slave.h"
+
+static const uint8_t ROM_A[8] = { 0x23, 0x4D, 0x1B, 0x5E, 0x01, 0x00, 0x00, 0x00 };
+static const uint8_t ROM_B[8] = { 0x23, 0x4D, 0x1B, 0x5E, 0x02, 0x00, 0x00, 0x00 };
+
+// Standard speed: reset with presence and one time slot
+#define RESET_US 960
+#define SLOT_US 70
+
+// Worst case from the end of programming to the poll that sees it: one
+// poll read, the pause, then the next read
+#define POLL_US (2 * 8 * SLOT_US + 500)
+
+struct BusMaster {
+  Ds2433Slave& slave;
+  uint32_t now;
+
+  explicit BusMaster(Ds2433Slave& s) : slave(s), now(0) {}
+
+  bool reset() {
+    now += RESET_US;
+    return slave.reset(now);
+  }
+
+  // Write slot for 0, read slot for 1: the line is low if either side pulls it
+  bool bit(bool out) {
+    bool line = out && !slave.driveLow(now);
+    now += SLOT_US;
+    slave.sample(line, now);
+    return line;
+  }
+
+  void write(uint8_t byte) {
+    for (uint8_t i = 0; i < 8; i++) bit((byte >> i) & 1);
+  }
+
+  uint8_t read() {
+    uint8_t byte = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+      if (bit(true)) byte |= 1 << i;
+    }
+    return byte;
+  }
+
+  bool select(const uint8_t rom[8]) {
+    if (!reset()) return false;
+    write(OW_CMD_MATCH_ROM);
+    for (uint8_t i = 0; i < 8; i++) write(rom[i]);
+    return true;
+  }
+
+  // Search with one device on the bus: take whichever branch answers
+  bool search(uint8_t rom[8]) {
+    if (!reset()) return false;
+    write(OW_CMD_SEARCH_ROM);
+    memset(rom, 0, 8);
+    for (uint8_t n = 0; n < 64; n++) {
+      bool id = bit(true);
+      bool complement = bit(true);
+      if (id && complement) return false;
+      if (id) rom[n >> 3] |= 1 << (n & 7);
+      bit(id);
+    }
+    return true;
+  }
+
+  void writeScratchpad(const uint8_t rom[8], uint16_t addr, const uint8_t* data, uint8_t len) {
+    select(rom);
+    write(0x0F);
+    write(addr & 0xFF);
+    write(addr >> 8);
+    for (uint8_t i = 0; i < len; i++) write(data[i]);
+  }
+
+  // Copy scratchpad, then poll the status until the copy completes, to
+  // measure the programming time (OneWireHandler::waitProgrammed() waits
+  // the maximum and reads once); elapsed us or 0
+  uint32_t copy(const uint8_t rom[8], uint8_t ta1, uint8_t ta2, uint8_t es, uint32_t timeoutUs) {
+    select(rom);
+    write(0x55);
+    write(ta1);
+    write(ta2);
+    write(es);
+    uint32_t start = now;
+    while (now - start < timeoutUs) {
+      uint8_t status = read();
+      if (status == OW_COPY_DONE || status == (uint8_t) ~OW_COPY_DONE) return now - start;
+      now += 500;
+    }
+    return 0;
+  }
+};
+
+static Ds2433Slave slave;
+static uint8_t memory[SLAVE_MAX_MEMORY];
+
+void setUp() {
+  slave = Ds2433Slave();
+  for (uint16_t i = 0; i < sizeof(memory); i++) memory[i] = i & 0xFF;
+  slave.insert(ROM_A, memory);
+}
+
+void tearDown() {}
+
+void test_presence_follows_insert_and_remove() {
+  BusMaster bus(slave);
+  TEST_ASSERT_TRUE(bus.reset());
+
+  slave.remove();
+  TEST_ASSERT_FALSE(bus.reset());
+
+  slave.insert(ROM_B, memory);
+  TEST_ASSERT_TRUE(bus.reset());
+  TEST_ASSERT_EQUAL_UINT32(3, slave.getResets());
+}
+
+void test_search_and_read_rom() {
+  BusMaster bus(slave);
+  uint8_t rom[8];
+  TEST_ASSERT_TRUE(bus.search(rom));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(ROM_A, rom, 8);
+
+  bus.reset();
+  bus.write(OW_CMD_READ_ROM);
+  for (uint8_t i = 0; i < 8; i++) rom[i] = bus.read();
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(ROM_A, rom, 8);
+
+  // Selected after the search: memory commands follow directly
+  TEST_ASSERT_TRUE(bus.search(rom));
+  bus.write(0xF0);
+  bus.write(0x10);
+  bus.write(0x00);
+  TEST_ASSERT_EQUAL_HEX8(0x10, bus.read());
+}
+
+void test_read_memory_stops_at_the_end() {
+  BusMaster bus(slave);
+  bus.select(ROM_A);
+  bus.write(0xF0);
+  bus.write(0xFE);
+  bus.write(0x01);
+  TEST_ASSERT_EQUAL_HEX8(0xFE, bus.read());
+  TEST_ASSERT_EQUAL_HEX8(0xFF, bus.read());
+  TEST_ASSERT_EQUAL_HEX8(0xFF, bus.read());  // past 512 bytes
+  TEST_ASSERT_EQUAL_UINT32(1, slave.getReads());
+}
+
+void test_other_rom_is_not_selected() {
+  BusMaster bus(slave);
+  bus.select(ROM_B);
+  bus.write(0xF0);
+  bus.write(0x00);
+  bus.write(0x00);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, bus.read());
+  TEST_ASSERT_EQUAL_UINT32(0, slave.getReads());
+}
+
+void test_write_read_and_copy_scratchpad() {
+  BusMaster bus(slave);
+  slave.setProgDelay(4000, 4000);
+  const uint8_t data[5] = { 0xDE, 0xAD, 0xBE, 0xEF, 0x42 };
+  bus.writeScratchpad(ROM_A, 0x0025, data, sizeof(data));
+
+  bus.select(ROM_A);
+  bus.write(0xAA);
+  uint8_t reply[3 + 5 + 2];
+  for (uint8_t i = 0; i < sizeof(reply); i++) reply[i] = bus.read();
+  TEST_ASSERT_EQUAL_HEX8(0x25, reply[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, reply[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x09, reply[2]);  // ending offset 5 + 5 - 1, no flags
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, reply + 3, 5);
+
+  uint8_t command = 0xAA;
+  uint16_t crc = Ds2433Slave::crc16(&command, 1);
+  crc = Ds2433Slave::crc16(reply, 8, crc);
+  TEST_ASSERT_EQUAL_HEX16((uint16_t) ~crc, reply[8] | (reply[9] << 8));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, bus.read());
+
+  // Memory keeps the old data until programming is over
+  uint32_t elapsed = bus.copy(ROM_A, reply[0], reply[1], reply[2], 20000);
+  TEST_ASSERT_TRUE(elapsed >= 4000);
+  TEST_ASSERT_TRUE(elapsed <= 4000 + POLL_US);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, memory + 0x25, 5);
+  TEST_ASSERT_EQUAL_HEX8(0x24, memory[0x24]);
+  TEST_ASSERT_EQUAL_HEX8(0x2A, memory[0x2A]);
+  TEST_ASSERT_EQUAL_UINT32(1, slave.getCopies());
+
+  // Authorization accepted is reported from now on
+  bus.select(ROM_A);
+  bus.write(0xAA);
+  bus.read();
+  bus.read();
+  TEST_ASSERT_EQUAL_HEX8(0x89, bus.read());
+}
+
+void test_full_scratchpad_sends_crc() {
+  BusMaster bus(slave);
+  uint8_t data[32];
+  for (uint8_t i = 0; i < sizeof(data); i++) data[i] = 0xA0 + i;
+  bus.writeScratchpad(ROM_A, 0x0040, data, sizeof(data));
+
+  uint8_t header[3] = { 0x0F, 0x40, 0x00 };
+  uint16_t crc = Ds2433Slave::crc16(header, 3);
+  crc = Ds2433Slave::crc16(data, sizeof(data), crc);
+  uint16_t sent = bus.read();
+  sent |= bus.read() << 8;
+  TEST_ASSERT_EQUAL_HEX16((uint16_t) ~crc, sent);
+}
+
+void test_copy_with_wrong_authorization_is_rejected() {
+  BusMaster bus(slave);
+  slave.setProgDelay(0, 0);
+  const uint8_t data[2] = { 0x11, 0x22 };
+  bus.writeScratchpad(ROM_A, 0x0100, data, sizeof(data));
+
+  TEST_ASSERT_EQUAL_UINT32(0, bus.copy(ROM_A, 0x00, 0x01, 0x00, 3000));
+  TEST_ASSERT_EQUAL_HEX8(0x00, memory[0x100]);
+  TEST_ASSERT_EQUAL_UINT32(1, slave.getRejectedCopies());
+
+  TEST_ASSERT_TRUE(bus.copy(ROM_A, 0x00, 0x01, 0x01, 3000) > 0);
+  TEST_ASSERT_EQUAL_HEX8(0x11, memory[0x100]);
+  TEST_ASSERT_EQUAL_HEX8(0x22, memory[0x101]);
+}
+
+void test_partial_byte_blocks_the_copy() {
+  BusMaster bus(slave);
+  const uint8_t data[1] = { 0x33 };
+  bus.writeScratchpad(ROM_A, 0x0000, data, sizeof(data));
+  bus.bit(false);  // reset in the middle of the second byte
+
+  bus.select(ROM_A);
+  bus.write(0xAA);
+  bus.read();
+  bus.read();
+  uint8_t es = bus.read();
+  TEST_ASSERT_EQUAL_HEX8(0x20, es);
+
+  TEST_ASSERT_EQUAL_UINT32(0, bus.copy(ROM_A, 0x00, 0x00, es, 20000));
+  TEST_ASSERT_EQUAL_HEX8(0x00, memory[0]);
+}
+
+void test_full_page_part_needs_whole_pages() {
+  static const uint8_t ROM_DS2431[8] = { 0x2D, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x00 };
+  slave.insert(ROM_DS2431, memory);
+  slave.setProgDelay(0, 0);
+  TEST_ASSERT_EQUAL_UINT16(128, slave.getFamily().memorySize);
+
+  BusMaster bus(slave);
+  const uint8_t data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  bus.writeScratchpad(ROM_DS2431, 0x0008, data, 4);
+  TEST_ASSERT_EQUAL_UINT32(0, bus.copy(ROM_DS2431, 0x08, 0x00, 0x03, 3000));
+
+  bus.writeScratchpad(ROM_DS2431, 0x0008, data, 8);
+  TEST_ASSERT_TRUE(bus.copy(ROM_DS2431, 0x08, 0x00, 0x07, 3000) > 0);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(data, memory + 8, 8);
+}
+
+void test_programming_delay_range() {
+  BusMaster bus(slave);
+  TEST_ASSERT_EQUAL_UINT32(DEFAULT_FAMILY.progTypicalUs, slave.getProgMinUs());
+
+  slave.setProgDelay(1000, 9000);
+  uint32_t shortest = UINT32_MAX;
+  uint32_t longest = 0;
+  const uint8_t data[1] = { 0x55 };
+  for (uint8_t i = 0; i < 40; i++) {
+    bus.writeScratchpad(ROM_A, i, data, 1);
+    uint32_t elapsed = bus.copy(ROM_A, i, 0x00, i & 0x1F, 20000);
+    TEST_ASSERT_TRUE(elapsed > 0);
+    if (elapsed < shortest) shortest = elapsed;
+    if (elapsed > longest) longest = elapsed;
+  }
+  TEST_ASSERT_TRUE(shortest >= 1000);
+  TEST_ASSERT_TRUE(longest <= 9000 + POLL_US);
+  TEST_ASSERT_TRUE(longest - shortest > 2000);
+}
+
+void test_whole_image_refill_cycle() {
+  BusMaster bus(slave);
+  slave.setProgDelay(0, 0);
+  uint8_t image[512];
+  for (uint16_t i = 0; i < sizeof(image); i++) image[i] = (i * 7) ^ 0x5A;
+
+  for (uint16_t addr = 0; addr < sizeof(image); addr += 32) {
+    bus.writeScratchpad(ROM_A, addr, image + addr, 32);
+    bus.select(ROM_A);
+    bus.write(0xAA);
+    uint8_t ta1 = bus.read();
+    uint8_t ta2 = bus.read();
+    uint8_t es = bus.read();
+    TEST_ASSERT_TRUE(bus.copy(ROM_A, ta1, ta2, es, 20000) > 0);
+  }
+
+  bus.select(ROM_A);
+  bus.write(0xF0);
+  bus.write(0x00);
+  bus.write(0x00);
+  uint8_t readBack[512];
+  for (uint16_t i = 0; i < sizeof(readBack); i++) readBack[i] = bus.read();
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(image, readBack, sizeof(image));
+  TEST_ASSERT_EQUAL_UINT32(16, slave.getCopies());
+}
+
+void test_rom_crc() {
+  uint8_t rom[8];
+  memcpy(rom, ROM_A, 8);
+  rom[7] = Ds2433Slave::crc8(rom, 7);
+  TEST_ASSERT_EQUAL_HEX8(0, Ds2433Slave::crc8(rom, 8));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_presence_follows_insert_and_remove);
+  RUN_TEST(test_search_and_read_rom);
+  RUN_TEST(test_read_memory_stops_at_the_end);
+  RUN_TEST(test_other_rom_is_not_selected);
+  RUN_TEST(test_write_read_and_copy_scratchpad);
+  RUN_TEST(test_full_scratchpad_sends_crc);
+  RUN_TEST(test_copy_with_wrong_authorization_is_rejected);
+  RUN_TEST(test_partial_byte_blocks_the_copy);
+  RUN_TEST(test_full_page_part_needs_whole_pages);
+  RUN_TEST(test_programming_delay_range);
+  RUN_TEST(test_whole_image_refill_cycle);
+  RUN_TEST(test_rom_crc);
+  return UNITY_END();
+}
@@ -0,0 +1,139 @@
+/*
+ * Channel Multiplexer Implementation
+ */
+
+#include "channel_mux.h"
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+ChannelMux::ChannelMux(Stream& serial) : serial(&serial) {
+  enabled = false;
+  eventHead = 0;
+  eventCount = 0;
+  logHead = 0;
+  logCount = 0;
+  pollHook = NULL;
+}
+
+void ChannelMux::writeFrame(char channel, bool more, const String& payload) {
+  serial->write((uint8_t) channel);
+  serial->write((uint8_t) (more ? '+' : ':'));
+  serial->println(payload);
+}
+
+bool ChannelMux::enqueue(String* queue, uint8_t& head, uint8_t& count, const String& message) {
+  if (count == MUX_QUEUE_SIZE) {
+    // Queue full - drop the oldest entry rather than block the caller
+    head = (head + 1) % MUX_QUEUE_SIZE;
+    count--;
+  }
+
+  queue[(head + count) % MUX_QUEUE_SIZE] = message;
+  count++;
+  return true;
+}
+
+void ChannelMux::send(MuxChannel channel, const String& message) {
+  if (!enabled) {
+    serial->println(message);
+    return;
+  }
+
+  writeFrame(channel, false, message);
+}
+
+void ChannelMux::post(MuxChannel channel, const String& message) {
+  if (!enabled) {
+    serial->println(message);
+    return;
+  }
+
+  if (channel == CH_EVENT) {
+    enqueue(eventQueue, eventHead, eventCount, message);
+  } else {
+    enqueue(logQueue, logHead, logCount, message);
+  }
+}
+
+void ChannelMux::pump() {
+  while (eventCount > 0) {
+    writeFrame(CH_EVENT, false, eventQueue[eventHead]);
+    eventQueue[eventHead] = "";
+    eventHead = (eventHead + 1) % MUX_QUEUE_SIZE;
+    eventCount--;
+  }
+
+  // Only one log line per pump so logs can't starve a transfer either
+  if (logCount > 0) {
+    writeFrame(CH_LOG, false, logQueue[logHead]);
+    logQueue[logHead] = "";
+    logHead = (logHead + 1) % MUX_QUEUE_SIZE;
+    logCount--;
+  }
+}
+
+void ChannelMux::sendBulk(const char* prefix, const uint8_t* data, uint16_t len) {
+  if (!enabled) {
+    // Legacy: one DATA line, built in a single buffer
+    String line;
+    line.reserve(strlen(prefix) + len * 2);
+    line += prefix;
+    for (uint16_t i = 0; i < len; i++) {
+      line += HEX_DIGITS[data[i] >> 4];
+      line += HEX_DIGITS[data[i] & 0x0F];
+    }
+    serial->println(line);
+    return;
+  }
+
+  String chunk;
+  chunk.reserve(strlen(prefix) + MUX_CHUNK_BYTES * 2);
+  chunk += prefix;
+
+  uint16_t offset = 0;
+  do {
+    uint16_t n = (len - offset > MUX_CHUNK_BYTES) ? MUX_CHUNK_BYTES : (len - offset);
+    for (uint16_t i = 0; i < n; i++) {
+      chunk += HEX_DIGITS[data[offset + i] >> 4];
+      chunk += HEX_DIGITS[data[offset + i] & 0x0F];
+    }
+    offset += n;
+
+    bool more = offset < len;
+    writeFrame(CH_DATA, more, chunk);
+    chunk = "";
+
+    if (more) {
+      // Give pending events a slot between every chunk
+      if (pollHook) pollHook();
+      pump();
+    }
+  } while (offset < len);
+}
+
+ChannelWriter::ChannelWriter(ChannelMux& mux, Stream& serial, MuxChannel channel)
+  : mux(mux), serial(serial), channel(channel) {
+}
+
+size_t ChannelWriter::write(uint8_t c) {
+  if (!mux.isEnabled()) {
+    return serial.write(c);
+  }
+
+  if (c == '\r') return 1;
+
+  if (c == '\n') {
+    mux.send(channel, line);
+    line = "";
+  } else {
+    line += (char) c;
+  }
+  return 1;
+}
+
+size_t ChannelWriter::write(const uint8_t* buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    write(buffer[i]);
+  }
+  return size;
+}
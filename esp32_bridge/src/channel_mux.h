@@ -0,0 +1,100 @@
+/*
+ * Channel Multiplexer
+ * Splits the serial link into tagged virtual channels
+ *
+ * Once enabled with MUX ON, every line sent to the host is framed as:
+ *
+ *   <tag><more><payload>\n
+ *
+ *   tag  - C (control), E (events), D (bulk data), L (logs)
+ *   more - '+' if the payload continues in the next frame of the
+ *          same channel, ':' if this is the final segment
+ *
+ * Bulk data is split into small chunks; queued events and logs are
+ * flushed between chunks so an event never waits for a full transfer.
+ */
+
+#ifndef CHANNEL_MUX_H
+#define CHANNEL_MUX_H
+
+#include <Arduino.h>
+
+// Bytes of payload per bulk frame (sent as twice as many hex chars)
+#ifndef MUX_CHUNK_BYTES
+  #define MUX_CHUNK_BYTES 32
+#endif
+
+// Pending event/log frames held while a transfer is in progress
+#ifndef MUX_QUEUE_SIZE
+  #define MUX_QUEUE_SIZE 8
+#endif
+
+enum MuxChannel {
+  CH_CONTROL = 'C',
+  CH_EVENT = 'E',
+  CH_DATA = 'D',
+  CH_LOG = 'L'
+};
+
+class ChannelMux {
+private:
+  Stream* serial;
+  bool enabled;
+
+  // Queued frames, events are always drained before logs
+  String eventQueue[MUX_QUEUE_SIZE];
+  uint8_t eventHead;
+  uint8_t eventCount;
+  String logQueue[MUX_QUEUE_SIZE];
+  uint8_t logHead;
+  uint8_t logCount;
+
+  // Called between bulk chunks so new events can be raised mid-transfer
+  void (*pollHook)();
+
+  void writeFrame(char channel, bool more, const String& payload);
+  bool enqueue(String* queue, uint8_t& head, uint8_t& count, const String& message);
+
+public:
+  ChannelMux(Stream& serial);
+
+  // Enable/disable framing (disabled = legacy newline protocol)
+  void setEnabled(bool on) { enabled = on; }
+  bool isEnabled() { return enabled; }
+
+  // Register a hook invoked between bulk chunks
+  void setPollHook(void (*hook)()) { pollHook = hook; }
+
+  // Send a complete message on a channel immediately
+  void send(MuxChannel channel, const String& message);
+
+  // Queue an event or log message, flushed by the next pump()
+  void post(MuxChannel channel, const String& message);
+
+  // Flush queued events, then queued logs
+  void pump();
+
+  // Send prefix + hex(data) on the data channel in small chunks,
+  // pumping queued events between chunks
+  void sendBulk(const char* prefix, const uint8_t* data, uint16_t len);
+};
+
+/*
+ * Print adapter that turns println() output into frames on one channel.
+ * When the mux is disabled bytes pass straight through to the serial port.
+ */
+class ChannelWriter : public Print {
+private:
+  ChannelMux& mux;
+  Stream& serial;
+  MuxChannel channel;
+  String line;
+
+public:
+  ChannelWriter(ChannelMux& mux, Stream& serial, MuxChannel channel);
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+};
+
+#endif
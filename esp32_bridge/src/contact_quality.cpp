@@ -0,0 +1,72 @@
+/*
+ * Contact Quality Implementation
+ */
+
+#include "contact_quality.h"
+
+// Datasheet windows (us)
+#define RISE_SLOW_US 5
+#define RISE_LIMIT_US 10
+#define PRESENCE_DELAY_MIN_US 15
+#define PRESENCE_DELAY_MAX_US 60
+#define PRESENCE_WIDTH_MIN_US 60
+#define PRESENCE_WIDTH_MAX_US 240
+
+ContactQuality::ContactQuality() {
+  absentRun = 0;
+  clear();
+}
+
+void ContactQuality::clear() {
+  score16 = 100 * 16;
+  memset(&last, 0, sizeof(last));
+  resets = 0;
+  missed = 0;
+}
+
+uint8_t ContactQuality::rate(const ResetTiming& timing) {
+  if (!timing.present) return 0;
+
+  int score = 100;
+
+  // A slow edge eats into the 15 us read sample window
+  if (timing.riseUs > RISE_SLOW_US) score -= 25;
+  if (timing.riseUs > RISE_LIMIT_US) score -= 35;
+
+  if (timing.delayUs < PRESENCE_DELAY_MIN_US || timing.delayUs > PRESENCE_DELAY_MAX_US) score -= 20;
+  if (timing.widthUs < PRESENCE_WIDTH_MIN_US || timing.widthUs > PRESENCE_WIDTH_MAX_US) score -= 20;
+
+  return score < 0 ? 0 : score;
+}
+
+void ContactQuality::record(const ResetTiming& timing) {
+  if (!timing.present) {
+    // An empty socket is not a bad contact: after a few misses in a row
+    // the cartridge is gone, and so is its history
+    if (absentRun >= CONTACT_ABSENT_RESETS) return;
+    if (++absentRun == CONTACT_ABSENT_RESETS) {
+      clear();
+      return;
+    }
+    missed++;
+  } else {
+    absentRun = 0;
+  }
+
+  resets++;
+  last = timing;
+
+  // Exponential average over roughly the last 8 resets
+  int32_t target = (int32_t) rate(timing) * 16;
+  score16 += (target - (int32_t) score16) / 8;
+}
+
+void ContactQuality::format(String& out) {
+  out += String(getScore());
+  out += "/";
+  out += String(last.delayUs);
+  out += "/";
+  out += String(last.widthUs);
+  out += "/";
+  out += String(last.riseUs);
+}
@@ -0,0 +1,72 @@
+/*
+ * Contact Quality
+ * Rolling per-socket score from the timing of every bus reset
+ *
+ * A clean contact shows a fast pull-up rise after the reset pulse and a
+ * presence pulse inside the datasheet window (15-60 us after the rise,
+ * 60-240 us wide). A dirty or loose contact slows the rise (a read slot is
+ * sampled 15 us in) and skews or drops the presence pulse. Each reset is
+ * rated 0-100 and folded into an exponential average; a cartridge that
+ * was removed starts over when it comes back.
+ *
+ * The handler uses the score up front: marginal contact gets retried
+ * resets, blocks and double reads, poor contact is refused for writes.
+ */
+
+#ifndef CONTACT_QUALITY_H
+#define CONTACT_QUALITY_H
+
+#include <Arduino.h>
+
+// Below this the handler retries resets, blocks and reads
+#ifndef CONTACT_MARGINAL_SCORE
+  #define CONTACT_MARGINAL_SCORE 80
+#endif
+
+// Below this writes are refused until the cartridge is reseated
+#ifndef CONTACT_POOR_SCORE
+  #define CONTACT_POOR_SCORE 40
+#endif
+
+// Resets without presence in a row that count as a removal
+#define CONTACT_ABSENT_RESETS 3
+
+struct ResetTiming {
+  bool present;
+  uint16_t riseUs;   // release of the reset pulse to line high
+  uint16_t delayUs;  // line high to presence pulse (tPDH)
+  uint16_t widthUs;  // presence pulse length (tPDL)
+};
+
+class ContactQuality {
+private:
+  uint16_t score16;  // score * 16
+  ResetTiming last;
+  uint32_t resets;
+  uint32_t missed;
+  uint8_t absentRun;
+
+  static uint8_t rate(const ResetTiming& timing);
+
+public:
+  ContactQuality();
+
+  // Fold in the timing of one reset
+  void record(const ResetTiming& timing);
+
+  // Forget the history (new cartridge)
+  void clear();
+
+  uint8_t getScore() const { return score16 / 16; }
+  bool isMarginal() const { return getScore() < CONTACT_MARGINAL_SCORE; }
+  bool isPoor() const { return getScore() < CONTACT_POOR_SCORE; }
+
+  const ResetTiming& getLast() const { return last; }
+  uint32_t getResets() const { return resets; }
+  uint32_t getMissed() const { return missed; }
+
+  // Append "<score>/<delay_us>/<width_us>/<rise_us>" to out
+  void format(String& out);
+};
+
+#endif
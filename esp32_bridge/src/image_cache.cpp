@@ -0,0 +1,80 @@
+/*
+ * Image Cache Implementation
+ */
+
+#include "image_cache.h"
+
+ImageCache::ImageCache() : useCounter(0) {
+  for (uint8_t i = 0; i < IMAGE_CACHE_SIZE; i++) {
+    entries[i].used = false;
+  }
+}
+
+CachedImage* ImageCache::find(const uint8_t* rom) {
+  for (uint8_t i = 0; i < IMAGE_CACHE_SIZE; i++) {
+    if (entries[i].used && memcmp(entries[i].rom, rom, 8) == 0) {
+      entries[i].lastUse = ++useCounter;
+      return &entries[i];
+    }
+  }
+  return nullptr;
+}
+
+void ImageCache::update(const uint8_t* rom, uint16_t addr, const uint8_t* data, uint16_t len) {
+  if (addr >= IMAGE_CACHE_BYTES) {
+    return;
+  }
+  if (len > IMAGE_CACHE_BYTES - addr) {
+    len = IMAGE_CACHE_BYTES - addr;
+  }
+
+  CachedImage* entry = find(rom);
+  if (entry == nullptr) {
+    // Take a free slot, or evict the least recently used one
+    entry = &entries[0];
+    for (uint8_t i = 0; i < IMAGE_CACHE_SIZE; i++) {
+      if (!entries[i].used) {
+        entry = &entries[i];
+        break;
+      }
+      if (entries[i].lastUse < entry->lastUse) {
+        entry = &entries[i];
+      }
+    }
+
+    entry->used = true;
+    memcpy(entry->rom, rom, 8);
+    memset(entry->valid, 0, sizeof(entry->valid));
+    entry->lastUse = ++useCounter;
+  }
+
+  memcpy(entry->data + addr, data, len);
+  for (uint16_t i = addr; i < addr + len; i++) {
+    entry->valid[i / 8] |= 1 << (i % 8);
+  }
+}
+
+const uint8_t* ImageCache::get(const uint8_t* rom, uint16_t len) {
+  if (len > IMAGE_CACHE_BYTES) {
+    return nullptr;
+  }
+
+  CachedImage* entry = find(rom);
+  if (entry == nullptr) {
+    return nullptr;
+  }
+
+  for (uint16_t i = 0; i < len; i++) {
+    if (!(entry->valid[i / 8] & (1 << (i % 8)))) {
+      return nullptr;
+    }
+  }
+  return entry->data;
+}
+
+void ImageCache::forget(const uint8_t* rom) {
+  CachedImage* entry = find(rom);
+  if (entry != nullptr) {
+    entry->used = false;
+  }
+}
@@ -0,0 +1,55 @@
+/*
+ * Image Cache
+ * Last known EEPROM contents per ROM, kept in RAM
+ *
+ * Every successful read and write goes through the cache, so after the
+ * host has read a cartridge the bridge knows its image. PATCH then only
+ * needs the bytes that change instead of the whole image.
+ */
+
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <Arduino.h>
+
+// Cartridges remembered (least recently used is evicted)
+#ifndef IMAGE_CACHE_SIZE
+  #ifdef ESP8266
+    #define IMAGE_CACHE_SIZE 1
+  #else
+    #define IMAGE_CACHE_SIZE 4
+  #endif
+#endif
+
+// Bytes cached per cartridge (the most READ/WRITE transfer)
+#define IMAGE_CACHE_BYTES 512
+
+struct CachedImage {
+  bool used;
+  uint8_t rom[8];
+  uint32_t lastUse;
+  uint8_t data[IMAGE_CACHE_BYTES];
+  uint8_t valid[IMAGE_CACHE_BYTES / 8];  // one bit per known byte
+};
+
+class ImageCache {
+private:
+  CachedImage entries[IMAGE_CACHE_SIZE];
+  uint32_t useCounter;
+
+  CachedImage* find(const uint8_t* rom);
+
+public:
+  ImageCache();
+
+  // Record bytes read from or written to a cartridge
+  void update(const uint8_t* rom, uint16_t addr, const uint8_t* data, uint16_t len);
+
+  // Cached image if bytes 0..len-1 are all known, otherwise nullptr
+  const uint8_t* get(const uint8_t* rom, uint16_t len);
+
+  // Forget a cartridge whose contents are uncertain (failed write)
+  void forget(const uint8_t* rom);
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * Job Queue Implementation
+ */
+
+#include "job_queue.h"
+
+JobQueue::JobQueue() : resultHead(0), resultCount(0), added(false), backupSeq(0) {
+  for (uint8_t i = 0; i < JOB_QUEUE_SIZE; i++) {
+    jobs[i].used = false;
+  }
+}
+
+Job* JobQueue::find(const String& rom) {
+  for (uint8_t i = 0; i < JOB_QUEUE_SIZE; i++) {
+    if (jobs[i].used && jobs[i].rom.equalsIgnoreCase(rom)) {
+      return &jobs[i];
+    }
+  }
+  return nullptr;
+}
+
+bool JobQueue::add(const String& rom, const uint8_t* data, uint16_t size) {
+  Job* job = find(rom);
+
+  for (uint8_t i = 0; job == nullptr && i < JOB_QUEUE_SIZE; i++) {
+    if (!jobs[i].used) {
+      job = &jobs[i];
+    }
+  }
+
+  if (job == nullptr) {
+    return false;
+  }
+
+  job->used = true;
+  job->rom = rom;
+  job->rom.toLowerCase();
+  job->size = size;
+  memcpy(job->data, data, size);
+  added = true;
+  return true;
+}
+
+void JobQueue::clear() {
+  for (uint8_t i = 0; i < JOB_QUEUE_SIZE; i++) {
+    jobs[i].used = false;
+  }
+  resultCount = 0;
+  added = false;
+}
+
+uint8_t JobQueue::pending() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < JOB_QUEUE_SIZE; i++) {
+    if (jobs[i].used) {
+      count++;
+    }
+  }
+  return count;
+}
+
+void JobQueue::addResult(const String& rom, JobStatus status) {
+  if (resultCount == JOB_RESULT_SIZE) {
+    resultHead = (resultHead + 1) % JOB_RESULT_SIZE;
+    resultCount--;
+  }
+
+  JobResult& result = results[(resultHead + resultCount) % JOB_RESULT_SIZE];
+  result.rom = rom;
+  result.status = status;
+  resultCount++;
+}
+
+bool JobQueue::run(OneWireHandler& owHandler) {
+  Job* job = find(owHandler.getRomAddress());
+  if (job == nullptr) {
+    return false;
+  }
+
+  // Poor contact: leave the job staged for a better seating rather than
+  // start a write that is expected to fail
+  if (owHandler.getContact().isPoor()) {
+    return false;
+  }
+
+  // Keep what the cartridge held; without it the job isn't run. Read
+  // aside so a failed read doesn't clobber the oldest kept backup.
+  uint8_t previous[512];
+  if (!owHandler.read(0, previous, job->size)) {
+    addResult(job->rom, JOB_BACKUP_FAILED);
+    return true;
+  }
+  JobBackup& backup = backups[backupSeq % JOB_BACKUP_SIZE];
+  memcpy(backup.data, previous, job->size);
+  backup.seq = ++backupSeq;
+  backup.timeMs = millis();
+  backup.rom = job->rom;
+  backup.size = job->size;
+
+  JobStatus status = JOB_OK;
+  if (!owHandler.write(0, job->data, job->size)) {
+    status = JOB_WRITE_FAILED;
+  } else {
+    uint8_t verify[512];
+    if (!owHandler.read(0, verify, job->size) || memcmp(verify, job->data, job->size) != 0) {
+      status = JOB_VERIFY_FAILED;
+    }
+  }
+
+  addResult(job->rom, status);
+
+  // A failed job stays queued and is retried when the cartridge is reseated
+  if (status == JOB_OK) {
+    job->used = false;
+  }
+  return true;
+}
+
+const JobBackup* JobQueue::backupAfter(uint32_t since) {
+  if (since >= backupSeq) return nullptr;
+
+  // Backups still in the ring: the last JOB_BACKUP_SIZE
+  uint32_t first = backupSeq > JOB_BACKUP_SIZE ? backupSeq - JOB_BACKUP_SIZE + 1 : 1;
+  if (since + 1 > first) first = since + 1;
+  if (first > backupSeq) return nullptr;
+  return &backups[(first - 1) % JOB_BACKUP_SIZE];
+}
+
+String JobQueue::takeResults() {
+  String out = "";
+  for (uint8_t i = 0; i < resultCount; i++) {
+    const JobResult& result = results[(resultHead + i) % JOB_RESULT_SIZE];
+    if (i > 0) out += ",";
+    out += result.rom;
+    out += "=";
+    out += statusName(result.status);
+  }
+  resultHead = 0;
+  resultCount = 0;
+  return out;
+}
+
+const char* JobQueue::statusName(JobStatus status) {
+  switch (status) {
+    case JOB_OK: return "OK";
+    case JOB_WRITE_FAILED: return "WRITE_FAILED";
+    case JOB_VERIFY_FAILED: return "VERIFY_FAILED";
+    case JOB_BACKUP_FAILED: return "BACKUP_FAILED";
+  }
+  return "UNKNOWN";
+}
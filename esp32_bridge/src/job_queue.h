@@ -0,0 +1,121 @@
+/*
+ * Job Queue
+ * Images staged by the host, written when the matching cartridge appears
+ *
+ * The host uploads encoded images keyed by ROM address (JOB). While jobs
+ * are pending the bridge polls the bus; when a cartridge with a queued ROM
+ * is inserted its image is written and read back without any host round
+ * trip. Outcomes are kept until the host collects them in one batch
+ * (RESULTS).
+ *
+ * Before writing, the image the cartridge held is read and kept in a RAM
+ * ring of backups, numbered like the station's backup log, until newer
+ * ones push it out; the host fetches them with BACKUP <since>.
+ */
+
+#ifndef JOB_QUEUE_H
+#define JOB_QUEUE_H
+
+#include <Arduino.h>
+#include "onewire_handler.h"
+
+// Staged images held in RAM (512 bytes each)
+#ifndef JOB_QUEUE_SIZE
+  #ifdef ESP8266
+    #define JOB_QUEUE_SIZE 4
+  #else
+    #define JOB_QUEUE_SIZE 16
+  #endif
+#endif
+
+// Outcomes kept until collected (oldest dropped when full)
+#ifndef JOB_RESULT_SIZE
+  #define JOB_RESULT_SIZE 32
+#endif
+
+// Pre-write images kept (oldest dropped when full, 512 bytes each)
+#ifndef JOB_BACKUP_SIZE
+  #ifdef ESP8266
+    #define JOB_BACKUP_SIZE 2
+  #else
+    #define JOB_BACKUP_SIZE 8
+  #endif
+#endif
+
+enum JobStatus {
+  JOB_OK,
+  JOB_WRITE_FAILED,
+  JOB_VERIFY_FAILED,
+  JOB_BACKUP_FAILED      // pre-write read failed, nothing written
+};
+
+struct Job {
+  bool used;
+  String rom;
+  uint16_t size;
+  uint8_t data[512];
+};
+
+struct JobResult {
+  String rom;
+  JobStatus status;
+};
+
+struct JobBackup {
+  uint32_t seq;
+  uint32_t timeMs;       // millis() when it was read
+  String rom;
+  uint16_t size;
+  uint8_t data[512];
+};
+
+class JobQueue {
+private:
+  Job jobs[JOB_QUEUE_SIZE];
+  JobResult results[JOB_RESULT_SIZE];
+  uint8_t resultHead;
+  uint8_t resultCount;
+  bool added;
+
+  JobBackup backups[JOB_BACKUP_SIZE];
+  uint32_t backupSeq;    // seq of the newest backup, 0 if none
+
+  Job* find(const String& rom);
+  void addResult(const String& rom, JobStatus status);
+
+public:
+  JobQueue();
+
+  // Stage an image for a ROM, replacing any earlier one for the same ROM
+  bool add(const String& rom, const uint8_t* data, uint16_t size);
+
+  // Drop all staged images and uncollected results
+  void clear();
+
+  // Number of staged images
+  uint8_t pending();
+
+  // Number of results waiting to be collected
+  uint8_t completed() { return resultCount; }
+
+  // True once after add(), so a cartridge already seated when its job
+  // arrives is written without waiting for the next insertion
+  bool takeAdded() { bool was = added; added = false; return was; }
+
+  // Back up, write and verify the staged image for the device owHandler
+  // found by search(), if any (jobs wait while the contact is poor).
+  // Returns true if a job ran.
+  bool run(OneWireHandler& owHandler);
+
+  // Oldest kept backup newer than since, or nullptr
+  const JobBackup* backupAfter(uint32_t since);
+
+  uint32_t getBackupSeq() { return backupSeq; }
+
+  // Return "<rom>=<status>,..." for every result and forget them
+  String takeResults();
+
+  static const char* statusName(JobStatus status);
+};
+
+#endif
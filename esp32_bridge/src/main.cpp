@@ -10,11 +10,21 @@
  * - ESP32/ESP32-C3: GPIO4 - 1-wire data line (with 4.7k pull-up to 3.3V)
  * - ESP8266: GPIO4 (D2) - 1-wire data line (with 4.7k pull-up to 3.3V)
  * - Serial: Command interface (115200 baud, USB or UART)
+ *
+ * When the host enables channel framing (MUX ON), the bridge also watches
+ * the bus while idle and reports CARTRIDGE_INSERTED / CARTRIDGE_REMOVED
+ * on the event channel.
+ *
+ * While staged jobs are pending (JOB) the bus is watched with or without
+ * a host, and a cartridge whose ROM has a job is written on insertion
+ * (or straight away if it is already seated when the job arrives).
  */
 
 #include <Arduino.h>
 #include "onewire_handler.h"
 #include "serial_protocol.h"
+#include "channel_mux.h"
+#include "job_queue.h"
 
 // Pin configuration - set by build flags in platformio.ini
 #ifndef ONEWIRE_PIN
@@ -25,8 +35,72 @@
   #define BOARD_NAME "ESP32"  // Default board name
 #endif
 
+// Presence poll interval while idle with framing enabled
+#ifndef PRESENCE_POLL_MS
+  #define PRESENCE_POLL_MS 250
+#endif
+
 OneWireHandler owHandler(ONEWIRE_PIN);
 SerialProtocol protocol;
+JobQueue jobs;
+ChannelMux mux(Serial);
+ChannelWriter controlOut(mux, Serial, CH_CONTROL);
+ChannelWriter logOut(mux, Serial, CH_LOG);
+
+bool cartridgePresent = false;
+bool insertPending = false;
+String cartridgeRom = "";
+unsigned long lastPresenceCheck = 0;
+
+// Report an insertion seen by checkPresence()
+void reportInsertion() {
+  if (!insertPending) {
+    return;
+  }
+  insertPending = false;
+  mux.post(CH_EVENT, "CARTRIDGE_INSERTED:" + cartridgeRom);
+}
+
+// Track presence changes. This is also the mux poll hook, which runs
+// between the DATA chunks of a response, so it only resets and searches:
+// jobs and the insertion event wait for serviceJobs()
+void checkPresence() {
+  lastPresenceCheck = millis();
+
+  bool present = owHandler.reset();
+  if (present == cartridgePresent) {
+    return;
+  }
+
+  if (present) {
+    // Only report once the ROM can be read, otherwise retry next poll
+    if (!owHandler.search()) {
+      return;
+    }
+    cartridgeRom = owHandler.getRomAddress();
+    insertPending = true;
+  } else {
+    reportInsertion();
+    mux.post(CH_EVENT, "CARTRIDGE_REMOVED:" + cartridgeRom);
+  }
+
+  cartridgePresent = present;
+}
+
+// Write staged images, from loop() between commands only. A newly
+// inserted cartridge gets its job before the insertion is reported, so
+// the host never reads it half written; a new job also goes to a
+// cartridge that is already seated. Outcomes go to RESULTS.
+void serviceJobs() {
+  bool added = jobs.takeAdded();
+
+  if (insertPending) {
+    jobs.run(owHandler);
+    reportInsertion();
+  } else if (added && owHandler.reset() && owHandler.search()) {
+    jobs.run(owHandler);
+  }
+}
 
 void setup() {
   // Initialize Serial
@@ -36,11 +110,16 @@ void setup() {
   delay(500);
 
   Serial.print(BOARD_NAME);
-  Serial.println(" 1-Wire Bridge v1.0");
+  Serial.print(" 1-Wire Bridge ");
+  Serial.println(FIRMWARE_VERSION);
   Serial.println("Ready");
+
+  mux.setPollHook(checkPresence);
 }
 
 void loop() {
+  serviceJobs();
+
   // Check for incoming commands
   if (Serial.available()) {
     String command = Serial.readStringUntil('\n');
@@ -51,6 +130,11 @@ void loop() {
     }
 
     // Process command
-    protocol.processCommand(command, owHandler, Serial);
+    protocol.processCommand(command, owHandler, jobs, mux, controlOut, logOut);
+  }
+  else if ((mux.isEnabled() || jobs.pending() > 0) && millis() - lastPresenceCheck > PRESENCE_POLL_MS) {
+    checkPresence();
   }
+
+  mux.pump();
 }
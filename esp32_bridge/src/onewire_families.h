@@ -0,0 +1,60 @@
+/*
+ * OneWire Device Families
+ * Geometry, commands and programming times of supported EEPROMs
+ *
+ * The family code is byte 0 of the ROM address. The write engine plans
+ * scratchpad writes and delays from the matching entry instead of using
+ * DS2433 worst-case values for every part.
+ */
+
+#ifndef ONEWIRE_FAMILIES_H
+#define ONEWIRE_FAMILIES_H
+
+#include <stdint.h>
+
+// Commands shared by every supported part
+#define OW_CMD_READ_ROM 0x33
+#define OW_CMD_MATCH_ROM 0x55
+#define OW_CMD_SKIP_ROM 0xCC
+#define OW_CMD_SEARCH_ROM 0xF0
+
+// Byte read back once a copy scratchpad has completed (alternating 1/0)
+#define OW_COPY_DONE 0xAA
+
+// Largest scratchpad of any supported part
+#define OW_MAX_PAGE_SIZE 32
+
+struct OneWireFamily {
+  uint8_t code;                // ROM byte 0
+  const char* name;
+  uint16_t memorySize;         // bytes of user memory
+  uint8_t pageSize;            // scratchpad size (bytes per copy)
+  bool fullPageWrite;          // scratchpad must be filled completely
+  uint8_t cmdReadMemory;
+  uint8_t cmdWriteScratchpad;
+  uint8_t cmdReadScratchpad;
+  uint8_t cmdCopyScratchpad;
+  uint16_t progTypicalUs;      // typical tPROG (the emulator's default)
+  uint16_t progMaxUs;          // datasheet tPROG maximum, waited before the status read
+};
+
+static const OneWireFamily ONEWIRE_FAMILIES[] = {
+  // code  name        size  page  full   read  wsp   rsp   copy  typ    max
+  { 0x23, "DS2433",    512,  32,   false, 0xF0, 0x0F, 0xAA, 0x55, 3000,  5000 },
+  { 0x2D, "DS2431",    128,  8,    true,  0xF0, 0x0F, 0xAA, 0x55, 7000,  10000 },
+  { 0x43, "DS28EC20",  2560, 32,   false, 0xF0, 0x0F, 0xAA, 0x55, 7000,  10000 },
+};
+
+// Unknown families are treated as DS2433 (the cartridge part)
+static const OneWireFamily& DEFAULT_FAMILY = ONEWIRE_FAMILIES[0];
+
+static inline const OneWireFamily& findFamily(uint8_t code) {
+  for (uint8_t i = 0; i < sizeof(ONEWIRE_FAMILIES) / sizeof(ONEWIRE_FAMILIES[0]); i++) {
+    if (ONEWIRE_FAMILIES[i].code == code) {
+      return ONEWIRE_FAMILIES[i];
+    }
+  }
+  return DEFAULT_FAMILY;
+}
+
+#endif
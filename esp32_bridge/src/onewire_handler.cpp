@@ -3,13 +3,48 @@
  */
 
 #include "onewire_handler.h"
-
-OneWireHandler::OneWireHandler(uint8_t pin) : ow(pin) {
+#include <util/OneWire_direct_gpio.h>
+
+// Reset timing (us)
+#define RESET_LOW_US 480
+#define RESET_SLOT_US 480      // release to end of the presence window
+#define IDLE_WAIT_US 250       // line must be high before a reset
+#define RISE_WAIT_US 15
+#define PRESENCE_WAIT_US 120
+#define PRESENCE_MAX_US 300    // longer is a stuck or shorted line
+
+// The release and presence window of a reset are timed with interrupts
+// off (at most RISE_WAIT_US + PRESENCE_WAIT_US + PRESENCE_MAX_US); the
+// 480 us low phase is not, a longer one is still a reset
+#if defined(ARDUINO_ARCH_ESP32)
+  static portMUX_TYPE timingMux = portMUX_INITIALIZER_UNLOCKED;
+  #define TIMING_BEGIN() portENTER_CRITICAL(&timingMux)
+  #define TIMING_END() portEXIT_CRITICAL(&timingMux)
+#else
+  #define TIMING_BEGIN() noInterrupts()
+  #define TIMING_END() interrupts()
+#endif
+
+OneWireHandler::OneWireHandler(uint8_t busPin) : ow(busPin) {
+  baseReg = PIN_TO_BASEREG(busPin);
+  bitmask = PIN_TO_BITMASK(busPin);
   deviceFound = false;
+  family = &DEFAULT_FAMILY;
   memset(romAddress, 0, 8);
+  resetProgStats();
 }
 
 bool OneWireHandler::search() {
+  // Timed reset first, so a newly seated cartridge's contact is scored
+  // (the library's search resets again)
+  if (!reset()) {
+    deviceFound = false;
+    return false;
+  }
+
+  // Always start a fresh search so repeated calls find the same device
+  ow.reset_search();
+
   if (!ow.search(romAddress)) {
     deviceFound = false;
     ow.reset_search();
@@ -22,6 +57,7 @@ bool OneWireHandler::search() {
     return false;
   }
 
+  family = &findFamily(romAddress[0]);
   deviceFound = true;
   return true;
 }
@@ -35,26 +71,105 @@ String OneWireHandler::getRomAddress() {
   return result;
 }
 
+ResetTiming OneWireHandler::timedReset() {
+  ResetTiming timing = { false, 0, 0, 0 };
+
+  // Direct register access as in the OneWire library: digitalRead() and
+  // pinMode() would add their own latency to the rise time
+  IO_REG_TYPE mask IO_REG_MASK_ATTR = bitmask;
+  volatile IO_REG_TYPE* reg IO_REG_BASE_ATTR = baseReg;
+
+  // Wait for an idle (high) line; one held low is shorted
+  DIRECT_MODE_INPUT(reg, mask);
+  unsigned long start = micros();
+  while (!DIRECT_READ(reg, mask)) {
+    if (micros() - start > IDLE_WAIT_US) return timing;
+  }
+
+  DIRECT_WRITE_LOW(reg, mask);
+  DIRECT_MODE_OUTPUT(reg, mask);
+  delayMicroseconds(RESET_LOW_US);
+
+  TIMING_BEGIN();
+  DIRECT_MODE_INPUT(reg, mask);
+  unsigned long released = micros();
+
+  // Pull-up rise, then the presence pulse
+  while (!DIRECT_READ(reg, mask) && micros() - released < RISE_WAIT_US);
+  unsigned long high = micros();
+
+  while (DIRECT_READ(reg, mask) && micros() - high < PRESENCE_WAIT_US);
+  unsigned long fall = micros();
+
+  if (!DIRECT_READ(reg, mask)) {
+    while (!DIRECT_READ(reg, mask) && micros() - fall < PRESENCE_MAX_US);
+    unsigned long end = micros();
+
+    timing.present = end - fall < PRESENCE_MAX_US;
+    timing.delayUs = fall - high;
+    timing.widthUs = end - fall;
+  }
+  TIMING_END();
+
+  timing.riseUs = high - released;
+
+  // Let the presence window run out before the next slot
+  unsigned long elapsed = micros() - released;
+  if (elapsed < RESET_SLOT_US) {
+    delayMicroseconds(RESET_SLOT_US - elapsed);
+  }
+  return timing;
+}
+
 bool OneWireHandler::reset() {
-  uint8_t result = ow.reset();
-  // 0 = no presence, 1 = presence detected, 2 = short circuit
-  return result == 1;
+  ResetTiming timing = timedReset();
+  contact.record(timing);
+  return timing.present;
+}
+
+bool OneWireHandler::select() {
+  // Marginal contact: a missed presence pulse is worth another try
+  uint8_t attempts = contact.isMarginal() ? CONTACT_RETRIES : 1;
+  bool present = false;
+  for (uint8_t i = 0; i < attempts && !present; i++) {
+    present = reset();
+  }
+  if (!present) return false;
+
+  ow.write(OW_CMD_MATCH_ROM);
+  for (int i = 0; i < 8; i++) {
+    ow.write(romAddress[i]);
+  }
+  return true;
 }
 
 bool OneWireHandler::read(uint16_t addr, uint8_t* buffer, uint16_t len) {
   if (!deviceFound) return false;
 
-  // Reset bus
-  if (!reset()) return false;
+  if (!contact.isMarginal()) {
+    return readOnce(addr, buffer, len);
+  }
 
-  // Select device
-  ow.write(CMD_MATCH_ROM);
-  for (int i = 0; i < 8; i++) {
-    ow.write(romAddress[i]);
+  // Marginal contact: only accept data that reads the same twice
+  for (uint8_t i = 0; i < CONTACT_RETRIES; i++) {
+    if (!readOnce(addr, buffer, len)) continue;
+    uint16_t first = OneWire::crc16(buffer, len);
+
+    if (readOnce(addr, buffer, len) && OneWire::crc16(buffer, len) == first) {
+      return true;
+    }
   }
 
+  cache.forget(romAddress);
+  return false;
+}
+
+bool OneWireHandler::readOnce(uint16_t addr, uint8_t* buffer, uint16_t len) {
+  // Reset bus and select device
+  if (!select()) return false;
+
   // Read memory command
-  ow.write(CMD_READ_MEMORY);
+  ow.write(family->cmdReadMemory);
   ow.write(addr & 0xFF);        // TA1 (address low byte)
   ow.write((addr >> 8) & 0xFF); // TA2 (address high byte)
 
@@ -63,22 +178,45 @@ bool OneWireHandler::read(uint16_t addr, uint8_t* buffer, uint16_t len) {
     buffer[i] = ow.read();
   }
 
+  cache.update(romAddress, addr, buffer, len);
   return true;
 }
 
-bool OneWireHandler::writeBlock(uint16_t addr, const uint8_t* data, uint8_t len) {
-  if (len > 32) len = 32;  // DS2433 scratchpad is 32 bytes
+bool OneWireHandler::waitProgrammed() {
+  unsigned long start = micros();
 
-  // Reset and select device
-  if (!reset()) return false;
+  // Leave the bus idle for the datasheet tPROG maximum of this part (a
+  // slot during programming disturbs it), then read the status once: a
+  // part that hasn't answered with alternating 1/0 by then has failed
+  delayMicroseconds(family->progMaxUs);
 
-  ow.write(CMD_MATCH_ROM);
-  for (int i = 0; i < 8; i++) {
-    ow.write(romAddress[i]);
+  uint8_t status = ow.read();
+  bool done = status == OW_COPY_DONE || status == (uint8_t) ~OW_COPY_DONE;
+
+  uint32_t elapsed = micros() - start;
+  progCount++;
+  progTotalUs += elapsed;
+  progLastUs = elapsed;
+  return done;
+}
+
+bool OneWireHandler::writeBlock(uint16_t addr, const uint8_t* data, uint8_t len) {
+  // Marginal contact: rewriting a block that didn't verify is harmless
+  uint8_t attempts = contact.isMarginal() ? CONTACT_RETRIES : 1;
+  for (uint8_t i = 0; i < attempts; i++) {
+    if (writeBlockOnce(addr, data, len)) return true;
   }
+  return false;
+}
+
+bool OneWireHandler::writeBlockOnce(uint16_t addr, const uint8_t* data, uint8_t len) {
+  if (len > family->pageSize) len = family->pageSize;
+
+  // Reset and select device
+  if (!select()) return false;
 
   // Write scratchpad
-  ow.write(CMD_WRITE_SCRATCHPAD);
+  ow.write(family->cmdWriteScratchpad);
   ow.write(addr & 0xFF);
   ow.write((addr >> 8) & 0xFF);
 
@@ -86,18 +224,10 @@ bool OneWireHandler::writeBlock(uint16_t addr, const uint8_t* data, uint8_t len)
     ow.write(data[i]);
   }
 
-  // Delay for scratchpad write
-  delay(10);
-
   // Read scratchpad to verify
-  if (!reset()) return false;
-
-  ow.write(CMD_MATCH_ROM);
-  for (int i = 0; i < 8; i++) {
-    ow.write(romAddress[i]);
-  }
+  if (!select()) return false;
 
-  ow.write(CMD_READ_SCRATCHPAD);
+  ow.write(family->cmdReadScratchpad);
 
   uint8_t ta1 = ow.read();
   uint8_t ta2 = ow.read();
@@ -116,38 +246,51 @@ bool OneWireHandler::writeBlock(uint16_t addr, const uint8_t* data, uint8_t len)
   }
 
   // Copy scratchpad to EEPROM
-  if (!reset()) return false;
-
-  ow.write(CMD_MATCH_ROM);
-  for (int i = 0; i < 8; i++) {
-    ow.write(romAddress[i]);
-  }
+  if (!select()) return false;
 
-  ow.write(CMD_COPY_SCRATCHPAD);
+  ow.write(family->cmdCopyScratchpad);
   ow.write(ta1);
   ow.write(ta2);
   ow.write(es);
 
-  // Wait for copy to complete (typically 10ms)
-  delay(15);
-
-  return true;
+  return waitProgrammed();
 }
 
 bool OneWireHandler::write(uint16_t addr, const uint8_t* data, uint16_t len) {
-  if (!deviceFound) return false;
+  // A write on poor contact is expected to fail part way: don't start it
+  if (!deviceFound || contact.isPoor()) return false;
+
+  if (addr >= family->memorySize || len > family->memorySize - addr) return false;
 
-  // Write in 32-byte blocks
+  uint8_t pageSize = family->pageSize;
+  uint8_t page[OW_MAX_PAGE_SIZE];
+
+  // Split into blocks that never cross a page boundary
   uint16_t offset = 0;
   while (offset < len) {
-    uint8_t blockSize = (len - offset > 32) ? 32 : (len - offset);
-
-    if (!writeBlock(addr + offset, data + offset, blockSize)) {
+    uint16_t blockAddr = addr + offset;
+    uint8_t pageOffset = blockAddr % pageSize;
+    uint16_t blockSize = pageSize - pageOffset;
+    if (blockSize > len - offset) blockSize = len - offset;
+
+    if (family->fullPageWrite && blockSize != pageSize) {
+      // Part only copies complete pages: merge with the current contents
+      uint16_t pageAddr = blockAddr - pageOffset;
+      if (!read(pageAddr, page, pageSize)) return false;
+      memcpy(page + pageOffset, data + offset, blockSize);
+
+      if (!writeBlock(pageAddr, page, pageSize)) {
+        cache.forget(romAddress);
+        return false;
+      }
+    } else if (!writeBlock(blockAddr, data + offset, blockSize)) {
+      cache.forget(romAddress);
       return false;
     }
 
     offset += blockSize;
   }
 
+  cache.update(romAddress, addr, data, len);
   return true;
 }
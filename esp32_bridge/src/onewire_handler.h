@@ -1,6 +1,15 @@
 /*
  * OneWire Handler
  * Manages DS2433/DS2432 EEPROM operations via 1-wire protocol
+ *
+ * Page size, commands and programming times come from the device family
+ * table (onewire_families.h), selected by the family code of the ROM found
+ * by search().
+ *
+ * reset() times the reset/presence exchange itself and feeds the contact
+ * score (contact_quality.h). With marginal contact resets and blocks are
+ * retried and reads are done twice and compared; with poor contact writes
+ * are refused. Programming waits always use the datasheet maximum.
  */
 
 #ifndef ONEWIRE_HANDLER_H
@@ -8,22 +17,47 @@
 
 #include <Arduino.h>
 #include <OneWire.h>
+#include "onewire_families.h"
+#include "image_cache.h"
+#include "contact_quality.h"
+
+// Attempts per reset, block write or read when the contact is marginal
+#ifndef CONTACT_RETRIES
+  #define CONTACT_RETRIES 3
+#endif
 
 class OneWireHandler {
 private:
   OneWire ow;
+  IO_REG_TYPE bitmask;
+  volatile IO_REG_TYPE* baseReg;
   uint8_t romAddress[8];
   bool deviceFound;
+  const OneWireFamily* family;
+  ImageCache cache;
+  ContactQuality contact;
+
+  // Copy scratchpad programming waits (for STATS)
+  uint32_t progCount;
+  uint32_t progTotalUs;
+  uint32_t progLastUs;
+
+  // Reset pulse with presence pulse and rise timing
+  ResetTiming timedReset();
+
+  // Reset the bus and address the found device
+  bool select();
+
+  // One pass of read()
+  bool readOnce(uint16_t addr, uint8_t* buffer, uint16_t len);
 
-  // DS2433 Commands
-  static const uint8_t CMD_READ_MEMORY = 0xF0;
-  static const uint8_t CMD_WRITE_SCRATCHPAD = 0x0F;
-  static const uint8_t CMD_READ_SCRATCHPAD = 0xAA;
-  static const uint8_t CMD_COPY_SCRATCHPAD = 0x55;
-  static const uint8_t CMD_MATCH_ROM = 0x55;
+  // Wait for a copy scratchpad to finish programming
+  bool waitProgrammed();
 
   // Write a block to scratchpad, verify, and copy to EEPROM
+  // The block must not cross a page boundary
   bool writeBlock(uint16_t addr, const uint8_t* data, uint8_t len);
+  bool writeBlockOnce(uint16_t addr, const uint8_t* data, uint8_t len);
 
 public:
   OneWireHandler(uint8_t pin);
@@ -34,7 +68,13 @@ public:
   // Get the ROM address as hex string
   String getRomAddress();
 
-  // Reset the 1-wire bus
+  // Name of the detected device family (e.g. "DS2433")
+  const char* getFamilyName() { return family->name; }
+
+  // Size of the detected part's user memory in bytes
+  uint16_t getMemorySize() { return family->memorySize; }
+
+  // Reset the 1-wire bus (timed, updates the contact score)
   bool reset();
 
   // Get raw reset result for debugging (0=no presence, 1=presence, 2=short)
@@ -48,6 +88,19 @@ public:
 
   // Check if device is found
   bool isDeviceFound() { return deviceFound; }
+
+  // Last known image of the found device if its first len bytes have
+  // been read or written, otherwise nullptr
+  const uint8_t* getCachedImage(uint16_t len) { return cache.get(romAddress, len); }
+
+  // Contact score of the current cartridge
+  ContactQuality& getContact() { return contact; }
+
+  // Programming wait statistics
+  uint32_t getProgCount() { return progCount; }
+  uint32_t getProgTotalUs() { return progTotalUs; }
+  uint32_t getProgLastUs() { return progLastUs; }
+  void resetProgStats() { progCount = 0; progTotalUs = 0; progLastUs = 0; }
 };
 
 #endif
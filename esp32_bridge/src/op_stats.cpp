@@ -0,0 +1,84 @@
+/*
+ * Operation Statistics Implementation
+ */
+
+#include "op_stats.h"
+
+static const char* TIMED_OPS[] = { "SEARCH", "RESET", "READ", "WRITE", "PATCH" };
+
+OpStats::OpStats() {
+  for (uint8_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    ops[i].name = TIMED_OPS[i];
+  }
+  traceSeq = 0;
+  reset();
+}
+
+void OpStats::record(const String& command, uint32_t startMs, uint32_t elapsedUs, uint16_t bytes) {
+  int space = command.indexOf(' ');
+  String op = space == -1 ? command : command.substring(0, space);
+
+  for (uint8_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (op == ops[i].name) {
+      ops[i].count++;
+      ops[i].bytes += bytes;
+      ops[i].totalUs += elapsedUs;
+      ops[i].lastUs = elapsedUs;
+
+      TraceEntry& entry = trace[traceSeq % TRACE_DEPTH];
+      entry.seq = ++traceSeq;
+      entry.startMs = startMs;
+      entry.elapsedUs = elapsedUs;
+      entry.bytes = bytes;
+      entry.op = i;
+      return;
+    }
+  }
+}
+
+void OpStats::format(String& out) {
+  for (uint8_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    if (i > 0) out += ",";
+    out += ops[i].name;
+    out += "=";
+    out += String(ops[i].count);
+    out += "/";
+    out += String(ops[i].bytes);
+    out += "/";
+    out += String(ops[i].totalUs);
+    out += "/";
+    out += String(ops[i].lastUs);
+  }
+}
+
+void OpStats::formatTrace(String& out, uint32_t since) {
+  out += String(traceSeq);
+  out += ":";
+
+  // Entries still in the ring: the last TRACE_DEPTH
+  uint32_t first = traceSeq > TRACE_DEPTH ? traceSeq - TRACE_DEPTH + 1 : 1;
+  if (since + 1 > first) first = since + 1;
+
+  for (uint32_t seq = first; seq <= traceSeq; seq++) {
+    const TraceEntry& entry = trace[(seq - 1) % TRACE_DEPTH];
+    if (seq > first) out += ",";
+    out += String(entry.seq);
+    out += "=";
+    out += ops[entry.op].name;
+    out += "/";
+    out += String(entry.startMs);
+    out += "/";
+    out += String(entry.elapsedUs);
+    out += "/";
+    out += String(entry.bytes);
+  }
+}
+
+void OpStats::reset() {
+  for (uint8_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+    ops[i].count = 0;
+    ops[i].bytes = 0;
+    ops[i].totalUs = 0;
+    ops[i].lastUs = 0;
+  }
+}
@@ -0,0 +1,63 @@
+/*
+ * Operation Statistics
+ * Per-command timing, reported by STATS
+ *
+ * Every timed command records its duration from parse to last byte
+ * queued for the host. Time spent blocked on a full serial TX buffer is
+ * included, so compare against a model that accounts for the link too.
+ *
+ * The last TRACE_DEPTH timed commands are also kept one by one, with the
+ * time they started, so the host can line them up with its own phases
+ * (TRACE <since>).
+ */
+
+#ifndef OP_STATS_H
+#define OP_STATS_H
+
+#include <Arduino.h>
+
+struct OpStat {
+  const char* name;
+  uint32_t count;
+  uint32_t bytes;      // sum of the data bytes written or read
+  uint32_t totalUs;
+  uint32_t lastUs;
+};
+
+#define TRACE_DEPTH 32
+
+struct TraceEntry {
+  uint32_t seq;
+  uint32_t startMs;    // millis() when the command was parsed
+  uint32_t elapsedUs;
+  uint16_t bytes;      // data bytes written or read
+  uint8_t op;          // index into the timed ops
+};
+
+class OpStats {
+private:
+  OpStat ops[5];
+
+  TraceEntry trace[TRACE_DEPTH];
+  uint32_t traceSeq;   // seq of the newest entry, 0 if none
+
+public:
+  OpStats();
+
+  // Record one command that started at startMs and moved bytes data
+  // bytes (for PATCH the patched bytes, not the image size); ops that
+  // aren't timed are ignored
+  void record(const String& command, uint32_t startMs, uint32_t elapsedUs, uint16_t bytes);
+
+  // Append "<op>=<count>/<bytes>/<total_us>/<last_us>" entries to out
+  void format(String& out);
+
+  // Append "<last_seq>:<seq>=<op>/<start_ms>/<elapsed_us>/<bytes>,..."
+  // for the kept entries newer than since, oldest first
+  void formatTrace(String& out, uint32_t since);
+
+  // Clears the counters; the trace keeps its sequence numbers
+  void reset();
+};
+
+#endif
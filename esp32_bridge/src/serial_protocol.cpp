@@ -3,21 +3,44 @@
  *
  * Commands:
  *   SEARCH       - Search for 1-wire device
- *   READ <size>  - Read EEPROM (up to 512 bytes)
+ *   READ <size> [<addr>] - Read EEPROM (up to 512 bytes, from addr or 0)
  *   WRITE <size> <hex_data> - Write EEPROM
+ *   PATCH <size> <crc> [<offset>:<hex>,...] - Write changes against the
+ *                cached image (see image_cache.h) and verify them
  *   RESET        - Reset 1-wire bus
  *   VERSION      - Get firmware version
+ *   MUX ON|OFF   - Enable/disable tagged channel framing (see channel_mux.h)
+ *   JOB <rom> <size> <hex_data> - Stage an image for a ROM (see job_queue.h)
+ *   JOBS [CLEAR] - Report (or drop) staged images: JOBS:<pending>:<results>
+ *   RESULTS      - Collect job outcomes: RESULTS:<rom>=<status>,...
+ *   BACKUP [<since>] - Oldest kept pre-job image after seq since:
+ *                BACKUP:<seq>:<millis>:<rom>:<hex> (bulk), or
+ *                BACKUP:<last_seq> when there is none
+ *   STATS [RESET] - Command timings (see op_stats.h), programming waits
+ *                and contact score (see contact_quality.h):
+ *                STATS:<op>=<count>/<bytes>/<total_us>/<last_us>,...,PROG=...,
+ *                CONTACT=<score>/<delay_us>/<width_us>/<rise_us>
+ *   TRACE [<since>] - Timed commands after seq since, oldest first (the
+ *                last 32 are kept):
+ *                TRACE:<last_seq>:<seq>=<op>/<start_ms>/<elapsed_us>/<bytes>,...
+ *   STATUS       - Device and contact state: STATUS:ROM=<rom>,FAMILY=<name>,
+ *                CONTACT=<score>,DELAY=<us>,WIDTH=<us>,RISE=<us>,RESETS=<n>,MISSED=<n>
  *
  * Responses:
  *   ROM:<address>  - Device ROM address
  *   DATA:<hex>     - Read data
  *   OK             - Success
  *   ERROR <msg>    - Error message
+ *
+ * With MUX ON, responses are sent on the control channel, DATA on the
+ * bulk data channel, DEBUG output on the log channel and cartridge
+ * insertion/removal notifications on the event channel.
  */
 
 #include "serial_protocol.h"
 
 SerialProtocol::SerialProtocol() {
+  transferred = 0;
 }
 
 bool SerialProtocol::hexStringToBytes(String hex, uint8_t* buffer, uint16_t* len) {
@@ -32,17 +55,19 @@ bool SerialProtocol::hexStringToBytes(String hex, uint8_t* buffer, uint16_t* len
   return true;
 }
 
-String SerialProtocol::bytesToHexString(const uint8_t* data, uint16_t len) {
-  String result = "";
-  for (uint16_t i = 0; i < len; i++) {
-    if (data[i] < 0x10) result += "0";
-    result += String(data[i], HEX);
-  }
-  return result;
+void SerialProtocol::processCommand(String command, OneWireHandler& owHandler, JobQueue& jobs, ChannelMux& mux,
+                                    Print& serial, Print& log) {
+  command.toUpperCase();
+
+  unsigned long startMs = millis();
+  unsigned long started = micros();
+  transferred = 0;
+  dispatch(command, owHandler, jobs, mux, serial, log);
+  stats.record(command, startMs, micros() - started, transferred);
 }
 
-void SerialProtocol::processCommand(String command, OneWireHandler& owHandler, Stream& serial) {
-  command.toUpperCase();
+void SerialProtocol::dispatch(const String& command, OneWireHandler& owHandler, JobQueue& jobs, ChannelMux& mux,
+                              Print& serial, Print& log) {
 
   if (command == "SEARCH") {
     // Search for 1-wire device
@@ -54,13 +79,20 @@ void SerialProtocol::processCommand(String command, OneWireHandler& owHandler, S
     }
   }
   else if (command.startsWith("READ")) {
-    // READ <size>
+    // READ <size> [<addr>]
     int spaceIdx = command.indexOf(' ');
     if (spaceIdx == -1) {
       serial.println("ERROR Invalid READ command");
       return;
     }
 
+    // Optional start address, so a caller can fetch a single field
+    uint16_t addr = 0;
+    int addrIdx = command.indexOf(' ', spaceIdx + 1);
+    if (addrIdx != -1) {
+      addr = command.substring(addrIdx + 1).toInt();
+    }
+
     uint16_t size = command.substring(spaceIdx + 1).toInt();
     if (size == 0 || size > 512) {
       serial.println("ERROR Invalid size");
@@ -72,10 +104,15 @@ void SerialProtocol::processCommand(String command, OneWireHandler& owHandler, S
       return;
     }
 
+    if (addr + size > owHandler.getMemorySize()) {
+      serial.println("ERROR Invalid address");
+      return;
+    }
+
     uint8_t buffer[512];
-    if (owHandler.read(0, buffer, size)) {
-      serial.print("DATA:");
-      serial.println(bytesToHexString(buffer, size));
+    transferred = size;
+    if (owHandler.read(addr, buffer, size)) {
+      mux.sendBulk("DATA:", buffer, size);
     } else {
       serial.println("ERROR Read failed");
     }
@@ -105,6 +142,11 @@ void SerialProtocol::processCommand(String command, OneWireHandler& owHandler, S
       return;
     }
 
+    if (owHandler.getContact().isPoor()) {
+      serial.println("ERROR Poor contact, reseat cartridge");
+      return;
+    }
+
     String hexData = command.substring(secondSpace + 1);
     uint8_t buffer[512];
     uint16_t actualLen;
@@ -119,12 +161,91 @@ void SerialProtocol::processCommand(String command, OneWireHandler& owHandler, S
       return;
     }
 
+    transferred = size;
     if (owHandler.write(0, buffer, size)) {
       serial.println("OK");
     } else {
       serial.println("ERROR Write failed");
     }
   }
+  else if (command.startsWith("PATCH")) {
+    // PATCH <size> <crc16 of the host's base image> [<offset>:<hex>,...]
+    int firstSpace = command.indexOf(' ');
+    int secondSpace = command.indexOf(' ', firstSpace + 1);
+    if (firstSpace == -1 || secondSpace == -1) {
+      serial.println("ERROR Invalid PATCH command");
+      return;
+    }
+
+    if (!owHandler.isDeviceFound()) {
+      serial.println("ERROR No device found, run SEARCH first");
+      return;
+    }
+
+    if (owHandler.getContact().isPoor()) {
+      serial.println("ERROR Poor contact, reseat cartridge");
+      return;
+    }
+
+    uint16_t size = command.substring(firstSpace + 1, secondSpace).toInt();
+    const uint8_t* base = owHandler.getCachedImage(size);
+    if (size == 0 || base == nullptr) {
+      serial.println("ERROR No cached image, READ first");
+      return;
+    }
+
+    // The patches only make sense against the image the host started from
+    int patchSpace = command.indexOf(' ', secondSpace + 1);
+    String crcHex = patchSpace == -1 ? command.substring(secondSpace + 1) : command.substring(secondSpace + 1, patchSpace);
+    if ((uint16_t) strtol(crcHex.c_str(), NULL, 16) != OneWire::crc16(base, size)) {
+      serial.println("ERROR Cached image differs");
+      return;
+    }
+
+    // Expected contents after the patches; the full length is read back at
+    // the end (refreshing the cache), so a cache left stale by a reinserted
+    // cartridge is caught
+    static uint8_t expected[512];
+    static uint8_t verify[512];
+    memcpy(expected, base, size);
+
+    int start = patchSpace;
+    while (start != -1) {
+      int colon = command.indexOf(':', start + 1);
+      int next = command.indexOf(',', start + 1);
+      if (colon == -1 || (next != -1 && next < colon)) {
+        serial.println("ERROR Invalid patch");
+        return;
+      }
+
+      // Bound the range before decoding it into the image
+      uint16_t offset = command.substring(start + 1, colon).toInt();
+      String hexData = next == -1 ? command.substring(colon + 1) : command.substring(colon + 1, next);
+      hexData.trim();
+      uint16_t len = hexData.length() / 2;
+      if (len == 0 || offset >= size || len > size - offset) {
+        serial.println("ERROR Invalid patch");
+        return;
+      }
+      hexStringToBytes(hexData, expected + offset, &len);
+
+      // Only the patched bytes count; size is the whole image
+      transferred += len;
+      if (!owHandler.write(offset, expected + offset, len)) {
+        serial.println("ERROR Write failed");
+        return;
+      }
+
+      start = next;
+    }
+
+    if (!owHandler.read(0, verify, size) || memcmp(verify, expected, size) != 0) {
+      serial.println("ERROR Verify failed");
+      return;
+    }
+
+    serial.println("OK");
+  }
   else if (command == "RESET") {
     if (owHandler.reset()) {
       serial.println("OK");
@@ -137,7 +258,8 @@ void SerialProtocol::processCommand(String command, OneWireHandler& owHandler, S
       #define BOARD_NAME "ESP32"
     #endif
     serial.print(BOARD_NAME);
-    serial.println(" 1-Wire Bridge v1.0");
+    serial.print(" 1-Wire Bridge ");
+    serial.println(FIRMWARE_VERSION);
   }
   else if (command == "DEBUG") {
     // Debug command to check 1-wire bus
@@ -145,45 +267,201 @@ void SerialProtocol::processCommand(String command, OneWireHandler& owHandler, S
       #define ONEWIRE_PIN 4
     #endif
 
-    serial.print("DEBUG: Testing 1-wire bus on GPIO");
-    serial.print(ONEWIRE_PIN);
-    serial.println("...");
-    serial.println("  Required: 4.7k pullup to 3.3V + EEPROM data line");
-    serial.println("");
+    log.print("DEBUG: Testing 1-wire bus on GPIO");
+    log.print(ONEWIRE_PIN);
+    log.println("...");
+    log.println("  Required: 4.7k pullup to 3.3V + EEPROM data line");
+    log.println("");
 
     // Check pin state
     pinMode(ONEWIRE_PIN, INPUT);
     int pinState = digitalRead(ONEWIRE_PIN);
-    serial.print("  GPIO");
-    serial.print(ONEWIRE_PIN);
-    serial.print(" state (idle): ");
-    serial.println(pinState ? "HIGH (good - pullup present)" : "LOW (BAD - no pullup or short to ground!)");
-    serial.println("");
+    log.print("  GPIO");
+    log.print(ONEWIRE_PIN);
+    log.print(" state (idle): ");
+    log.println(pinState ? "HIGH (good - pullup present)" : "LOW (BAD - no pullup or short to ground!)");
+    log.println("");
 
     // Try reset multiple times
     for (int i = 0; i < 5; i++) {
       uint8_t result = owHandler.resetRaw();
-      serial.print("  Reset #");
-      serial.print(i + 1);
-      serial.print(": raw=");
-      serial.print(result);
-      serial.print(" - ");
+      log.print("  Reset #");
+      log.print(i + 1);
+      log.print(": raw=");
+      log.print(result);
+      log.print(" - ");
 
       if (result == 0) {
-        serial.println("NO PRESENCE (no device responding)");
+        log.println("NO PRESENCE (no device responding)");
       } else if (result == 1) {
-        serial.println("PRESENCE DETECTED (device found!)");
+        log.println("PRESENCE DETECTED (device found!)");
       } else if (result == 2) {
-        serial.println("SHORT CIRCUIT (data line shorted)");
+        log.println("SHORT CIRCUIT (data line shorted)");
       } else {
-        serial.println("UNKNOWN");
+        log.println("UNKNOWN");
       }
       delay(100);
     }
 
-    serial.println("");
-    serial.println("DEBUG: If GPIO4=LOW, add 4.7k resistor from GPIO4 to 3.3V");
-    serial.println("DEBUG: If GPIO4=HIGH but no presence, check EEPROM connection");
+    if (owHandler.search()) {
+      log.print("  Device: ");
+      log.print(owHandler.getRomAddress());
+      log.print(" (");
+      log.print(owHandler.getFamilyName());
+      log.println(")");
+    }
+
+    // Timed reset: presence pulse and pull-up rise against the datasheet
+    owHandler.reset();
+    const ResetTiming& timing = owHandler.getContact().getLast();
+    log.print("  Presence delay ");
+    log.print(timing.delayUs);
+    log.print(" us (15-60), width ");
+    log.print(timing.widthUs);
+    log.print(" us (60-240), rise ");
+    log.print(timing.riseUs);
+    log.print(" us; contact score ");
+    log.println(owHandler.getContact().getScore());
+
+    log.println("");
+    log.println("DEBUG: If GPIO4=LOW, add 4.7k resistor from GPIO4 to 3.3V");
+    log.println("DEBUG: If GPIO4=HIGH but no presence, check EEPROM connection");
+
+    // Terminate on the control channel so the host knows the output is complete
+    if (mux.isEnabled()) {
+      serial.println("OK");
+    }
+  }
+  else if (command.startsWith("JOBS")) {
+    if (command == "JOBS CLEAR") {
+      jobs.clear();
+      serial.println("OK");
+      return;
+    }
+
+    serial.print("JOBS:");
+    serial.print(jobs.pending());
+    serial.print(":");
+    serial.println(jobs.completed());
+  }
+  else if (command.startsWith("JOB")) {
+    // JOB <rom> <size> <hex_data>
+    int firstSpace = command.indexOf(' ');
+    int secondSpace = command.indexOf(' ', firstSpace + 1);
+    int thirdSpace = command.indexOf(' ', secondSpace + 1);
+    if (firstSpace == -1 || secondSpace == -1 || thirdSpace == -1) {
+      serial.println("ERROR Invalid JOB command");
+      return;
+    }
+
+    String rom = command.substring(firstSpace + 1, secondSpace);
+    if (rom.length() != 16) {
+      serial.println("ERROR Invalid ROM");
+      return;
+    }
+
+    uint16_t size = command.substring(secondSpace + 1, thirdSpace).toInt();
+    if (size == 0 || size > 512) {
+      serial.println("ERROR Invalid size");
+      return;
+    }
+
+    uint8_t buffer[512];
+    uint16_t actualLen;
+    if (!hexStringToBytes(command.substring(thirdSpace + 1), buffer, &actualLen) || actualLen != size) {
+      serial.println("ERROR Size mismatch");
+      return;
+    }
+
+    if (!jobs.add(rom, buffer, size)) {
+      serial.println("ERROR Job queue full");
+      return;
+    }
+
+    serial.print("OK ");
+    serial.println(jobs.pending());
+  }
+  else if (command == "RESULTS") {
+    serial.print("RESULTS:");
+    serial.println(jobs.takeResults());
+  }
+  else if (command.startsWith("BACKUP")) {
+    int space = command.indexOf(' ');
+    uint32_t since = space == -1 ? 0 : strtoul(command.substring(space + 1).c_str(), NULL, 10);
+
+    const JobBackup* backup = jobs.backupAfter(since);
+    if (backup == nullptr) {
+      serial.print("BACKUP:");
+      serial.println(jobs.getBackupSeq());
+      return;
+    }
+
+    String prefix = "BACKUP:";
+    prefix += String(backup->seq);
+    prefix += ":";
+    prefix += String(backup->timeMs);
+    prefix += ":";
+    prefix += backup->rom;
+    prefix += ":";
+    mux.sendBulk(prefix.c_str(), backup->data, backup->size);
+  }
+  else if (command.startsWith("STATS")) {
+    if (command == "STATS RESET") {
+      stats.reset();
+      owHandler.resetProgStats();
+      serial.println("OK");
+      return;
+    }
+
+    String out = "STATS:";
+    stats.format(out);
+    out += ",PROG=";
+    out += String(owHandler.getProgCount());
+    out += "/0/";
+    out += String(owHandler.getProgTotalUs());
+    out += "/";
+    out += String(owHandler.getProgLastUs());
+    out += ",CONTACT=";
+    owHandler.getContact().format(out);
+    serial.println(out);
+  }
+  else if (command.startsWith("TRACE")) {
+    uint32_t since = command.length() > 6 ? command.substring(6).toInt() : 0;
+
+    String out = "TRACE:";
+    stats.formatTrace(out, since);
+    serial.println(out);
+  }
+  else if (command == "STATUS") {
+    ContactQuality& contact = owHandler.getContact();
+    const ResetTiming& last = contact.getLast();
+
+    String out = "STATUS:ROM=";
+    out += owHandler.isDeviceFound() ? owHandler.getRomAddress() : String("NONE");
+    out += ",FAMILY=";
+    out += owHandler.getFamilyName();
+    out += ",CONTACT=";
+    out += String(contact.getScore());
+    out += ",DELAY=";
+    out += String(last.delayUs);
+    out += ",WIDTH=";
+    out += String(last.widthUs);
+    out += ",RISE=";
+    out += String(last.riseUs);
+    out += ",RESETS=";
+    out += String(contact.getResets());
+    out += ",MISSED=";
+    out += String(contact.getMissed());
+    serial.println(out);
+  }
+  else if (command == "MUX ON") {
+    // Acknowledge in legacy framing, then switch
+    serial.println("OK");
+    mux.setEnabled(true);
+  }
+  else if (command == "MUX OFF") {
+    serial.println("OK");
+    mux.setEnabled(false);
   }
   else {
     serial.println("ERROR Unknown command");
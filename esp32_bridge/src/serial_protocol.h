@@ -8,20 +8,34 @@
 
 #include <Arduino.h>
 #include "onewire_handler.h"
+#include "channel_mux.h"
+#include "job_queue.h"
+#include "op_stats.h"
+
+// Reported by VERSION; v1.1 adds the READ start address, v1.2 PATCH,
+// v1.3 STATUS and the contact score, v1.4 TRACE, v1.5 job backups (BACKUP)
+#define FIRMWARE_VERSION "v1.5"
 
 class SerialProtocol {
 private:
+  OpStats stats;
+
+  // Data bytes the current command moved on the 1-Wire bus, for STATS
+  uint16_t transferred;
+
   // Helper to convert hex string to bytes
   bool hexStringToBytes(String hex, uint8_t* buffer, uint16_t* len);
 
-  // Helper to convert bytes to hex string
-  String bytesToHexString(const uint8_t* data, uint16_t len);
+  void dispatch(const String& command, OneWireHandler& owHandler, JobQueue& jobs, ChannelMux& mux,
+                Print& serial, Print& log);
 
 public:
   SerialProtocol();
 
-  // Process a command and send response
-  void processCommand(String command, OneWireHandler& owHandler, Stream& serial);
+  // Process (and time) a command and send response
+  // serial: control channel writer, log: log channel writer
+  void processCommand(String command, OneWireHandler& owHandler, JobQueue& jobs, ChannelMux& mux,
+                      Print& serial, Print& log);
 };
 
 #endif
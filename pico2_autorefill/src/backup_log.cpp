@@ -0,0 +1,235 @@
+/*
+ * Backup Log Implementation
+ */
+
+#include "backup_log.h"
+#include <OneWire.h>
+#include "hardware/sync.h"
+
+#ifdef BACKUP_SD_CS
+  #include <SDFS.h>
+#else
+  #include <LittleFS.h>
+#endif
+
+#define LOG_PATH "/backup.log"
+#define OLD_LOG_PATH "/backup.old"
+
+static bool validHeader(const BackupHeader& header) {
+  return header.magic[0] == 'B' && header.magic[1] == 'K' &&
+         header.size <= BACKUP_IMAGE_SIZE && header.stored <= header.size;
+}
+
+BackupLog::BackupLog() {
+  fs = NULL;
+  ready = false;
+  busIdle = false;
+  writing = false;
+  lastSeq = 0;
+  written = 0;
+  failed = 0;
+  dropped = 0;
+}
+
+bool BackupLog::begin() {
+#ifdef BACKUP_SD_CS
+  SDFSConfig config;
+  config.setCSPin(BACKUP_SD_CS);
+  SDFS.setConfig(config);
+  fs = &SDFS;
+#else
+  fs = &LittleFS;
+#endif
+
+  if (!fs->begin()) return false;
+
+  // Continue after the newest record; a record torn by a power loss is
+  // cut off so later ones stay readable
+  const char* paths[] = { OLD_LOG_PATH, LOG_PATH };
+  for (const char* path : paths) {
+    File file = fs->open(path, "r+");
+    if (!file) continue;
+
+    uint32_t validEnd;
+    if (!scan(file, validEnd)) file.truncate(validEnd);
+    file.close();
+  }
+
+  queue_init(&pending, sizeof(Entry), BACKUP_QUEUE_DEPTH);
+  mutex_init(&lock);
+  ready = true;
+  return true;
+}
+
+bool BackupLog::scan(File& file, uint32_t& validEnd) {
+  BackupHeader header;
+  validEnd = 0;
+
+  while (file.read((uint8_t*) &header, sizeof(header)) == sizeof(header)) {
+    uint32_t next = validEnd + sizeof(header) + header.stored;
+    if (!validHeader(header) || next > file.size() || !file.seek(next)) return false;
+
+    validEnd = next;
+    if (header.seq > lastSeq) lastSeq = header.seq;
+  }
+
+  return validEnd == file.size();
+}
+
+bool BackupLog::queue(const uint8_t* rom, const uint8_t* image, uint16_t size) {
+  if (!ready || size == 0 || size > BACKUP_IMAGE_SIZE) return false;
+
+  // Copied into the queue; core 0 is the only producer
+  static Entry entry;
+  entry.timeMs = millis();
+  memcpy(entry.rom, rom, 8);
+  entry.size = size;
+  memcpy(entry.image, image, size);
+
+  if (!queue_try_add(&pending, &entry)) {
+    dropped++;
+    return false;
+  }
+  return true;
+}
+
+void BackupLog::service() {
+  if (!ready || queue_is_empty(&pending)) return;
+
+#ifndef BACKUP_SD_CS
+  // Flash writes stall core 0: only while no socket operation runs
+  if (!busIdle) return;
+  writing = true;
+  __dmb();
+  if (!busIdle) {
+    writing = false;
+    return;
+  }
+#endif
+
+  // Core 1 is the only consumer
+  static Entry entry;
+  while (queue_try_remove(&pending, &entry)) {
+    append(entry);
+  }
+
+  writing = false;
+}
+
+bool BackupLog::holdBus() {
+  busIdle = false;
+  __dmb();
+  return !writing;
+}
+
+void BackupLog::append(const Entry& entry) {
+  BackupHeader header;
+  header.magic[0] = 'B';
+  header.magic[1] = 'K';
+  header.size = entry.size;
+  header.fill = entry.image[entry.size - 1];
+  header.stored = entry.size;
+  while (header.stored > 0 && entry.image[header.stored - 1] == header.fill) {
+    header.stored--;
+  }
+  header.reserved = 0;
+  header.seq = lastSeq + 1;
+  header.timeMs = entry.timeMs;
+  memcpy(header.rom, entry.rom, 8);
+  header.crc = OneWire::crc16(entry.image, entry.size);
+
+  mutex_enter_blocking(&lock);
+
+  File file = fs->open(LOG_PATH, "a");
+  if (file && file.size() + sizeof(header) + header.stored > BACKUP_LOG_MAX) {
+    file.close();
+    fs->remove(OLD_LOG_PATH);
+    fs->rename(LOG_PATH, OLD_LOG_PATH);
+    file = fs->open(LOG_PATH, "a");
+  }
+
+  bool ok = false;
+  if (file) {
+    uint32_t start = file.size();
+    ok = file.write((const uint8_t*) &header, sizeof(header)) == sizeof(header) &&
+         file.write(entry.image, header.stored) == header.stored;
+    if (!ok) file.truncate(start);
+    file.close();
+  }
+
+  mutex_exit(&lock);
+
+  if (ok) {
+    lastSeq = header.seq;
+    written++;
+  } else {
+    failed++;
+  }
+}
+
+void BackupLog::streamFile(const char* path, Print& out, uint32_t since) {
+  File file = fs->open(path, "r");
+  if (!file) return;
+
+  static uint8_t image[BACKUP_IMAGE_SIZE];
+  BackupHeader header;
+
+  while (file.read((uint8_t*) &header, sizeof(header)) == sizeof(header)) {
+    if (!validHeader(header)) break;
+
+    if (header.seq <= since) {
+      if (!file.seek(file.position() + header.stored)) break;
+      continue;
+    }
+
+    if (file.read(image, header.stored) != header.stored) break;
+    memset(image + header.stored, header.fill, header.size - header.stored);
+
+    // A damaged record would restore the wrong image: leave it out
+    if (OneWire::crc16(image, header.size) != header.crc) continue;
+
+    out.print("BACKUP:");
+    out.print(header.seq);
+    out.print(":");
+    out.print(header.timeMs);
+    out.print(":");
+    for (uint8_t i = 0; i < 8; i++) {
+      if (header.rom[i] < 0x10) out.print("0");
+      out.print(header.rom[i], HEX);
+    }
+    out.print(":");
+    for (uint16_t i = 0; i < header.size; i++) {
+      if (image[i] < 0x10) out.print("0");
+      out.print(image[i], HEX);
+    }
+    out.println();
+  }
+
+  file.close();
+}
+
+void BackupLog::stream(Print& out, uint32_t since) {
+  if (ready) {
+    // A sequence number from before the log was cleared: send everything
+    if (since > lastSeq) since = 0;
+
+    // Core 1 waits with its appends until the logs have been sent
+    mutex_enter_blocking(&lock);
+    streamFile(OLD_LOG_PATH, out, since);
+    streamFile(LOG_PATH, out, since);
+    mutex_exit(&lock);
+  }
+
+  out.print("BACKUPS_END:");
+  out.println(lastSeq);
+}
+
+bool BackupLog::clear() {
+  if (!ready) return false;
+
+  mutex_enter_blocking(&lock);
+  fs->remove(OLD_LOG_PATH);
+  fs->remove(LOG_PATH);
+  mutex_exit(&lock);
+  return true;
+}
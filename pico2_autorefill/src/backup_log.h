@@ -0,0 +1,142 @@
+/*
+ * Backup Log
+ * Keeps the image a cartridge held before each write, so a refill can
+ * always be undone
+ *
+ * queue() copies the image into a small inter-core queue and returns at
+ * once; core 1 appends it to the log (service() from loop1()). When the
+ * queue is full the backup is dropped and counted.
+ *
+ * Flash program and erase under LittleFS pause core 0 (idleOtherCore),
+ * about 45 ms per sector erase. Core 1 therefore only appends while core
+ * 0 has released the bus (releaseBus(), every socket idle), and core 0
+ * starts no socket operation while an append runs (holdBus() fails), so
+ * the stall only delays commands and presence polls. An SD card does not
+ * stop core 0 and is written at any time.
+ *
+ * The log lives in the on-board flash (LittleFS) or, with BACKUP_SD_CS
+ * set, on an SD card. Records are compact: a 26-byte header and the image
+ * without its trailing run of one fill byte (a cartridge record is 113
+ * bytes of a 512-byte image):
+ *
+ *   offset : len
+ *   0x00   : 0x02 - Magic "BK"
+ *   0x02   : 0x02 - Image size
+ *   0x04   : 0x02 - Bytes stored (the rest are the fill byte)
+ *   0x06   : 0x01 - Fill byte
+ *   0x07   : 0x01 - Reserved (0)
+ *   0x08   : 0x04 - Sequence number
+ *   0x0C   : 0x04 - millis() when queued
+ *   0x10   : 0x08 - ROM address
+ *   0x18   : 0x02 - 1-Wire CRC16 of the full image
+ *
+ * When the log reaches BACKUP_LOG_MAX it becomes the previous log and a
+ * new one is started, so the newest backups always fit.
+ */
+
+#ifndef BACKUP_LOG_H
+#define BACKUP_LOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "pico/mutex.h"
+#include "pico/util/queue.h"
+
+// Largest image kept (DS2433)
+#define BACKUP_IMAGE_SIZE 512
+
+// Images waiting for core 1 (one per socket)
+#ifndef BACKUP_QUEUE_DEPTH
+  #define BACKUP_QUEUE_DEPTH 8
+#endif
+
+// Log size before it is rotated (bytes)
+#ifndef BACKUP_LOG_MAX
+  #define BACKUP_LOG_MAX (256 * 1024)
+#endif
+
+struct BackupHeader {
+  uint8_t magic[2];
+  uint16_t size;
+  uint16_t stored;
+  uint8_t fill;
+  uint8_t reserved;
+  uint32_t seq;
+  uint32_t timeMs;
+  uint8_t rom[8];
+  uint16_t crc;
+} __attribute__((packed));
+
+class BackupLog {
+private:
+  struct Entry {
+    uint32_t timeMs;
+    uint8_t rom[8];
+    uint16_t size;
+    uint8_t image[BACKUP_IMAGE_SIZE];
+  };
+
+  FS* fs;
+  queue_t pending;
+  mutex_t lock;  // File system access, shared by both cores
+  volatile bool ready;
+
+  // Bus handshake: core 0 clears busIdle before it starts a socket
+  // operation, core 1 sets writing before it touches flash; each checks
+  // the other's flag after setting its own
+  volatile bool busIdle;
+  volatile bool writing;
+
+  // Updated by core 1 only
+  volatile uint32_t lastSeq;
+  volatile uint32_t written;
+  volatile uint32_t failed;
+
+  // Updated by core 0 only
+  uint32_t dropped;
+
+  // Scan a log, false if it ends in a torn record (cut at validEnd)
+  bool scan(File& file, uint32_t& validEnd);
+
+  void append(const Entry& entry);
+
+  // Send the records of one log after 'since'
+  void streamFile(const char* path, Print& out, uint32_t since);
+
+public:
+  BackupLog();
+
+  // Mount the file system and find the last sequence number (core 0,
+  // from setup()); false leaves backups off
+  bool begin();
+  bool isReady() const { return ready; }
+
+  // Core 0: copy an image for the background writer, false if dropped
+  bool queue(const uint8_t* rom, const uint8_t* image, uint16_t size);
+
+  // Core 1: write out queued images (on flash, only while the bus is
+  // released)
+  void service();
+
+  // Core 0: claim the bus before starting socket operations; false while
+  // core 1 writes flash
+  bool holdBus();
+
+  // Core 0: let core 1 write flash while idle (every socket idle)
+  void releaseBus(bool idle) { busIdle = idle; }
+
+  // Core 0: BACKUP:<seq>:<millis>:<rom>:<hex> for every record after
+  // 'since', then BACKUPS_END:<last seq>
+  void stream(Print& out, uint32_t since);
+
+  // Core 0: delete both logs
+  bool clear();
+
+  uint32_t getLastSeq() const { return lastSeq; }
+  uint32_t getWritten() const { return written; }
+  uint32_t getFailed() const { return failed; }
+  uint32_t getDropped() const { return dropped; }
+  uint32_t getPending() { return ready ? queue_get_level(&pending) : 0; }
+};
+
+#endif
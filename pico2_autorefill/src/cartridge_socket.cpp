@@ -0,0 +1,213 @@
+/*
+ * Cartridge Socket Implementation
+ */
+
+#include "cartridge_socket.h"
+#include <OneWire.h>
+
+CartridgeSocket::CartridgeSocket() {
+  op = SOCKET_OP_NONE;
+  step = STEP_IDLE;
+  error = "";
+  family = &DEFAULT_FAMILY;
+  memset(romAddress, 0, 8);
+  imageAddr = 0;
+  imageLen = 0;
+  blockOffset = 0;
+  blockLen = 0;
+  readLen = 0;
+  progStart = 0;
+}
+
+bool CartridgeSocket::begin(uint8_t pin) {
+  return bus.begin(pin);
+}
+
+String CartridgeSocket::getRomAddress() {
+  String result = "";
+  for (int i = 0; i < 8; i++) {
+    if (romAddress[i] < 0x10) result += "0";
+    result += String(romAddress[i], HEX);
+  }
+  return result;
+}
+
+bool CartridgeSocket::transfer(Step next, uint8_t headerLen, uint16_t fillLen) {
+  memset(tx + headerLen, 0xFF, fillLen);
+
+  if (!bus.reset()) return false;
+
+  bus.start(tx, rx, headerLen + fillLen);
+  step = next;
+  return true;
+}
+
+bool CartridgeSocket::startIdentify() {
+  if (!isIdle()) return false;
+
+  // Possibly another cartridge
+  readLen = 0;
+
+  op = SOCKET_OP_IDENTIFY;
+  tx[0] = OW_CMD_READ_ROM;
+  if (!transfer(STEP_READ_ROM, 1, 8)) {
+    fail("No presence");
+    return false;
+  }
+  return true;
+}
+
+bool CartridgeSocket::startRead(uint16_t addr, uint16_t len) {
+  if (!isIdle()) return false;
+
+  if (len == 0 || addr + len > SOCKET_IMAGE_SIZE || addr + len > family->memorySize) {
+    error = "Invalid size";
+    return false;
+  }
+
+  op = SOCKET_OP_READ;
+  readLen = 0;
+  imageAddr = addr;
+  imageLen = len;
+
+  tx[0] = OW_CMD_SKIP_ROM;
+  tx[1] = family->cmdReadMemory;
+  tx[2] = addr & 0xFF;
+  tx[3] = (addr >> 8) & 0xFF;
+  if (!transfer(STEP_READ_MEMORY, 4, len)) {
+    fail("No presence");
+    return false;
+  }
+  return true;
+}
+
+bool CartridgeSocket::startWrite(uint16_t len) {
+  if (!isIdle()) return false;
+
+  if (len == 0 || len > SOCKET_IMAGE_SIZE || len > family->memorySize) {
+    error = "Invalid size";
+    return false;
+  }
+
+  // Parts that only copy complete pages would need a read-modify-write
+  if (family->fullPageWrite && len % family->pageSize != 0) {
+    error = "Size must be whole pages";
+    return false;
+  }
+
+  op = SOCKET_OP_WRITE;
+  readLen = 0;
+  imageAddr = 0;
+  imageLen = len;
+  blockOffset = 0;
+
+  if (!startBlock()) {
+    fail("No presence");
+    return false;
+  }
+  return true;
+}
+
+bool CartridgeSocket::startBlock() {
+  // Blocks never cross a page boundary
+  uint8_t pageSize = family->pageSize;
+  uint16_t addr = imageAddr + blockOffset;
+  blockLen = pageSize - addr % pageSize;
+  if (blockLen > imageLen - blockOffset) blockLen = imageLen - blockOffset;
+
+  tx[0] = OW_CMD_SKIP_ROM;
+  tx[1] = family->cmdWriteScratchpad;
+  tx[2] = addr & 0xFF;
+  tx[3] = (addr >> 8) & 0xFF;
+  memcpy(tx + 4, image + blockOffset, blockLen);
+  return transfer(STEP_WRITE_SCRATCHPAD, 4 + blockLen, 0);
+}
+
+SocketResult CartridgeSocket::finish() {
+  op = SOCKET_OP_NONE;
+  step = STEP_IDLE;
+  return SOCKET_DONE;
+}
+
+SocketResult CartridgeSocket::fail(const char* message) {
+  error = message;
+  op = SOCKET_OP_NONE;
+  step = STEP_IDLE;
+  return SOCKET_FAILED;
+}
+
+SocketResult CartridgeSocket::service() {
+  if (op == SOCKET_OP_NONE) return SOCKET_DONE;
+
+  if (step == STEP_PROGRAM_WAIT) {
+    if (micros() - progStart < family->progMaxUs) return SOCKET_BUSY;
+
+    // The part answers 0xAA/0x55 once the copy has completed
+    tx[0] = 0xFF;
+    bus.start(tx, rx, 1);
+    step = STEP_PROGRAM_POLL;
+    return SOCKET_BUSY;
+  }
+
+  if (!bus.service()) return SOCKET_BUSY;
+
+  switch (step) {
+    case STEP_READ_ROM:
+      if (OneWire::crc8(rx + 1, 7) != rx[8] || rx[1] == 0x00 || rx[1] == 0xFF) {
+        return fail("Invalid ROM");
+      }
+      memcpy(romAddress, rx + 1, 8);
+      family = &findFamily(romAddress[0]);
+      return finish();
+
+    case STEP_READ_MEMORY:
+      memcpy(image, rx + 4, imageLen);
+      if (imageAddr == 0) readLen = imageLen;
+      return finish();
+
+    case STEP_WRITE_SCRATCHPAD:
+      tx[0] = OW_CMD_SKIP_ROM;
+      tx[1] = family->cmdReadScratchpad;
+      if (!transfer(STEP_READ_SCRATCHPAD, 2, 3 + blockLen)) return fail("No presence");
+      return SOCKET_BUSY;
+
+    case STEP_READ_SCRATCHPAD: {
+      // TA1, TA2, E/S, then the scratchpad data
+      uint16_t addr = imageAddr + blockOffset;
+      if (rx[2] != (addr & 0xFF) || rx[3] != ((addr >> 8) & 0xFF) ||
+          memcmp(rx + 5, image + blockOffset, blockLen) != 0) {
+        return fail("Verify failed");
+      }
+
+      uint8_t es = rx[4];
+      tx[0] = OW_CMD_SKIP_ROM;
+      tx[1] = family->cmdCopyScratchpad;
+      tx[2] = addr & 0xFF;
+      tx[3] = (addr >> 8) & 0xFF;
+      tx[4] = es;
+      if (!transfer(STEP_COPY_SCRATCHPAD, 5, 0)) return fail("No presence");
+      return SOCKET_BUSY;
+    }
+
+    case STEP_COPY_SCRATCHPAD:
+      // Leave the bus idle for the datasheet tPROG maximum of this part (a
+      // slot during programming disturbs it), then read the status once
+      progStart = micros();
+      step = STEP_PROGRAM_WAIT;
+      return SOCKET_BUSY;
+
+    case STEP_PROGRAM_POLL: {
+      if (rx[0] != OW_COPY_DONE && rx[0] != (uint8_t) ~OW_COPY_DONE) {
+        return fail("Programming failed");
+      }
+
+      blockOffset += blockLen;
+      if (blockOffset >= imageLen) return finish();
+      if (!startBlock()) return fail("No presence");
+      return SOCKET_BUSY;
+    }
+
+    default:
+      return fail("Internal error");
+  }
+}
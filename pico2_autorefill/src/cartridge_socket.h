@@ -0,0 +1,126 @@
+/*
+ * Cartridge Socket
+ * One socket of the multi-socket station: a PIO 1-Wire bus with a single
+ * cartridge EEPROM on it
+ *
+ * Operations are split into steps that start a bus transfer and return;
+ * service() advances them from loop(), so an operation on one socket never
+ * waits for another. With one device per socket, SKIP ROM addresses it
+ * and READ ROM identifies it (no search needed).
+ *
+ * Page size, commands and programming times come from the bridge's device
+ * family table (onewire_families.h).
+ */
+
+#ifndef CARTRIDGE_SOCKET_H
+#define CARTRIDGE_SOCKET_H
+
+#include <Arduino.h>
+#include "onewire_pio.h"
+#include "onewire_families.h"
+
+// Largest image handled per socket (DS2433)
+#define SOCKET_IMAGE_SIZE 512
+
+// Command bytes in front of the data of the longest transfer
+#define SOCKET_HEADER_SIZE 4
+
+enum SocketOp {
+  SOCKET_OP_NONE,
+  SOCKET_OP_IDENTIFY,
+  SOCKET_OP_READ,
+  SOCKET_OP_WRITE
+};
+
+enum SocketResult {
+  SOCKET_BUSY,
+  SOCKET_DONE,
+  SOCKET_FAILED
+};
+
+class CartridgeSocket {
+private:
+  enum Step {
+    STEP_IDLE,
+    STEP_READ_ROM,
+    STEP_READ_MEMORY,
+    STEP_WRITE_SCRATCHPAD,
+    STEP_READ_SCRATCHPAD,
+    STEP_COPY_SCRATCHPAD,
+    STEP_PROGRAM_WAIT,
+    STEP_PROGRAM_POLL
+  };
+
+  OneWirePio bus;
+  SocketOp op;
+  Step step;
+  const char* error;
+
+  uint8_t romAddress[8];
+  const OneWireFamily* family;
+
+  // Read: address and length of the image; write: offset of the block
+  // being programmed
+  uint16_t imageAddr;
+  uint16_t imageLen;
+  uint16_t blockOffset;
+  uint8_t blockLen;
+  uint8_t image[SOCKET_IMAGE_SIZE];
+
+  // Bytes from address 0 of the current cartridge in image (0 once the
+  // buffer holds anything else)
+  uint16_t readLen;
+
+  uint8_t tx[SOCKET_HEADER_SIZE + SOCKET_IMAGE_SIZE];
+  uint8_t rx[SOCKET_HEADER_SIZE + SOCKET_IMAGE_SIZE];
+
+  // Copy scratchpad programming wait
+  unsigned long progStart;
+
+  // Reset the bus and start a transfer of header + fill bytes of 0xFF
+  bool transfer(Step next, uint8_t headerLen, uint16_t fillLen);
+
+  bool startBlock();
+  SocketResult finish();
+  SocketResult fail(const char* message);
+
+public:
+  CartridgeSocket();
+
+  bool begin(uint8_t pin);
+
+  OneWirePio* getBus() { return &bus; }
+  bool isIdle() const { return op == SOCKET_OP_NONE; }
+  SocketOp getOp() const { return op; }
+
+  // ROM of the last device identified
+  String getRomAddress();
+  const uint8_t* getRom() const { return romAddress; }
+  const char* getFamilyName() { return family->name; }
+
+  // Reason for the last SOCKET_FAILED
+  const char* getError() const { return error; }
+
+  // Image of the last read (or the one being written)
+  const uint8_t* getImage() const { return image; }
+  uint16_t getImageLength() const { return imageLen; }
+  uint8_t* getImageBuffer() { return image; }
+
+  // Length of the cartridge's own image still in the buffer (0 if none):
+  // what a write is about to replace
+  uint16_t getReadLength() const { return readLen; }
+
+  // Start an operation; false if one is already running or the
+  // arguments are out of range
+  bool startIdentify();
+  bool startRead(uint16_t addr, uint16_t len);
+  bool startWrite(uint16_t len);  // data already in getImageBuffer()
+
+  // Forget the read image before getImageBuffer() is filled for a write
+  void discardImage() { readLen = 0; }
+
+  // Advance the current operation
+  SocketResult service();
+};
+
+#endif
@@ -11,6 +11,11 @@
  * - Optional button for manual refill
  * - Serial interface for daemon communication
  *
+ * Events (insert, remove, button, refill result) carry a sequence number
+ * and are kept in a RAM ring; after a reconnect the daemon asks for
+ * everything since the last one it saw (EVENTS <seq> <boot id>). A boot
+ * id, random per power-up, tells it when the numbering restarted.
+ *
  * Status LED:
  * - Slow blink: Waiting for cartridge
  * - Fast blink: Reading cartridge
@@ -38,14 +43,28 @@
   #define BUTTON_PIN 15
 #endif
 
+#define BOARD_NAME "Pico2"
+
 #ifndef AUTO_REFILL_THRESHOLD
   #define AUTO_REFILL_THRESHOLD 10.0
 #endif
 
+#define FIRMWARE_VERSION "v1.1"
+
 // Timing
 #define CHECK_INTERVAL 5000  // Check for cartridge every 5 seconds
 #define DEBOUNCE_TIME 50
 
+// Event ring (oldest entries are overwritten)
+#define EVENT_RING_SIZE 32
+#define EVENT_TEXT_SIZE 48
+
+struct Event {
+  uint32_t seq;
+  uint32_t timeMs;
+  char text[EVENT_TEXT_SIZE];
+};
+
 OneWire ow(ONEWIRE_PIN);
 uint8_t romAddress[8];
 bool devicePresent = false;
@@ -56,6 +75,9 @@ bool ledState = false;
 int blinkPattern = 0; // 0=slow, 1=fast, 2=solid, 3=triple, 4=error
 bool buttonPressed = false;
 unsigned long lastButtonChange = 0;
+Event eventRing[EVENT_RING_SIZE];
+uint32_t eventSeq = 0;  // Last sequence number handed out (0 = none yet)
+char bootId[9];         // Random per power-up, sent with every sequence number
 
 // LED blink patterns
 void updateLED() {
@@ -135,8 +157,66 @@ String getRomHex() {
   return result;
 }
 
+// Sequence numbers restart at 1 on every power-up; the boot id tells a
+// host that remembers one from before the restart to start over
+void makeBootId() {
+  uint32_t id = rp2040.hwrand32();
+  snprintf(bootId, sizeof(bootId), "%08lx", (unsigned long) id);
+}
+
+// Event line: EVENT:<seq>@<boot id>:<millis>:<text>
+void printEvent(const Event& event) {
+  Serial.print("EVENT:");
+  Serial.print(event.seq);
+  Serial.print("@");
+  Serial.print(bootId);
+  Serial.print(":");
+  Serial.print(event.timeMs);
+  Serial.print(":");
+  Serial.println(event.text);
+}
+
+// Store an event in the ring and send it to the daemon
+void recordEvent(const String& text) {
+  Event& event = eventRing[eventSeq % EVENT_RING_SIZE];
+  eventSeq++;
+  event.seq = eventSeq;
+  event.timeMs = millis();
+  strncpy(event.text, text.c_str(), EVENT_TEXT_SIZE - 1);
+  event.text[EVENT_TEXT_SIZE - 1] = '\0';
+  printEvent(event);
+}
+
+// EVENTS <since> [<boot id>]: resend every retained event after 'since',
+// then EVENTS_END:<last seq>@<boot id>
+void replayEvents(String args) {
+  args.trim();
+  uint32_t since = args.toInt();
+
+  // A sequence number from before a restart: send everything we have
+  int space = args.indexOf(' ');
+  if (since > eventSeq || (space > 0 && !args.substring(space + 1).equalsIgnoreCase(bootId))) {
+    since = 0;
+  }
+
+  uint32_t first = eventSeq > EVENT_RING_SIZE ? eventSeq - EVENT_RING_SIZE + 1 : 1;
+  if (since + 1 > first) {
+    first = since + 1;
+  }
+
+  for (uint32_t seq = first; seq <= eventSeq; seq++) {
+    printEvent(eventRing[(seq - 1) % EVENT_RING_SIZE]);
+  }
+
+  Serial.print("EVENTS_END:");
+  Serial.print(eventSeq);
+  Serial.print("@");
+  Serial.println(bootId);
+}
+
 void setup() {
   Serial.begin(115200);
+  makeBootId();
 
   pinMode(STATUS_LED, OUTPUT);
   pinMode(BUTTON_PIN, INPUT_PULLUP);
@@ -145,8 +225,10 @@ void setup() {
 
   Serial.println();
   Serial.println("=========================================");
-  Serial.println("  Stratasys Auto-Refill Device v1.0");
+  Serial.println("  Stratasys Auto-Refill Device " FIRMWARE_VERSION);
   Serial.println("  Platform: Raspberry Pi Pico 2");
+  Serial.print("  Boot: ");
+  Serial.println(bootId);
   Serial.println("=========================================");
   Serial.println();
   Serial.print("1-Wire Pin: GPIO");
@@ -184,6 +266,8 @@ void loop() {
       Serial.println(getRomHex());
       Serial.println();
       blinkPattern = 3; // Triple blink - refilling
+
+      recordEvent("BUTTON:" + getRomHex());
     }
   } else if (!buttonState && buttonPressed && (now - lastButtonChange > DEBOUNCE_TIME)) {
     buttonPressed = false;
@@ -220,8 +304,7 @@ void loop() {
       delay(500);
 
       // Send notification to daemon if connected
-      Serial.print("CARTRIDGE_INSERTED:");
-      Serial.println(getRomHex());
+      recordEvent("CARTRIDGE_INSERTED:" + getRomHex());
     }
 
     // Cartridge removal detected
@@ -231,6 +314,9 @@ void loop() {
       Serial.println("Waiting for next cartridge...");
       Serial.println();
 
+      // romAddress still holds the removed cartridge
+      recordEvent("CARTRIDGE_REMOVED:" + getRomHex());
+
       blinkPattern = 0; // Slow blink - waiting
     }
 
@@ -252,6 +338,14 @@ void loop() {
         Serial.print("ROM: ");
         Serial.println(getRomHex());
       }
+      Serial.print("Last event: ");
+      Serial.println(eventSeq);
+    }
+    else if (command == "VERSION") {
+      Serial.println(BOARD_NAME " Auto-Refill " FIRMWARE_VERSION);
+    }
+    else if (command.startsWith("EVENTS")) {
+      replayEvents(command.substring(6));
     }
     else if (command.startsWith("REFILLING")) {
       blinkPattern = 3; // Triple blink - refilling
@@ -260,6 +354,7 @@ void loop() {
     else if (command.startsWith("REFILL_DONE")) {
       blinkPattern = 2; // Solid - complete
       Serial.println("Refill complete acknowledged");
+      recordEvent(command);
 
       // Celebrate!
       for (int i = 0; i < 5; i++) {
@@ -273,9 +368,13 @@ void loop() {
     else if (command.startsWith("ERROR")) {
       blinkPattern = 4; // Rapid blink - error
       Serial.println("Error acknowledged");
+      recordEvent(command);
       delay(5000);
       blinkPattern = devicePresent ? 2 : 0;
     }
+    else if (command.length() > 0) {
+      Serial.println("ERROR Unknown command");
+    }
   }
 
   delay(10);
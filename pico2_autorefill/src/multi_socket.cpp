@@ -0,0 +1,569 @@
+/*
+ * Raspberry Pi Pico 2 Multi-Socket Auto-Refill Station
+ *
+ * Services up to eight cartridges at once. Every socket has its own
+ * 1-Wire line driven by a PIO state machine (onewire.pio), so presence
+ * polls and transfers on different sockets run concurrently instead of
+ * one after the other.
+ *
+ * Built by the pico2_multi environment instead of main.cpp.
+ *
+ * Commands for a socket are prefixed with its number and so are the
+ * replies; a command may be sent to another socket before the first has
+ * answered:
+ *
+ *   <n>:SEARCH              -> <n>:ROM:<hex>
+ *   <n>:READ <size> [addr]  -> <n>:DATA:<hex>
+ *   <n>:WRITE <size> <hex>  -> <n>:OK
+ *   <n>:RESET               -> <n>:OK
+ *   <n>:REFILLING, <n>:REFILL_DONE:..., <n>:ERROR:... -> <n>:OK
+ *   (any failure)           -> <n>:ERROR <reason>
+ *
+ * Station commands: VERSION, STATUS, SOCKETS, EVENTS <seq> [<boot id>],
+ * BACKUPS [<seq>], BACKUPS CLEAR.
+ *
+ * When a WRITE replaces the image last read from a cartridge, that image
+ * is queued for the backup log (backup_log.h). Core 1 appends it to flash
+ * once every socket is idle again (to SD at once). BACKUPS streams the log:
+ *   BACKUP:<seq>:<millis>:<rom>:<hex>  ...  BACKUPS_END:<last seq>
+ *
+ * Events share one numbered ring and name their socket:
+ *   EVENT:<seq>@<boot id>:<millis>:<n>:CARTRIDGE_INSERTED:<rom>
+ *
+ * Status LED:
+ * - Slow blink: No cartridge
+ * - Fast blink: A socket is busy
+ * - Solid: Cartridge(s) present, idle
+ * - Triple blink: Refilling
+ * - Rapid blink: Error
+ */
+
+#include <Arduino.h>
+#include "cartridge_socket.h"
+#include "backup_log.h"
+
+#ifndef STATUS_LED
+  #define STATUS_LED 25
+#endif
+
+// 1-Wire line of each socket (each with its own 4.7k pull-up)
+#ifndef SOCKET_PINS
+  #define SOCKET_PINS { 2, 3, 4, 5, 6, 7, 8, 9 }
+#endif
+
+#define BOARD_NAME "Pico2"
+
+#define FIRMWARE_VERSION "v1.2"
+
+// Timing
+#define CHECK_INTERVAL 500   // Presence poll of idle sockets
+#define ERROR_DISPLAY_TIME 5000
+
+// Event ring (oldest entries are overwritten)
+#define EVENT_RING_SIZE 32
+#define EVENT_TEXT_SIZE 48
+
+#define MAX_SOCKETS 8
+
+struct Event {
+  uint32_t seq;
+  uint32_t timeMs;
+  char text[EVENT_TEXT_SIZE];
+};
+
+static const uint8_t socketPins[] = SOCKET_PINS;
+static const uint8_t socketCount = sizeof(socketPins) / sizeof(socketPins[0]);
+
+static_assert(socketCount <= MAX_SOCKETS, "At most 8 sockets");
+
+CartridgeSocket sockets[MAX_SOCKETS];
+BackupLog backupLog;
+bool socketReady[MAX_SOCKETS];     // State machine claimed
+bool devicePresent[MAX_SOCKETS];   // Insertion reported, removal not yet
+bool commandPending[MAX_SOCKETS];  // Running operation answers a command
+bool refilling[MAX_SOCKETS];
+unsigned long lastCheck = 0;
+unsigned long lastBlink = 0;
+unsigned long errorUntil = 0;
+bool ledState = false;
+int blinkPattern = 0; // 0=slow, 1=fast, 2=solid, 3=triple, 4=error
+Event eventRing[EVENT_RING_SIZE];
+uint32_t eventSeq = 0;  // Last sequence number handed out (0 = none yet)
+char bootId[9];         // Random per power-up, sent with every sequence number
+
+// LED blink patterns
+void updateLED() {
+  unsigned long now = millis();
+
+  switch (blinkPattern) {
+    case 0: // Slow blink - waiting for cartridge
+      if (now - lastBlink > 1000) {
+        ledState = !ledState;
+        digitalWrite(STATUS_LED, ledState);
+        lastBlink = now;
+      }
+      break;
+
+    case 1: // Fast blink - busy
+      if (now - lastBlink > 200) {
+        ledState = !ledState;
+        digitalWrite(STATUS_LED, ledState);
+        lastBlink = now;
+      }
+      break;
+
+    case 2: // Solid - cartridge present
+      digitalWrite(STATUS_LED, HIGH);
+      break;
+
+    case 3: // Triple blink - refilling
+      // Pattern: on-off-on-off-on-off-pause
+      static int tripleCount = 0;
+      if (now - lastBlink > 200) {
+        if (tripleCount < 6) {
+          ledState = !ledState;
+          digitalWrite(STATUS_LED, ledState);
+          tripleCount++;
+        } else if (now - lastBlink > 1000) {
+          tripleCount = 0;
+        }
+        lastBlink = now;
+      }
+      break;
+
+    case 4: // Rapid blink - error
+      if (now - lastBlink > 100) {
+        ledState = !ledState;
+        digitalWrite(STATUS_LED, ledState);
+        lastBlink = now;
+      }
+      break;
+  }
+}
+
+// Highest-priority state over all sockets
+int socketsPattern() {
+  if (millis() < errorUntil) return 4;
+
+  bool anyBusy = false;
+  bool anyPresent = false;
+  for (uint8_t i = 0; i < socketCount; i++) {
+    if (refilling[i]) return 3;
+    anyBusy |= !sockets[i].isIdle();
+    anyPresent |= devicePresent[i];
+  }
+
+  if (anyBusy) return 1;
+  return anyPresent ? 2 : 0;
+}
+
+// Sequence numbers restart at 1 on every power-up; the boot id tells a
+// host that remembers one from before the restart to start over
+void makeBootId() {
+  uint32_t id = rp2040.hwrand32();
+  snprintf(bootId, sizeof(bootId), "%08lx", (unsigned long) id);
+}
+
+// Event line: EVENT:<seq>@<boot id>:<millis>:<text>
+void printEvent(const Event& event) {
+  Serial.print("EVENT:");
+  Serial.print(event.seq);
+  Serial.print("@");
+  Serial.print(bootId);
+  Serial.print(":");
+  Serial.print(event.timeMs);
+  Serial.print(":");
+  Serial.println(event.text);
+}
+
+// Store an event for a socket in the ring and send it to the daemon
+void recordEvent(uint8_t socket, const String& text) {
+  Event& event = eventRing[eventSeq % EVENT_RING_SIZE];
+  eventSeq++;
+  event.seq = eventSeq;
+  event.timeMs = millis();
+  snprintf(event.text, EVENT_TEXT_SIZE, "%u:%s", socket, text.c_str());
+  printEvent(event);
+}
+
+// EVENTS <since> [<boot id>]: resend every retained event after 'since',
+// then EVENTS_END:<last seq>@<boot id>
+void replayEvents(String args) {
+  args.trim();
+  uint32_t since = args.toInt();
+
+  // A sequence number from before a restart: send everything we have
+  int space = args.indexOf(' ');
+  if (since > eventSeq || (space > 0 && !args.substring(space + 1).equalsIgnoreCase(bootId))) {
+    since = 0;
+  }
+
+  uint32_t first = eventSeq > EVENT_RING_SIZE ? eventSeq - EVENT_RING_SIZE + 1 : 1;
+  if (since + 1 > first) {
+    first = since + 1;
+  }
+
+  for (uint32_t seq = first; seq <= eventSeq; seq++) {
+    printEvent(eventRing[(seq - 1) % EVENT_RING_SIZE]);
+  }
+
+  Serial.print("EVENTS_END:");
+  Serial.print(eventSeq);
+  Serial.print("@");
+  Serial.println(bootId);
+}
+
+void reply(uint8_t socket, const String& text) {
+  Serial.print(socket);
+  Serial.print(":");
+  Serial.println(text);
+}
+
+void replyData(uint8_t socket) {
+  const uint8_t* data = sockets[socket].getImage();
+  uint16_t len = sockets[socket].getImageLength();
+
+  Serial.print(socket);
+  Serial.print(":DATA:");
+  for (uint16_t i = 0; i < len; i++) {
+    if (data[i] < 0x10) Serial.print("0");
+    Serial.print(data[i], HEX);
+  }
+  Serial.println();
+}
+
+// Decode hex into a socket's image buffer, false if too short
+bool hexStringToBytes(String hex, uint8_t* buffer, uint16_t len) {
+  hex.trim();
+  if (hex.length() != len * 2) return false;
+
+  for (uint16_t i = 0; i < len; i++) {
+    String byteStr = hex.substring(i * 2, i * 2 + 2);
+    buffer[i] = (uint8_t) strtol(byteStr.c_str(), NULL, 16);
+  }
+  return true;
+}
+
+// Presence poll of every idle socket in one reset window
+void checkSockets() {
+  OneWirePio* buses[MAX_SOCKETS];
+  uint8_t index[MAX_SOCKETS];
+  bool present[MAX_SOCKETS];
+  uint8_t count = 0;
+
+  for (uint8_t i = 0; i < socketCount; i++) {
+    if (socketReady[i] && sockets[i].isIdle()) {
+      buses[count] = sockets[i].getBus();
+      index[count++] = i;
+    }
+  }
+  if (count == 0) return;
+
+  OneWirePio::resetAll(buses, count, present);
+
+  for (uint8_t j = 0; j < count; j++) {
+    uint8_t i = index[j];
+
+    if (present[j] && !devicePresent[i]) {
+      // Identified asynchronously; the insertion is reported once the
+      // ROM has been read
+      commandPending[i] = false;
+      sockets[i].startIdentify();
+    } else if (!present[j] && devicePresent[i]) {
+      devicePresent[i] = false;
+      refilling[i] = false;
+      recordEvent(i, "CARTRIDGE_REMOVED:" + sockets[i].getRomAddress());
+    }
+  }
+}
+
+// Deliver the outcome of a socket operation that just ended
+void completeSocket(uint8_t i, SocketOp op, SocketResult result) {
+  if (!commandPending[i]) {
+    // Presence poll identification
+    if (result == SOCKET_DONE) {
+      devicePresent[i] = true;
+      recordEvent(i, "CARTRIDGE_INSERTED:" + sockets[i].getRomAddress());
+    }
+    return;
+  }
+
+  commandPending[i] = false;
+  if (result == SOCKET_FAILED) {
+    reply(i, String("ERROR ") + sockets[i].getError());
+  } else if (op == SOCKET_OP_IDENTIFY) {
+    reply(i, "ROM:" + sockets[i].getRomAddress());
+  } else if (op == SOCKET_OP_READ) {
+    replyData(i);
+  } else {
+    reply(i, "OK");
+  }
+}
+
+// Advance every busy socket; none of them waits on another
+void serviceSockets() {
+  for (uint8_t i = 0; i < socketCount; i++) {
+    if (sockets[i].isIdle()) continue;
+
+    SocketOp op = sockets[i].getOp();
+    SocketResult result = sockets[i].service();
+    if (result != SOCKET_BUSY) {
+      completeSocket(i, op, result);
+    }
+  }
+}
+
+// Image a write replaces, kept while the new data is decoded into the
+// socket's buffer
+uint8_t previousImage[SOCKET_IMAGE_SIZE];
+uint16_t previousLen = 0;
+
+// Save the image last read from a socket (if it still holds it) before
+// its buffer is overwritten
+void keepPreviousImage(uint8_t i) {
+  previousLen = sockets[i].getReadLength();
+  memcpy(previousImage, sockets[i].getImage(), previousLen);
+  sockets[i].discardImage();
+}
+
+// Queue the saved image for the backup log once the write was accepted
+void backupPreviousImage(uint8_t i) {
+  if (previousLen > 0 && !backupLog.queue(sockets[i].getRom(), previousImage, previousLen)) {
+    Serial.print("Backup of socket ");
+    Serial.print(i);
+    Serial.println(" dropped");
+  }
+  previousLen = 0;
+}
+
+void startCommand(uint8_t i, bool started) {
+  if (started) {
+    commandPending[i] = true;
+  } else {
+    reply(i, String("ERROR ") + sockets[i].getError());
+  }
+}
+
+void processSocketCommand(uint8_t i, String command) {
+  if (i >= socketCount || !socketReady[i]) {
+    reply(i, "ERROR No such socket");
+    return;
+  }
+
+  String upper = command;
+  upper.toUpperCase();
+
+  // Status notifications from the daemon are accepted at any time
+  if (upper.startsWith("REFILLING")) {
+    refilling[i] = true;
+    reply(i, "OK");
+    return;
+  }
+  if (upper.startsWith("REFILL_DONE") || upper.startsWith("ERROR")) {
+    refilling[i] = false;
+    if (upper.startsWith("ERROR")) errorUntil = millis() + ERROR_DISPLAY_TIME;
+    reply(i, "OK");
+    recordEvent(i, command);
+    return;
+  }
+
+  if (!sockets[i].isIdle()) {
+    reply(i, "ERROR Busy");
+    return;
+  }
+
+  if (upper == "RESET") {
+    reply(i, sockets[i].getBus()->reset() ? "OK" : "ERROR No presence");
+  }
+  else if (upper == "SEARCH") {
+    startCommand(i, sockets[i].startIdentify());
+  }
+  else if (upper.startsWith("READ")) {
+    // READ <size> [<address>]
+    String args = command.substring(4);
+    args.trim();
+    int space = args.indexOf(' ');
+    uint16_t size = args.toInt();
+    uint16_t addr = space > 0 ? args.substring(space + 1).toInt() : 0;
+    startCommand(i, sockets[i].startRead(addr, size));
+  }
+  else if (upper.startsWith("WRITE")) {
+    // WRITE <size> <hex>
+    String args = command.substring(5);
+    args.trim();
+    int space = args.indexOf(' ');
+    uint16_t size = args.toInt();
+    String hex = space > 0 ? args.substring(space + 1) : "";
+    hex.trim();
+
+    if (space <= 0 || size == 0 || size > SOCKET_IMAGE_SIZE || hex.length() != size * 2u) {
+      reply(i, "ERROR Invalid data");
+      return;
+    }
+
+    keepPreviousImage(i);
+    hexStringToBytes(hex, sockets[i].getImageBuffer(), size);
+
+    bool started = sockets[i].startWrite(size);
+    if (started) backupPreviousImage(i);
+    startCommand(i, started);
+  }
+  else {
+    reply(i, "ERROR Unknown command");
+  }
+}
+
+void printStatus() {
+  for (uint8_t i = 0; i < socketCount; i++) {
+    Serial.print("Socket ");
+    Serial.print(i);
+    Serial.print(" (GPIO");
+    Serial.print(socketPins[i]);
+    Serial.print("): ");
+    if (!socketReady[i]) {
+      Serial.println("NO STATE MACHINE");
+    } else if (devicePresent[i]) {
+      Serial.print(sockets[i].getRomAddress());
+      Serial.print(" ");
+      Serial.print(sockets[i].getFamilyName());
+      Serial.println(sockets[i].isIdle() ? "" : " (busy)");
+    } else {
+      Serial.println(sockets[i].isIdle() ? "empty" : "busy");
+    }
+  }
+  Serial.print("Backups: ");
+  if (backupLog.isReady()) {
+    Serial.print(backupLog.getWritten());
+    Serial.print(" written, ");
+    Serial.print(backupLog.getPending());
+    Serial.print(" queued, ");
+    Serial.print(backupLog.getDropped());
+    Serial.print(" dropped, ");
+    Serial.print(backupLog.getFailed());
+    Serial.println(" failed");
+  } else {
+    Serial.println("unavailable");
+  }
+  Serial.print("Last event: ");
+  Serial.println(eventSeq);
+}
+
+void processCommand(String command) {
+  // <n>:<command> addresses one socket
+  if (command.length() > 2 && isdigit(command.charAt(0)) && command.charAt(1) == ':') {
+    processSocketCommand(command.charAt(0) - '0', command.substring(2));
+    return;
+  }
+
+  String upper = command;
+  upper.toUpperCase();
+
+  if (upper == "STATUS") {
+    printStatus();
+  }
+  else if (upper == "VERSION") {
+    Serial.println(BOARD_NAME " Multi-Socket Auto-Refill " FIRMWARE_VERSION);
+  }
+  else if (upper == "SOCKETS") {
+    // SOCKETS:<count>:<1 per socket with a cartridge>
+    Serial.print("SOCKETS:");
+    Serial.print(socketCount);
+    Serial.print(":");
+    for (uint8_t i = 0; i < socketCount; i++) {
+      Serial.print(devicePresent[i] ? "1" : "0");
+    }
+    Serial.println();
+  }
+  else if (upper.startsWith("EVENTS")) {
+    replayEvents(command.substring(6));
+  }
+  else if (upper == "BACKUPS CLEAR") {
+    Serial.println(backupLog.clear() ? "OK" : "ERROR No backup log");
+  }
+  else if (upper.startsWith("BACKUPS")) {
+    backupLog.stream(Serial, command.substring(7).toInt());
+  }
+  else if (command.length() > 0) {
+    Serial.println("ERROR Unknown command");
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  makeBootId();
+
+  pinMode(STATUS_LED, OUTPUT);
+
+  delay(500);
+
+  Serial.println();
+  Serial.println("=========================================");
+  Serial.println("  Stratasys Multi-Socket Auto-Refill " FIRMWARE_VERSION);
+  Serial.println("  Platform: Raspberry Pi Pico 2");
+  Serial.print("  Boot: ");
+  Serial.println(bootId);
+  Serial.println("=========================================");
+  Serial.println();
+
+  for (uint8_t i = 0; i < socketCount; i++) {
+    socketReady[i] = sockets[i].begin(socketPins[i]);
+    Serial.print("Socket ");
+    Serial.print(i);
+    Serial.print(": GPIO");
+    Serial.print(socketPins[i]);
+    Serial.println(socketReady[i] ? "" : " - no free PIO state machine");
+  }
+
+  Serial.print("Status LED: GPIO");
+  Serial.println(STATUS_LED);
+  Serial.print("Backup log: ");
+#ifdef BACKUP_SD_CS
+  Serial.print("SD, ");
+#else
+  Serial.print("flash, ");
+#endif
+  if (backupLog.begin()) {
+    Serial.print(backupLog.getLastSeq());
+    Serial.println(" record(s)");
+  } else {
+    Serial.println("unavailable");
+  }
+  Serial.println();
+  Serial.println("Waiting for cartridges...");
+  Serial.println();
+}
+
+void loop() {
+  blinkPattern = socketsPattern();
+  updateLED();
+
+  serviceSockets();
+
+  // Nothing new starts while core 1 writes the backup log to flash
+  if (backupLog.holdBus()) {
+    unsigned long now = millis();
+    if (now - lastCheck > CHECK_INTERVAL) {
+      lastCheck = now;
+      checkSockets();
+    }
+
+    // Check for commands from daemon/serial
+    if (Serial.available()) {
+      String command = Serial.readStringUntil('\n');
+      command.trim();
+      processCommand(command);
+    }
+  }
+
+  bool idle = true;
+  for (uint8_t i = 0; i < socketCount; i++) {
+    idle &= sockets[i].isIdle();
+  }
+  backupLog.releaseBus(idle);
+}
+
+// Core 1: background writer of the backup log
+void loop1() {
+  backupLog.service();
+  delay(1);
+}
@@ -0,0 +1,66 @@
+// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+#if !PICO_NO_HARDWARE
+#include "hardware/pio.h"
+#endif
+
+// ------- //
+// onewire //
+// ------- //
+
+#define onewire_wrap_target 0
+#define onewire_wrap 9
+
+static const uint16_t onewire_program_instructions[] = {
+            //     .wrap_target
+    0x6021, //  0: out    x, 1
+    0xe581, //  1: set    pindirs, 1             [5]
+    0x0026, //  2: jmp    !x, 6
+    0xe780, //  3: set    pindirs, 0             [7]
+    0x5f01, //  4: in     pins, 1                [31]
+    0x1500, //  5: jmp    0                      [21]
+    0xbf42, //  6: nop                           [31]
+    0xb442, //  7: nop                           [20]
+    0xe180, //  8: set    pindirs, 0             [1]
+    0x4601, //  9: in     pins, 1                [6]
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static const struct pio_program onewire_program = {
+    .instructions = onewire_program_instructions,
+    .length = 10,
+    .origin = -1,
+};
+
+static inline pio_sm_config onewire_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + onewire_wrap_target, offset + onewire_wrap);
+    return c;
+}
+
+#include "hardware/clocks.h"
+
+static inline void onewire_program_init(PIO pio, uint sm, uint offset, uint pin) {
+    pio_sm_config c = onewire_program_get_default_config(offset);
+    sm_config_set_set_pins(&c, pin, 1);
+    sm_config_set_in_pins(&c, pin);
+    sm_config_set_out_shift(&c, true, true, 8);
+    sm_config_set_in_shift(&c, true, true, 8);
+    sm_config_set_clkdiv(&c, clock_get_hz(clk_sys) / 1000000.0f);
+
+    // Output level low, direction input (released)
+    pio_sm_set_pins_with_mask(pio, sm, 0, 1u << pin);
+    pio_sm_set_pindirs_with_mask(pio, sm, 0, 1u << pin);
+    pio_gpio_init(pio, pin);
+    gpio_pull_up(pin);
+
+    pio_sm_init(pio, sm, offset, &c);
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * PIO 1-Wire Engine Implementation
+ */
+
+#include "onewire_pio.h"
+#include "onewire.pio.h"
+
+// AN126 standard speed reset timing (us)
+#define RESET_LOW_US 480
+#define PRESENCE_SAMPLE_US 70
+#define RESET_RECOVERY_US 410
+
+static PIO const pioBlocks[] = {
+  pio0,
+  pio1,
+#if NUM_PIOS > 2
+  pio2,
+#endif
+};
+
+#define PIO_BLOCK_COUNT (sizeof(pioBlocks) / sizeof(pioBlocks[0]))
+
+// Program offset per PIO block, loaded on first use
+static bool programLoaded[PIO_BLOCK_COUNT];
+static uint programOffset[PIO_BLOCK_COUNT];
+
+OneWirePio::OneWirePio() {
+  pio = NULL;
+  sm = 0;
+  offset = 0;
+  pin = 0;
+  txData = NULL;
+  rxData = NULL;
+  length = 0;
+  sent = 0;
+  received = 0;
+}
+
+bool OneWirePio::begin(uint8_t busPin) {
+  for (uint8_t i = 0; i < PIO_BLOCK_COUNT; i++) {
+    PIO block = pioBlocks[i];
+
+    if (!programLoaded[i]) {
+      if (!pio_can_add_program(block, &onewire_program)) continue;
+      programOffset[i] = pio_add_program(block, &onewire_program);
+      programLoaded[i] = true;
+    }
+
+    int claimed = pio_claim_unused_sm(block, false);
+    if (claimed < 0) continue;
+
+    pio = block;
+    sm = claimed;
+    offset = programOffset[i];
+    pin = busPin;
+    onewire_program_init(pio, sm, offset, pin);
+    return true;
+  }
+
+  return false;
+}
+
+void OneWirePio::waitIdle() {
+  // Between transfers the program stalls on its first instruction
+  while (!pio_sm_is_tx_fifo_empty(pio, sm) || pio_sm_get_pc(pio, sm) != offset) {
+    tight_loop_contents();
+  }
+}
+
+void OneWirePio::drive(bool low) {
+  pio_sm_exec(pio, sm, pio_encode_set(pio_pindirs, low ? 1 : 0));
+}
+
+bool OneWirePio::reset() {
+  OneWirePio* self = this;
+  bool present = false;
+  resetAll(&self, 1, &present);
+  return present;
+}
+
+void OneWirePio::resetAll(OneWirePio* const* buses, uint8_t count, bool* present) {
+  for (uint8_t i = 0; i < count; i++) {
+    buses[i]->waitIdle();
+
+    // A line already held low is shorted (or a device is stuck mid-slot)
+    present[i] = gpio_get(buses[i]->pin);
+    buses[i]->drive(true);
+  }
+
+  delayMicroseconds(RESET_LOW_US);
+  for (uint8_t i = 0; i < count; i++) {
+    buses[i]->drive(false);
+  }
+
+  delayMicroseconds(PRESENCE_SAMPLE_US);
+  for (uint8_t i = 0; i < count; i++) {
+    present[i] = present[i] && !gpio_get(buses[i]->pin);
+  }
+
+  delayMicroseconds(RESET_RECOVERY_US);
+}
+
+void OneWirePio::start(const uint8_t* tx, uint8_t* rx, uint16_t len) {
+  pio_sm_clear_fifos(pio, sm);
+  txData = tx;
+  rxData = rx;
+  length = len;
+  sent = 0;
+  received = 0;
+}
+
+bool OneWirePio::service() {
+  while (sent < length && !pio_sm_is_tx_fifo_full(pio, sm)) {
+    pio_sm_put(pio, sm, txData[sent++]);
+  }
+
+  // Sampled bits are shifted in from the top: the byte is in bits 31..24
+  while (received < sent && !pio_sm_is_rx_fifo_empty(pio, sm)) {
+    rxData[received++] = pio_sm_get(pio, sm) >> 24;
+  }
+
+  return received == length;
+}
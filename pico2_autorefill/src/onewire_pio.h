@@ -0,0 +1,62 @@
+/*
+ * PIO 1-Wire Engine
+ * One state machine per socket running the onewire.pio byte program
+ *
+ * Byte transfers are queued into the state machine's FIFOs and pumped by
+ * service(), so the CPU never waits on a time slot and several sockets
+ * transfer at once. Bus resets are driven from the CPU; resetAll() resets
+ * every idle socket in a single ~1 ms window.
+ *
+ * onewire.pio.h is generated from onewire.pio with pioasm.
+ */
+
+#ifndef ONEWIRE_PIO_H
+#define ONEWIRE_PIO_H
+
+#include <Arduino.h>
+#include "hardware/pio.h"
+
+class OneWirePio {
+private:
+  PIO pio;
+  uint sm;
+  uint offset;
+  uint8_t pin;
+
+  // Current transfer: every byte sent produces one byte received
+  const uint8_t* txData;
+  uint8_t* rxData;
+  uint16_t length;
+  uint16_t sent;
+  uint16_t received;
+
+  // Wait for the last slot of a transfer to finish
+  void waitIdle();
+
+  // Pull the line low (true) or release it (false)
+  void drive(bool low);
+
+public:
+  OneWirePio();
+
+  // Claim a state machine (loading the program into its PIO block if
+  // needed); false when every state machine is taken
+  bool begin(uint8_t pin);
+
+  // Reset pulse; true if a device answered with a presence pulse
+  bool reset();
+
+  // Reset several buses at once, present[i] is set per bus
+  static void resetAll(OneWirePio* const* buses, uint8_t count, bool* present);
+
+  // Start a transfer of len bytes; send 0xFF to read a byte
+  void start(const uint8_t* tx, uint8_t* rx, uint16_t len);
+
+  // Move bytes between the buffers and the FIFOs; true once complete
+  bool service();
+
+  bool isBusy() const { return received < length; }
+  uint8_t getPin() const { return pin; }
+};
+
+#endif
@@ -1,4 +1,21 @@
-from setuptools import setup, find_packages
+import sys
+from setuptools import setup, find_packages, Extension
+
+# Native codec (optional: stratatools falls back to pure Python without it)
+codec = Extension(
+    'stratatools._codec',
+    sources=['stratatools/_codec.cpp'],
+    extra_compile_args=['/O2'] if sys.platform == 'win32' else ['-std=c++11', '-O2'],
+    optional=True,
+)
+
+# Native diagnostic-port capture scanner (optional as well)
+diag = Extension(
+    'stratatools._diag',
+    sources=['stratatools/_diag.cpp'],
+    extra_compile_args=['/O2'] if sys.platform == 'win32' else ['-std=c++11', '-O2'],
+    optional=True,
+)
 
 setup(
     name='stratatools',
@@ -21,6 +38,7 @@ setup(
     ],
     keywords='stratasys 3dprinting',
     packages=find_packages(exclude=['contrib', 'docs', 'tests']),
+    ext_modules=[codec, diag],
     install_requires=[
         'pycryptodome',
         'pyserial',
@@ -41,6 +59,14 @@ setup(
             'stratatools_rpi_daemon=stratatools.helper.rpi_daemon:main',
             'stratatools_esp32_read=stratatools.helper.esp32_read:main',
             'stratatools_esp32_write=stratatools.helper.esp32_write:main',
+            'stratatools_esp32_jobs=stratatools.helper.esp32_jobs:main',
+            'stratatools_cycle_budget=stratatools.helper.cycle_budget:main',
+            'stratatools_cartridge_index=stratatools.helper.cartridge_index:main',
+            'stratatools_diag_refill=stratatools.helper.diag_refill:main',
+            'stratatools_station_backups=stratatools.helper.station_backups:main',
+            'stratatools_codec_benchmark=stratatools.helper.codec_benchmark:main',
+            'stratatools_diag_extract=stratatools.helper.diag_extract:main',
+            'stratatools_cartridge_emulator=stratatools.helper.cartridge_emulator:main',
         ],
     },
 )
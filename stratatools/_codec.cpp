@@ -0,0 +1,627 @@
+//
+// See the LICENSE file
+//
+
+//
+// Native cartridge codec
+//
+// DESX, CRC16 and the crypted-image checks of Manager.decrypt, without the
+// GIL. decrypt() runs on the calling thread; decrypt_batch() spreads a list
+// of images over an internal worker pool (the caller works too) and returns
+// once every image is done. Inputs are copied before the GIL is released,
+// results are turned into Python objects after it is taken back.
+//
+// Results match stratatools.crypto.Desx_Crypto, stratatools.checksum.
+// Crc16_Checksum and Manager.decrypt/build_key byte for byte (see
+// codec_test.py).
+//
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace {
+
+//
+// DES (FIPS 46-3), big-endian blocks and keys like pycryptodome
+//
+
+const uint8_t IP[64] = {
+    58, 50, 42, 34, 26, 18, 10, 2, 60, 52, 44, 36, 28, 20, 12, 4,
+    62, 54, 46, 38, 30, 22, 14, 6, 64, 56, 48, 40, 32, 24, 16, 8,
+    57, 49, 41, 33, 25, 17, 9, 1, 59, 51, 43, 35, 27, 19, 11, 3,
+    61, 53, 45, 37, 29, 21, 13, 5, 63, 55, 47, 39, 31, 23, 15, 7};
+
+const uint8_t FP[64] = {
+    40, 8, 48, 16, 56, 24, 64, 32, 39, 7, 47, 15, 55, 23, 63, 31,
+    38, 6, 46, 14, 54, 22, 62, 30, 37, 5, 45, 13, 53, 21, 61, 29,
+    36, 4, 44, 12, 52, 20, 60, 28, 35, 3, 43, 11, 51, 19, 59, 27,
+    34, 2, 42, 10, 50, 18, 58, 26, 33, 1, 41, 9, 49, 17, 57, 25};
+
+const uint8_t E[48] = {
+    32, 1, 2, 3, 4, 5, 4, 5, 6, 7, 8, 9,
+    8, 9, 10, 11, 12, 13, 12, 13, 14, 15, 16, 17,
+    16, 17, 18, 19, 20, 21, 20, 21, 22, 23, 24, 25,
+    24, 25, 26, 27, 28, 29, 28, 29, 30, 31, 32, 1};
+
+const uint8_t P[32] = {
+    16, 7, 20, 21, 29, 12, 28, 17, 1, 15, 23, 26, 5, 18, 31, 10,
+    2, 8, 24, 14, 32, 27, 3, 9, 19, 13, 30, 6, 22, 11, 4, 25};
+
+const uint8_t PC1[56] = {
+    57, 49, 41, 33, 25, 17, 9, 1, 58, 50, 42, 34, 26, 18,
+    10, 2, 59, 51, 43, 35, 27, 19, 11, 3, 60, 52, 44, 36,
+    63, 55, 47, 39, 31, 23, 15, 7, 62, 54, 46, 38, 30, 22,
+    14, 6, 61, 53, 45, 37, 29, 21, 13, 5, 28, 20, 12, 4};
+
+const uint8_t PC2[48] = {
+    14, 17, 11, 24, 1, 5, 3, 28, 15, 6, 21, 10,
+    23, 19, 12, 4, 26, 8, 16, 7, 27, 20, 13, 2,
+    41, 52, 31, 37, 47, 55, 30, 40, 51, 45, 33, 48,
+    44, 49, 39, 56, 34, 53, 46, 42, 50, 36, 29, 32};
+
+const uint8_t SHIFTS[16] = {1, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1};
+
+const uint8_t SBOX[8][64] = {
+    {14, 4, 13, 1, 2, 15, 11, 8, 3, 10, 6, 12, 5, 9, 0, 7,
+     0, 15, 7, 4, 14, 2, 13, 1, 10, 6, 12, 11, 9, 5, 3, 8,
+     4, 1, 14, 8, 13, 6, 2, 11, 15, 12, 9, 7, 3, 10, 5, 0,
+     15, 12, 8, 2, 4, 9, 1, 7, 5, 11, 3, 14, 10, 0, 6, 13},
+    {15, 1, 8, 14, 6, 11, 3, 4, 9, 7, 2, 13, 12, 0, 5, 10,
+     3, 13, 4, 7, 15, 2, 8, 14, 12, 0, 1, 10, 6, 9, 11, 5,
+     0, 14, 7, 11, 10, 4, 13, 1, 5, 8, 12, 6, 9, 3, 2, 15,
+     13, 8, 10, 1, 3, 15, 4, 2, 11, 6, 7, 12, 0, 5, 14, 9},
+    {10, 0, 9, 14, 6, 3, 15, 5, 1, 13, 12, 7, 11, 4, 2, 8,
+     13, 7, 0, 9, 3, 4, 6, 10, 2, 8, 5, 14, 12, 11, 15, 1,
+     13, 6, 4, 9, 8, 15, 3, 0, 11, 1, 2, 12, 5, 10, 14, 7,
+     1, 10, 13, 0, 6, 9, 8, 7, 4, 15, 14, 3, 11, 5, 2, 12},
+    {7, 13, 14, 3, 0, 6, 9, 10, 1, 2, 8, 5, 11, 12, 4, 15,
+     13, 8, 11, 5, 6, 15, 0, 3, 4, 7, 2, 12, 1, 10, 14, 9,
+     10, 6, 9, 0, 12, 11, 7, 13, 15, 1, 3, 14, 5, 2, 8, 4,
+     3, 15, 0, 6, 10, 1, 13, 8, 9, 4, 5, 11, 12, 7, 2, 14},
+    {2, 12, 4, 1, 7, 10, 11, 6, 8, 5, 3, 15, 13, 0, 14, 9,
+     14, 11, 2, 12, 4, 7, 13, 1, 5, 0, 15, 10, 3, 9, 8, 6,
+     4, 2, 1, 11, 10, 13, 7, 8, 15, 9, 12, 5, 6, 3, 0, 14,
+     11, 8, 12, 7, 1, 14, 2, 13, 6, 15, 0, 9, 10, 4, 5, 3},
+    {12, 1, 10, 15, 9, 2, 6, 8, 0, 13, 3, 4, 14, 7, 5, 11,
+     10, 15, 4, 2, 7, 12, 9, 5, 6, 1, 13, 14, 0, 11, 3, 8,
+     9, 14, 15, 5, 2, 8, 12, 3, 7, 0, 4, 10, 1, 13, 11, 6,
+     4, 3, 2, 12, 9, 5, 15, 10, 11, 14, 1, 7, 6, 0, 8, 13},
+    {4, 11, 2, 14, 15, 0, 8, 13, 3, 12, 9, 7, 5, 10, 6, 1,
+     13, 0, 11, 7, 4, 9, 1, 10, 14, 3, 5, 12, 2, 15, 8, 6,
+     1, 4, 11, 13, 12, 3, 7, 14, 10, 15, 6, 8, 0, 5, 9, 2,
+     6, 11, 13, 8, 1, 4, 10, 7, 9, 5, 0, 15, 14, 2, 3, 12},
+    {13, 2, 8, 4, 6, 15, 11, 1, 10, 9, 3, 14, 5, 0, 12, 7,
+     1, 15, 13, 8, 10, 3, 7, 4, 12, 5, 6, 11, 0, 14, 9, 2,
+     7, 11, 4, 1, 9, 12, 14, 2, 0, 6, 10, 13, 15, 3, 5, 8,
+     2, 1, 14, 7, 4, 10, 8, 13, 15, 12, 9, 0, 3, 5, 6, 11}};
+
+// Table positions count from 1 at the most significant of 'width' bits
+uint64_t permute(uint64_t in, const uint8_t* table, int count, int width) {
+    uint64_t out = 0;
+    for (int i = 0; i < count; i++) {
+        out = (out << 1) | ((in >> (width - table[i])) & 1);
+    }
+    return out;
+}
+
+// S-box output already run through P, per box and 6-bit input
+uint32_t SP[8][64];
+
+void init_sp() {
+    for (int box = 0; box < 8; box++) {
+        for (int x = 0; x < 64; x++) {
+            int row = ((x >> 4) & 2) | (x & 1);
+            int col = (x >> 1) & 0xF;
+            uint32_t s = (uint32_t) SBOX[box][row * 16 + col] << (28 - 4 * box);
+            SP[box][x] = (uint32_t) permute(s, P, 32, 32);
+        }
+    }
+}
+
+struct Des {
+    uint64_t subkeys[16];
+
+    explicit Des(const uint8_t* key) {
+        uint64_t k = 0;
+        for (int i = 0; i < 8; i++) k = (k << 8) | key[i];
+
+        uint64_t cd = permute(k, PC1, 56, 64);
+        uint32_t c = (uint32_t) (cd >> 28) & 0xFFFFFFF;
+        uint32_t d = (uint32_t) cd & 0xFFFFFFF;
+        for (int round = 0; round < 16; round++) {
+            for (int s = 0; s < SHIFTS[round]; s++) {
+                c = ((c << 1) | (c >> 27)) & 0xFFFFFFF;
+                d = ((d << 1) | (d >> 27)) & 0xFFFFFFF;
+            }
+            subkeys[round] = permute(((uint64_t) c << 28) | d, PC2, 48, 56);
+        }
+    }
+
+    uint64_t crypt(uint64_t block, bool decrypt) const {
+        uint64_t lr = permute(block, IP, 64, 64);
+        uint32_t l = (uint32_t) (lr >> 32);
+        uint32_t r = (uint32_t) lr;
+
+        for (int round = 0; round < 16; round++) {
+            uint64_t x = permute(r, E, 48, 32) ^ subkeys[decrypt ? 15 - round : round];
+            uint32_t f = 0;
+            for (int box = 0; box < 8; box++) {
+                f |= SP[box][(x >> (42 - 6 * box)) & 0x3F];
+            }
+            uint32_t next = l ^ f;
+            l = r;
+            r = next;
+        }
+
+        return permute(((uint64_t) r << 32) | l, FP, 64, 64);
+    }
+};
+
+//
+// DESX as in Desx_Crypto: each 8-byte block on its own,
+// c = out_whitener ^ DES(in_whitener ^ p)
+//
+
+const uint8_t CLOROX[256] = {
+    0xBD, 0x56, 0xEA, 0xF2, 0xA2, 0xF1, 0xAC, 0x2A, 0xB0, 0x93, 0xD1,
+    0x9C, 0x1B, 0x33, 0xFD, 0xD0, 0x30, 0x04, 0xB6, 0xDC, 0x7D, 0xDF,
+    0x32, 0x4B, 0xF7, 0xCB, 0x45, 0x9B, 0x31, 0xBB, 0x21, 0x5A, 0x41,
+    0x9F, 0xE1, 0xD9, 0x4A, 0x4D, 0x9E, 0xDA, 0xA0, 0x68, 0x2C, 0xC3,
+    0x27, 0x5F, 0x80, 0x36, 0x3E, 0xEE, 0xFB, 0x95, 0x1A, 0xFE, 0xCE,
+    0xA8, 0x34, 0xA9, 0x13, 0xF0, 0xA6, 0x3F, 0xD8, 0x0C, 0x78, 0x24,
+    0xAF, 0x23, 0x52, 0xC1, 0x67, 0x17, 0xF5, 0x66, 0x90, 0xE7, 0xE8,
+    0x07, 0xB8, 0x60, 0x48, 0xE6, 0x1E, 0x53, 0xF3, 0x92, 0xA4, 0x72,
+    0x8C, 0x08, 0x15, 0x6E, 0x86, 0x00, 0x84, 0xFA, 0xF4, 0x7F, 0x8A,
+    0x42, 0x19, 0xF6, 0xDB, 0xCD, 0x14, 0x8D, 0x50, 0x12, 0xBA, 0x3C,
+    0x06, 0x4E, 0xEC, 0xB3, 0x35, 0x11, 0xA1, 0x88, 0x8E, 0x2B, 0x94,
+    0x99, 0xB7, 0x71, 0x74, 0xD3, 0xE4, 0xBF, 0x3A, 0xDE, 0x96, 0x0E,
+    0xBC, 0x0A, 0xED, 0x77, 0xFC, 0x37, 0x6B, 0x03, 0x79, 0x89, 0x62,
+    0xC6, 0xD7, 0xC0, 0xD2, 0x7C, 0x6A, 0x8B, 0x22, 0xA3, 0x5B, 0x05,
+    0x5D, 0x02, 0x75, 0xD5, 0x61, 0xE3, 0x18, 0x8F, 0x55, 0x51, 0xAD,
+    0x1F, 0x0B, 0x5E, 0x85, 0xE5, 0xC2, 0x57, 0x63, 0xCA, 0x3D, 0x6C,
+    0xB4, 0xC5, 0xCC, 0x70, 0xB2, 0x91, 0x59, 0x0D, 0x47, 0x20, 0xC8,
+    0x4F, 0x58, 0xE0, 0x01, 0xE2, 0x16, 0x38, 0xC4, 0x6F, 0x3B, 0x0F,
+    0x65, 0x46, 0xBE, 0x7E, 0x2D, 0x7B, 0x82, 0xF9, 0x40, 0xB5, 0x1D,
+    0x73, 0xF8, 0xEB, 0x26, 0xC7, 0x87, 0x97, 0x25, 0x54, 0xB1, 0x28,
+    0xAA, 0x98, 0x9D, 0xA5, 0x64, 0x6D, 0x7A, 0xD4, 0x10, 0x81, 0x44,
+    0xEF, 0x49, 0xD6, 0xAE, 0x2E, 0xDD, 0x76, 0x5C, 0x2F, 0xA7, 0x1C,
+    0xC9, 0x09, 0x69, 0x9A, 0x83, 0xCF, 0x29, 0x39, 0xB9, 0xE9, 0x4C,
+    0xFF, 0x43, 0xAB};
+
+uint64_t load64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+void store64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t) v;
+        v >>= 8;
+    }
+}
+
+struct Desx {
+    Des des;
+    uint64_t inWhitener;
+    uint64_t outWhitener;
+
+    explicit Desx(const uint8_t* key) : des(key) {
+        uint8_t out[8] = {0};
+        for (int i = 0; i < 16; i++) {
+            uint8_t index = out[0] ^ out[1];
+            memmove(out, out + 1, 7);
+            out[7] = CLOROX[index] ^ key[i];
+        }
+        inWhitener = load64(key + 8);
+        outWhitener = load64(out);
+    }
+
+    void encrypt(uint8_t* data, size_t len) const {
+        for (size_t i = 0; i + 8 <= len; i += 8) {
+            store64(data + i, outWhitener ^ des.crypt(inWhitener ^ load64(data + i), false));
+        }
+    }
+
+    void decrypt(uint8_t* data, size_t len) const {
+        for (size_t i = 0; i + 8 <= len; i += 8) {
+            store64(data + i, inWhitener ^ des.crypt(outWhitener ^ load64(data + i), true));
+        }
+    }
+};
+
+//
+// CRC16 as in Crc16_Checksum (reflected 0xA001)
+//
+
+uint16_t CRC16[256];
+
+void init_crc16() {
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = (uint16_t) i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        CRC16[i] = crc;
+    }
+}
+
+uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0) {
+    for (size_t i = 0; i < len; i++) {
+        crc = CRC16[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+uint16_t load16le(const uint8_t* p) {
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+//
+// Manager.decrypt
+//
+
+// Last byte read by decrypt
+const size_t IMAGE_MIN_SIZE = 0x62;
+
+struct Job {
+    uint8_t machineNumber[8];
+    uint8_t eepromUid[8];
+    std::vector<uint8_t> image;
+    const char* error;
+};
+
+void build_key(const uint8_t* cartridgeKey, const uint8_t* machine, const uint8_t* uid, uint8_t* key) {
+    key[0] = ~cartridgeKey[0];
+    key[1] = ~cartridgeKey[2];
+    key[2] = ~uid[2];
+    key[3] = ~cartridgeKey[6];
+    key[4] = ~machine[0];
+    key[5] = ~machine[2];
+    key[6] = ~uid[6];
+    key[7] = ~machine[6];
+    key[8] = ~machine[7];
+    key[9] = ~uid[1];
+    key[10] = ~machine[3];
+    key[11] = ~machine[1];
+    key[12] = ~cartridgeKey[7];
+    key[13] = ~uid[5];
+    key[14] = ~cartridgeKey[3];
+    key[15] = ~cartridgeKey[1];
+}
+
+// Decrypt job.image in place; on failure job.error says why
+void decrypt_job(Job& job) {
+    uint8_t* image = job.image.data();
+    job.error = NULL;
+
+    if (job.image.size() < IMAGE_MIN_SIZE) {
+        job.error = "image too short";
+        return;
+    }
+
+    uint8_t key[16];
+    build_key(image + 0x48, job.machineNumber, job.eepromUid, key);
+    Desx desx(key);
+
+    if (crc16(image, 0x40) != load16le(image + 0x46)) {
+        job.error = "invalid crypted content checksum";
+        return;
+    }
+    desx.decrypt(image, 0x40);
+
+    if (crc16(image + 0x58, 8) != load16le(image + 0x60)) {
+        job.error = "invalid current material quantity checksum";
+        return;
+    }
+    desx.decrypt(image + 0x58, 8);
+}
+
+//
+// Worker pool: one batch at a time, the calling thread works too
+//
+
+class WorkerPool {
+public:
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    void run(size_t count, size_t threads, const std::function<void(size_t)>& fn) {
+        std::lock_guard<std::mutex> batch(batchMutex);
+
+        threads = std::min(threads, count);
+        if (threads <= 1) {
+            for (size_t i = 0; i < count; i++) fn(i);
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (workers.size() < threads - 1) {
+                workers.emplace_back(&WorkerPool::workerLoop, this);
+            }
+            task = &fn;
+            taskCount = count;
+            next = 0;
+            helpers = threads - 1;
+            running = threads - 1;
+            generation++;
+        }
+        wake.notify_all();
+
+        drain();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return running == 0; });
+        task = NULL;
+    }
+
+    // Around fork(): hold both locks so the child copies them unlocked
+    // and between batches
+    void lockForFork() {
+        batchMutex.lock();
+        mutex.lock();
+    }
+
+    void unlockAfterFork() {
+        mutex.unlock();
+        batchMutex.unlock();
+    }
+
+private:
+    std::mutex batchMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<std::thread> workers;
+
+    const std::function<void(size_t)>* task = NULL;
+    size_t taskCount = 0;
+    std::atomic<size_t> next{0};
+    size_t helpers = 0;   // Workers still to join the current batch
+    size_t running = 0;   // Workers that haven't finished it
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void drain() {
+        for (size_t i = next++; i < taskCount; i = next++) {
+            (*task)(i);
+        }
+    }
+
+    void workerLoop() {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;) {
+            wake.wait(lock, [&] { return stopping || (generation != seen && helpers > 0); });
+            if (stopping) return;
+
+            seen = generation;
+            helpers--;
+            lock.unlock();
+            drain();
+            lock.lock();
+
+            if (--running == 0) done.notify_all();
+        }
+    }
+};
+
+// Replaced in a forked child: its workers didn't survive the fork, so the
+// old pool can be neither used nor destroyed (joining them would hang)
+WorkerPool* pool = new WorkerPool();
+
+#ifndef _WIN32
+void pool_prepare() { pool->lockForFork(); }
+void pool_parent() { pool->unlockAfterFork(); }
+void pool_child() { pool = new WorkerPool(); }
+#endif
+
+size_t default_threads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+//
+// Python bindings
+//
+
+// Copy an 8-byte argument
+bool copy8(PyObject* obj, uint8_t* out, const char* name) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) < 0) return false;
+
+    bool ok = view.len == 8;
+    if (ok) {
+        memcpy(out, view.buf, 8);
+    } else {
+        PyErr_Format(PyExc_ValueError, "%s must be 8 bytes", name);
+    }
+    PyBuffer_Release(&view);
+    return ok;
+}
+
+bool parse_job(PyObject* machineNumber, PyObject* eepromUid, PyObject* image, Job& job) {
+    if (!copy8(machineNumber, job.machineNumber, "machine_number") ||
+        !copy8(eepromUid, job.eepromUid, "eeprom_uid")) {
+        return false;
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(image, &view, PyBUF_SIMPLE) < 0) return false;
+    const uint8_t* data = (const uint8_t*) view.buf;
+    job.image.assign(data, data + view.len);
+    PyBuffer_Release(&view);
+    return true;
+}
+
+PyObject* job_result(const Job& job) {
+    if (job.error) {
+        return PyObject_CallFunction(PyExc_ValueError, "s", job.error);
+    }
+    return PyByteArray_FromStringAndSize((const char*) job.image.data(), job.image.size());
+}
+
+PyObject* codec_decrypt(PyObject*, PyObject* args) {
+    PyObject *machineNumber, *eepromUid, *image;
+    if (!PyArg_ParseTuple(args, "OOO:decrypt", &machineNumber, &eepromUid, &image)) return NULL;
+
+    Job job;
+    if (!parse_job(machineNumber, eepromUid, image, job)) return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    decrypt_job(job);
+    Py_END_ALLOW_THREADS
+
+    if (job.error) {
+        PyErr_SetString(PyExc_ValueError, job.error);
+        return NULL;
+    }
+    return job_result(job);
+}
+
+PyObject* codec_decrypt_batch(PyObject*, PyObject* args) {
+    PyObject* items;
+    Py_ssize_t threads = 0;
+    if (!PyArg_ParseTuple(args, "O|n:decrypt_batch", &items, &threads)) return NULL;
+
+    PyObject* seq = PySequence_Fast(items, "items must be a sequence of (machine_number, eeprom_uid, image)");
+    if (!seq) return NULL;
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    std::vector<Job> jobs(count);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject* item = PySequence_Fast_GET_ITEM(seq, i);
+        PyObject *machineNumber, *eepromUid, *image;
+        if (!PyArg_ParseTuple(item, "OOO", &machineNumber, &eepromUid, &image) ||
+            !parse_job(machineNumber, eepromUid, image, jobs[i])) {
+            Py_DECREF(seq);
+            return NULL;
+        }
+    }
+    Py_DECREF(seq);
+
+    size_t workers = threads > 0 ? (size_t) threads : default_threads();
+    std::function<void(size_t)> fn = [&jobs](size_t i) { decrypt_job(jobs[i]); };
+
+    Py_BEGIN_ALLOW_THREADS
+    pool->run(jobs.size(), workers, fn);
+    Py_END_ALLOW_THREADS
+
+    PyObject* results = PyList_New(count);
+    if (!results) return NULL;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject* result = job_result(jobs[i]);
+        if (!result) {
+            Py_DECREF(results);
+            return NULL;
+        }
+        PyList_SET_ITEM(results, i, result);
+    }
+    return results;
+}
+
+PyObject* codec_desx(PyObject* args, bool decrypt) {
+    Py_buffer key, data;
+    if (!PyArg_ParseTuple(args, decrypt ? "y*y*:desx_decrypt" : "y*y*:desx_encrypt", &key, &data)) return NULL;
+
+    PyObject* result = NULL;
+    if (key.len != 16) {
+        PyErr_SetString(PyExc_ValueError, "key must be 16 bytes");
+    } else if (data.len % 8) {
+        PyErr_SetString(PyExc_ValueError, decrypt ? "ciphertext length must be a multiple of 8"
+                                                  : "plaintext length must be a multiple of 8");
+    } else {
+        std::vector<uint8_t> buffer((const uint8_t*) data.buf, (const uint8_t*) data.buf + data.len);
+        uint8_t k[16];
+        memcpy(k, key.buf, 16);
+
+        Py_BEGIN_ALLOW_THREADS
+        Desx desx(k);
+        if (decrypt) {
+            desx.decrypt(buffer.data(), buffer.size());
+        } else {
+            desx.encrypt(buffer.data(), buffer.size());
+        }
+        Py_END_ALLOW_THREADS
+
+        result = PyByteArray_FromStringAndSize((const char*) buffer.data(), buffer.size());
+    }
+
+    PyBuffer_Release(&key);
+    PyBuffer_Release(&data);
+    return result;
+}
+
+PyObject* codec_desx_encrypt(PyObject*, PyObject* args) {
+    return codec_desx(args, false);
+}
+
+PyObject* codec_desx_decrypt(PyObject*, PyObject* args) {
+    return codec_desx(args, true);
+}
+
+PyObject* codec_crc16(PyObject*, PyObject* args) {
+    Py_buffer data;
+    unsigned int crc = 0;
+    if (!PyArg_ParseTuple(args, "y*|I:crc16", &data, &crc)) return NULL;
+
+    uint16_t result = crc16((const uint8_t*) data.buf, data.len, (uint16_t) crc);
+    PyBuffer_Release(&data);
+    return PyLong_FromLong(result);
+}
+
+PyMethodDef methods[] = {
+    {"decrypt", codec_decrypt, METH_VARARGS,
+     "decrypt(machine_number, eeprom_uid, image) -> bytearray\n\n"
+     "Manager.decrypt without the GIL; raises ValueError on a checksum mismatch."},
+    {"decrypt_batch", codec_decrypt_batch, METH_VARARGS,
+     "decrypt_batch(items, threads=0) -> list\n\n"
+     "Decrypt (machine_number, eeprom_uid, image) items on the worker pool\n"
+     "(threads=0: one per core). Each result is a bytearray or a ValueError."},
+    {"desx_encrypt", codec_desx_encrypt, METH_VARARGS, "desx_encrypt(key, plaintext) -> bytearray"},
+    {"desx_decrypt", codec_desx_decrypt, METH_VARARGS, "desx_decrypt(key, ciphertext) -> bytearray"},
+    {"crc16", codec_crc16, METH_VARARGS, "crc16(data, crc=0) -> int"},
+    {NULL, NULL, 0, NULL}};
+
+PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "_codec", "Native cartridge codec (see stratatools/codec.py)", -1, methods,
+    NULL, NULL, NULL, NULL};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit__codec(void) {
+    init_sp();
+    init_crc16();
+#ifndef _WIN32
+    // Once per process: the handlers must not take the locks twice
+    static bool forkHandlers = false;
+    if (!forkHandlers) {
+        pthread_atfork(pool_prepare, pool_parent, pool_child);
+        forkHandlers = true;
+    }
+#endif
+    return PyModule_Create(&module);
+}
@@ -0,0 +1,253 @@
+//
+// See the LICENSE file
+//
+
+//
+// Native diagnostic-port capture scanner
+//
+// Finds the memory dump lines a printer's diagnostic console prints
+//
+//     000096: 00 00 00 00 00 00 00 00 53 54 52 41 54 41 53 59   ........STRATASY
+//
+// in a capture fed in chunks of any size, and groups lines whose addresses
+// follow each other into images. Memory stays bounded whatever the size of
+// the capture: one partial line (MAX_LINE) and one image (max_image). The
+// input is parsed without the GIL. Results match the pure-Python scanner
+// in stratatools/diag_scanner.py (see diag_scanner_test.py).
+//
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Longer lines can't be dump lines; they are skipped without being kept
+const size_t MAX_LINE = 1024;
+
+const size_t DEFAULT_MAX_IMAGE = 64 * 1024;
+
+typedef std::pair<uint32_t, std::vector<uint8_t> > Image;
+
+int hex_value(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+class Scanner {
+public:
+    explicit Scanner(size_t maxImage) : maxImage(maxImage) {}
+
+    // Scan a chunk, appending the images it completes to out
+    void feed(const uint8_t* data, size_t len, std::vector<Image>& out) {
+        const uint8_t* end = data + len;
+
+        while (data < end) {
+            const uint8_t* newline = (const uint8_t*) memchr(data, '\n', end - data);
+            const uint8_t* stop = newline ? newline : end;
+
+            if (!overlong) {
+                size_t size = stop - data;
+                if (partial.size() + size > MAX_LINE) {
+                    overlong = true;
+                    partial.clear();
+                } else if (newline && partial.empty()) {
+                    // Whole line in the chunk: no copy
+                    line(data, size, out);
+                } else {
+                    partial.append((const char*) data, size);
+                    if (newline) line((const uint8_t*) partial.data(), partial.size(), out);
+                }
+            }
+
+            if (!newline) break;
+            partial.clear();
+            overlong = false;
+            data = newline + 1;
+        }
+    }
+
+    // End of capture: the last line and image
+    void finish(std::vector<Image>& out) {
+        if (!overlong && !partial.empty()) line((const uint8_t*) partial.data(), partial.size(), out);
+        partial.clear();
+        overlong = false;
+        flush(out);
+    }
+
+private:
+    size_t maxImage;
+    std::string partial;
+    bool overlong = false;
+    uint32_t start = 0;
+    std::vector<uint8_t> image;
+    std::vector<uint8_t> bytes;
+
+    void flush(std::vector<Image>& out) {
+        if (image.empty()) return;
+        out.push_back(Image(start, image));
+        image.clear();
+    }
+
+    // "<6 decimal digits>: " then hex pairs, each optionally followed by
+    // one space; anything after the last pair is ignored
+    void line(const uint8_t* p, size_t len, std::vector<Image>& out) {
+        if (len < 10 || p[6] != ':' || p[7] != ' ') return;
+
+        uint32_t address = 0;
+        for (int i = 0; i < 6; i++) {
+            if (p[i] < '0' || p[i] > '9') return;
+            address = address * 10 + (p[i] - '0');
+        }
+
+        bytes.clear();
+        size_t i = 8;
+        while (i + 1 < len) {
+            int hi = hex_value(p[i]);
+            int lo = hex_value(p[i + 1]);
+            if (hi < 0 || lo < 0) break;
+            bytes.push_back((uint8_t) (hi << 4 | lo));
+            i += 2;
+            if (i < len && p[i] == ' ') i++;
+        }
+        if (bytes.empty()) return;
+
+        if (image.empty() || address != start + image.size() || image.size() + bytes.size() > maxImage) {
+            flush(out);
+            start = address;
+        }
+        image.insert(image.end(), bytes.begin(), bytes.end());
+    }
+};
+
+//
+// Python bindings
+//
+
+struct ScannerObject {
+    PyObject_HEAD
+    Scanner* scanner;
+    std::mutex* mutex;
+};
+
+PyObject* images_to_list(const std::vector<Image>& images) {
+    PyObject* list = PyList_New(images.size());
+    if (!list) return NULL;
+
+    for (size_t i = 0; i < images.size(); i++) {
+        const Image& image = images[i];
+        PyObject* item = Py_BuildValue("(Iy#)", image.first, (const char*) image.second.data(),
+                                       (Py_ssize_t) image.second.size());
+        if (!item) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+PyObject* scanner_new(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"max_image", NULL};
+    Py_ssize_t maxImage = DEFAULT_MAX_IMAGE;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|n:Scanner", (char**) keywords, &maxImage)) return NULL;
+    if (maxImage <= 0) {
+        PyErr_SetString(PyExc_ValueError, "max_image must be positive");
+        return NULL;
+    }
+
+    ScannerObject* self = (ScannerObject*) type->tp_alloc(type, 0);
+    if (!self) return NULL;
+    self->scanner = new Scanner(maxImage);
+    self->mutex = new std::mutex();
+    return (PyObject*) self;
+}
+
+void scanner_dealloc(ScannerObject* self) {
+    PyTypeObject* type = Py_TYPE(self);
+    delete self->scanner;
+    delete self->mutex;
+    type->tp_free((PyObject*) self);
+    // Instances hold a reference to their heap type
+    Py_DECREF(type);
+}
+
+PyObject* scanner_feed(ScannerObject* self, PyObject* args) {
+    Py_buffer data;
+    if (!PyArg_ParseTuple(args, "y*:feed", &data)) return NULL;
+
+    std::vector<Image> images;
+    // The mutex is only ever held without the GIL, and released before
+    // taking it back, so two threads can't each wait on the other
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::lock_guard<std::mutex> lock(*self->mutex);
+        self->scanner->feed((const uint8_t*) data.buf, data.len, images);
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&data);
+    return images_to_list(images);
+}
+
+PyObject* scanner_finish(ScannerObject* self, PyObject*) {
+    std::vector<Image> images;
+    Py_BEGIN_ALLOW_THREADS
+    {
+        std::lock_guard<std::mutex> lock(*self->mutex);
+        self->scanner->finish(images);
+    }
+    Py_END_ALLOW_THREADS
+    return images_to_list(images);
+}
+
+PyMethodDef scanner_methods[] = {
+    {"feed", (PyCFunction) scanner_feed, METH_VARARGS,
+     "feed(data) -> [(address, bytes), ...]\n\n"
+     "Scan the next chunk of a capture; returns the images it completes."},
+    {"finish", (PyCFunction) scanner_finish, METH_NOARGS,
+     "finish() -> [(address, bytes), ...]\n\n"
+     "End of capture: returns the last image, if any."},
+    {NULL, NULL, 0, NULL}};
+
+PyType_Slot scanner_slots[] = {
+    {Py_tp_doc, (void*) "Scanner(max_image=65536): streaming dump-line scanner"},
+    {Py_tp_new, (void*) scanner_new},
+    {Py_tp_dealloc, (void*) scanner_dealloc},
+    {Py_tp_methods, (void*) scanner_methods},
+    {0, NULL}};
+
+PyType_Spec scanner_spec = {
+    "stratatools._diag.Scanner", sizeof(ScannerObject), 0, Py_TPFLAGS_DEFAULT, scanner_slots};
+
+PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "_diag", "Native diagnostic-port capture scanner (see stratatools/diag_scanner.py)",
+    -1, NULL, NULL, NULL, NULL, NULL};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit__diag(void) {
+    PyObject* scannerType = PyType_FromSpec(&scanner_spec);
+    if (!scannerType) return NULL;
+
+    PyObject* m = PyModule_Create(&module);
+    if (!m) {
+        Py_DECREF(scannerType);
+        return NULL;
+    }
+
+    if (PyModule_AddObject(m, "Scanner", scannerType) < 0) {
+        Py_DECREF(scannerType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
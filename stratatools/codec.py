@@ -0,0 +1,40 @@
+#
+# See the LICENSE file
+#
+
+#
+# Native codec backend
+#
+# stratatools._codec (built from _codec.cpp by setup.py when a C++
+# compiler is available) implements DESX, CRC16 and Manager.decrypt in
+# native code that runs without the GIL. Threads decoding cartridges then
+# run in parallel, and decrypt_batch() spreads a list of images over an
+# internal worker pool. Manager uses it when present; everything works
+# without it, only slower and on one core at a time.
+#
+
+import os
+
+try:
+    from . import _codec
+except ImportError:
+    _codec = None
+
+NATIVE = _codec is not None
+
+def default_threads():
+    return os.cpu_count() or 1
+
+#
+# Manager.decrypt of one image, on the calling thread
+#
+def decrypt(machine_number, eeprom_uid, cartridge_crypted):
+    return _codec.decrypt(bytes(machine_number), bytes(eeprom_uid), cartridge_crypted)
+
+#
+# Decrypt [(machine_number, eeprom_uid, cartridge_crypted), ...] on the
+# worker pool (threads=0: one per core); each result is a bytearray or the
+# ValueError that image failed with
+#
+def decrypt_batch(items, threads=0):
+    return _codec.decrypt_batch([(bytes(m), bytes(u), c) for m, u, c in items], threads)
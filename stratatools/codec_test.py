@@ -0,0 +1,119 @@
+import os
+import signal
+import unittest
+
+from stratatools import codec, machine
+from stratatools.manager import Manager
+from stratatools.crypto import Desx_Crypto
+from stratatools.cartridge_pb2 import Cartridge
+from stratatools.checksum import Crc16_Checksum
+from google.protobuf.text_format import Merge
+
+CARTRIDGE_TEXT = """
+serial_number: 1234.0
+material_name: "ABS_RED"
+manufacturing_lot: "5678"
+manufacturing_date {
+  seconds: 978310861
+}
+last_use_date {
+  seconds: 1012615322
+}
+initial_material_quantity: 11.1
+current_material_quantity: 22.2
+key_fragment: "41424344"
+version: 1
+signature: "TESTTEST1"
+"""
+
+EEPROM_UID = bytes.fromhex("2362474d0100006b")
+
+def make_manager(native):
+    manager = Manager(Desx_Crypto(), Crc16_Checksum())
+    manager.native = native and manager.native
+    return manager
+
+def encoded_image(machine_type="prodigy", serial_number=1234.0):
+    cartridge = Cartridge()
+    Merge(CARTRIDGE_TEXT, cartridge)
+    cartridge.serial_number = serial_number
+    number = machine.get_number_from_type(machine_type)
+    return bytes(make_manager(False).encode(number, EEPROM_UID, cartridge))
+
+class TestDecodeBatch(unittest.TestCase):
+    def test_batch(self):
+        # Good images for two machine types, one tried with the wrong type
+        items = [(machine.get_number_from_type("prodigy"), EEPROM_UID, encoded_image(serial_number=n))
+                 for n in range(4)]
+        items.append((machine.get_number_from_type("fox"), EEPROM_UID, encoded_image("fox")))
+        items.append((machine.get_number_from_type("prodigy"), EEPROM_UID, encoded_image("fox")))
+
+        for native in (False, True):
+            results = make_manager(native).decode_batch(items, threads=3)
+            assert [r.serial_number for r in results[:5]] == [0, 1, 2, 3, 1234]
+            assert isinstance(results[5], Exception)
+
+@unittest.skipUnless(codec.NATIVE, "native codec not built")
+class TestNativeCodec(unittest.TestCase):
+    def test_desx_matches_python(self):
+        desx = Desx_Crypto()
+        for _ in range(20):
+            key = bytearray(os.urandom(16))
+            data = os.urandom(64)
+            assert codec._codec.desx_encrypt(key, data) == desx.encrypt(key, data)
+            assert codec._codec.desx_decrypt(key, data) == desx.decrypt(key, data)
+            assert codec._codec.crc16(data) == Crc16_Checksum().checksum(data)
+
+    def test_decrypt_matches_python(self):
+        number = machine.get_number_from_type("prodigy")
+        image = encoded_image()
+
+        expected = make_manager(False).decrypt(number, EEPROM_UID, bytearray(image))
+        assert codec.decrypt(number, EEPROM_UID, image) == expected
+
+        # Decrypted in place, like the Python path
+        data = bytearray(image)
+        assert make_manager(True).decrypt(number, EEPROM_UID, data) is data
+        assert data == expected
+
+    def test_errors(self):
+        number = machine.get_number_from_type("prodigy")
+        image = bytearray(encoded_image())
+        image[0] ^= 1
+
+        with self.assertRaisesRegex(ValueError, "invalid crypted content checksum"):
+            codec.decrypt(number, EEPROM_UID, image)
+
+        results = codec.decrypt_batch([(number, EEPROM_UID, image), (number, EEPROM_UID, b"\x00" * 8)])
+        assert [str(r) for r in results] == ["invalid crypted content checksum", "image too short"]
+
+        with self.assertRaises(ValueError):
+            codec.decrypt(number[:4], EEPROM_UID, image)
+
+    def test_pool_sizes(self):
+        number = machine.get_number_from_type("prodigy")
+        items = [(number, EEPROM_UID, encoded_image(serial_number=n)) for n in range(16)]
+        expected = codec.decrypt_batch(items, threads=1)
+
+        for threads in (2, 5, 16, 32, 0):
+            assert codec.decrypt_batch(items, threads) == expected
+        assert codec.decrypt_batch([], 4) == []
+
+    @unittest.skipUnless(hasattr(os, "fork"), "needs fork()")
+    def test_batch_after_fork(self):
+        number = machine.get_number_from_type("prodigy")
+        items = [(number, EEPROM_UID, encoded_image(serial_number=n)) for n in range(8)]
+        expected = codec.decrypt_batch(items, 4)
+
+        # The parent's workers don't exist in the child; the child gets its own
+        pid = os.fork()
+        if pid == 0:
+            signal.alarm(10)
+            try:
+                os._exit(0 if codec.decrypt_batch(items, 4) == expected else 1)
+            except BaseException:
+                os._exit(2)
+
+        _, status = os.waitpid(pid, 0)
+        assert os.WIFEXITED(status) and os.WEXITSTATUS(status) == 0
+        assert codec.decrypt_batch(items, 4) == expected
@@ -0,0 +1,128 @@
+#
+# See the LICENSE file
+#
+
+#
+# Streaming scanner for diagnostic-port captures
+#
+# A printer's diagnostic console dumps memory as
+#
+#   000096: 00 00 00 00 00 00 00 00 53 54 52 41 54 41 53 59   ........STRATASY
+#
+# (six decimal address digits, hex pairs, then an ASCII column). Scanner
+# takes a capture in chunks of any size, line by line, and returns each
+# image as (address, bytes): a run of dump lines whose addresses follow
+# each other. Other lines (prompts, commands, printer messages) are
+# skipped, and a jump in address starts a new image. Memory stays bounded
+# whatever the size of the capture: one partial line and one image of at
+# most max_image bytes (a longer run is split).
+#
+# stratatools._diag (built from _diag.cpp by setup.py when a C++ compiler
+# is available) does the same natively and without the GIL; PyScanner is
+# the fallback.
+#
+
+import re
+
+try:
+    from . import _diag
+except ImportError:
+    _diag = None
+
+NATIVE = _diag is not None
+
+# Longer lines can't be dump lines; they are skipped without being kept
+MAX_LINE = 1024
+
+MAX_IMAGE = 64 * 1024
+
+# Bytes read from a capture file at a time
+CHUNK_SIZE = 1 << 20
+
+_DUMP_LINE = re.compile(rb"(\d{6}): ((?:[0-9a-fA-F]{2} ?)+)")
+
+class PyScanner:
+    """Pure-Python Scanner"""
+
+    def __init__(self, max_image=MAX_IMAGE):
+        if max_image <= 0:
+            raise ValueError("max_image must be positive")
+        self.max_image = max_image
+        self.partial = b""
+        self.overlong = False
+        self.start = 0
+        self.image = bytearray()
+
+    def feed(self, data):
+        """Scan the next chunk of a capture; returns the images it completes"""
+        images = []
+        lines = bytes(data).split(b"\n")
+
+        for i, line in enumerate(lines):
+            last = i == len(lines) - 1
+            if not self.overlong:
+                if len(self.partial) + len(line) > MAX_LINE:
+                    self.overlong = True
+                    self.partial = b""
+                elif last:
+                    self.partial += line
+                else:
+                    self._line(self.partial + line, images)
+
+            if not last:
+                self.partial = b""
+                self.overlong = False
+        return images
+
+    def finish(self):
+        """End of capture: returns the last image, if any"""
+        images = []
+        if not self.overlong and self.partial:
+            self._line(self.partial, images)
+        self.partial = b""
+        self.overlong = False
+        self._flush(images)
+        return images
+
+    def _flush(self, images):
+        if self.image:
+            images.append((self.start, bytes(self.image)))
+            self.image = bytearray()
+
+    def _line(self, line, images):
+        match = _DUMP_LINE.match(line)
+        if not match:
+            return
+
+        address = int(match.group(1))
+        data = bytes.fromhex(match.group(2).replace(b" ", b"").decode("ascii"))
+
+        if (not self.image or address != self.start + len(self.image)
+                or len(self.image) + len(data) > self.max_image):
+            self._flush(images)
+            self.start = address
+        self.image += data
+
+Scanner = _diag.Scanner if NATIVE else PyScanner
+
+def scan(capture, chunk_size=CHUNK_SIZE, max_image=MAX_IMAGE, native=NATIVE):
+    """
+    Yield (address, image) for every image in a capture
+
+    Args:
+        capture: binary file object, or bytes/str holding the whole capture
+    """
+    scanner = _diag.Scanner(max_image) if native else PyScanner(max_image)
+
+    if isinstance(capture, str):
+        capture = capture.encode("latin-1")
+    if isinstance(capture, (bytes, bytearray, memoryview)):
+        yield from scanner.feed(capture)
+    else:
+        while True:
+            chunk = capture.read(chunk_size)
+            if not chunk:
+                break
+            yield from scanner.feed(chunk)
+
+    yield from scanner.finish()
@@ -0,0 +1,95 @@
+import io
+import random
+import threading
+import unittest
+
+from stratatools import diag_scanner
+from stratatools.formatter import DiagnosticPort_Formatter
+
+def dump(image, address=0):
+    lines = []
+    for offset in range(0, len(image), 16):
+        chunk = image[offset:offset + 16]
+        hex_part = " ".join("%02x" % b for b in chunk)
+        ascii_part = "".join(chr(b) if 32 <= b < 127 else "." for b in chunk)
+        lines.append("%06d: %s   %s\r\n" % (address + offset, hex_part, ascii_part))
+    return "".join(lines)
+
+IMAGE_A = bytes(range(256)) * 2
+IMAGE_B = bytes(range(0x71))
+
+CAPTURE = ("> er 0 0 512\r\n" + dump(IMAGE_A) + "> \r\n"
+           "001234: not a dump line\r\n"
+           "> er 1 96 113\r\n" + dump(IMAGE_B, 96) +
+           "x" * 5000 + "\r\n"
+           "> ").encode()
+
+def scanners():
+    yield diag_scanner.PyScanner
+    if diag_scanner.NATIVE:
+        yield diag_scanner._diag.Scanner
+
+class TestDiagScanner(unittest.TestCase):
+    def test_images(self):
+        for native in {False, diag_scanner.NATIVE}:
+            images = list(diag_scanner.scan(io.BytesIO(CAPTURE), chunk_size=7, native=native))
+            assert images == [(0, IMAGE_A), (96, IMAGE_B)]
+
+    def test_chunk_boundaries(self):
+        for scanner_class in scanners():
+            for size in (1, 2, 13, 80, 4096):
+                scanner = scanner_class()
+                images = []
+                for i in range(0, len(CAPTURE), size):
+                    images += scanner.feed(CAPTURE[i:i + size])
+                images += scanner.finish()
+                assert images == [(0, IMAGE_A), (96, IMAGE_B)], (scanner_class, size)
+
+    def test_address_jumps_and_split(self):
+        capture = (dump(IMAGE_B) + dump(IMAGE_B)).encode()
+        for scanner_class in scanners():
+            scanner = scanner_class()
+            assert scanner.feed(capture) + scanner.finish() == [(0, IMAGE_B), (0, IMAGE_B)]
+
+            scanner = scanner_class(max_image=64)
+            images = scanner.feed(dump(IMAGE_A).encode()) + scanner.finish()
+            assert [(a, len(i)) for a, i in images] == [(a, 64) for a in range(0, 512, 64)]
+
+    def test_native_matches_python(self):
+        if not diag_scanner.NATIVE:
+            self.skipTest("native scanner not built")
+
+        rng = random.Random(1)
+        pieces = [b"000016: ", b"00 ", b"ab", b"Cd ", b"zz", b"  ", b"\r\n", b"\n", b":", b"123456", b"- ", b"9"]
+        capture = b"".join(rng.choice(pieces) for _ in range(20000)) + CAPTURE
+        assert (list(diag_scanner.scan(capture, native=True)) ==
+                list(diag_scanner.scan(capture, native=False)))
+
+    def test_native_threads(self):
+        if not diag_scanner.NATIVE:
+            self.skipTest("native scanner not built")
+
+        # feed() and finish() from two threads on one scanner must not
+        # each end up waiting on the lock the other holds
+        scanner = diag_scanner._diag.Scanner()
+        capture = CAPTURE * 20
+
+        def feed():
+            for _ in range(200):
+                scanner.feed(capture)
+
+        def finish():
+            for _ in range(20000):
+                scanner.finish()
+
+        threads = [threading.Thread(target=target, daemon=True) for target in (feed, finish)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join(30)
+        assert not any(thread.is_alive() for thread in threads)
+
+    def test_formatter(self):
+        formatter = DiagnosticPort_Formatter()
+        assert formatter.from_source(CAPTURE) == IMAGE_A + IMAGE_B
+        assert formatter.from_source(CAPTURE.decode()) == IMAGE_A + IMAGE_B
@@ -1,9 +1,10 @@
 #
 # See the LICENSE file
 #
-import re
 import binascii
 
+from stratatools import diag_scanner
+
 class Formatter:
     def __init__(self):
         pass
@@ -16,25 +17,15 @@ class Formatter:
 
 class DiagnosticPort_Formatter(Formatter):
     def __init__(self):
-        self.rx = re.compile('^[0-9]{6}: ((?:[0-9a-f-A-F]{2} ?)+).*?$',re.MULTILINE)
+        pass
 
 #Reads a series of newline delimited lines of the format:
 #000096: 00 00 00 00 00 00 00 00 53 54 52 41 54 41 53 59   ........STRATASY
+#Other lines are skipped. The data of every line is returned, in order;
+#see stratatools.diag_scanner.scan() to get each image with its address.
 
     def from_source(self, data):
-        formatted = b''
-        idx = 1
-        for match in self.rx.finditer(data):
-            try:
-                #Get a line of data with whitespace removed
-                line = match.group(1).replace(' ', '')
-                formatted += binascii.unhexlify(line)
-                idx=idx+1
-            except IndexError:
-                print("Error on line %s when reading diag port formatted data" % (idx,))
-                raise
-
-        return formatted
+        return b"".join(image for _, image in diag_scanner.scan(data))
 
 #Produces a double-quoted, space separated string suitable for providing to the uPrint's 'ew' diagnostic command
     def to_destination(self, data):
@@ -4,10 +4,12 @@ Cartridge Controller
 Business logic layer for cartridge operations.
 """
 
+import contextlib
 import os
 from PyQt5.QtCore import QObject, pyqtSignal
 
-from stratatools.helper.esp32_bridge import ESP32Bridge
+from stratatools.helper.control_socket import DaemonClient, open_bridge
+from stratatools.helper.cycle_timeline import CycleTimeline
 from stratatools.manager import Manager
 from stratatools.crypto import Desx_Crypto
 from stratatools.checksum import Crc16_Checksum
@@ -30,6 +32,7 @@ class CartridgeController(QObject):
     progress_updated = pyqtSignal(str, int)  # message: str, percent: int
     error_occurred = pyqtSignal(str)  # error_message: str
     log_message = pyqtSignal(str)  # log_message: str
+    timeline_updated = pyqtSignal()
 
     # Error messages mapping
     ERROR_MESSAGES = {
@@ -50,6 +53,8 @@ class CartridgeController(QObject):
         self.current_rom = None
         self.machine_type = "prodigy"  # Default
         self.connected = False
+        self.station = None
+        self.timeline = CycleTimeline()
 
     def connect(self, port):
         """
@@ -68,14 +73,21 @@ class CartridgeController(QObject):
         try:
             self.log(f"Connecting to ESP32 on {port}...")
 
-            self.bridge = ESP32Bridge(port=port, timeout=2)
+            # Goes through the refill daemon when it owns the port
+            self.bridge = open_bridge(port, timeout=2)
 
             if not self.bridge.initialize():
                 raise Exception("Failed to initialize ESP32 bridge")
 
             self.connected = True
             self.connection_changed.emit(True)
-            self.log(f"Connected to ESP32 on {port}")
+            if isinstance(self.bridge, DaemonClient):
+                # The daemon's own cycles on this port keep the port name
+                self.station = f"{port} (GUI)"
+                self.log(f"Connected to ESP32 on {port} via refill daemon")
+            else:
+                self.station = port
+                self.log(f"Connected to ESP32 on {port}")
             return True
 
         except Exception as e:
@@ -132,14 +144,17 @@ class CartridgeController(QObject):
             import time
             time.sleep(0.2)
 
-            # Reset bus before searching for better reliability
-            self.bridge.onewire_reset_bus()
-            time.sleep(0.3)
+            with self._cycle("search") as cycle:
+                # Reset bus before searching for better reliability
+                with cycle.phase("detect"):
+                    self.bridge.onewire_reset_bus()
+                time.sleep(0.3)
 
-            rom_address = self.bridge.onewire_macro_search()
+                with cycle.phase("detect"):
+                    rom_address = self.bridge.onewire_macro_search()
 
-            if rom_address is None:
-                raise Exception("No device found")
+                if rom_address is None:
+                    raise Exception("No device found")
 
             self.current_rom = rom_address
             self.device_found.emit(rom_address)
@@ -176,21 +191,24 @@ class CartridgeController(QObject):
             self.log(f"Reading cartridge (machine type: {machine_type})...")
             self.progress_updated.emit("Reading EEPROM...", 25)
 
-            # Read EEPROM data
-            data = self.bridge.onewire_read(512)
+            with self._cycle(f"read {rom_address}") as cycle:
+                # Read EEPROM data
+                with cycle.phase("read"):
+                    data = self.bridge.onewire_read(512)
 
-            if data is None:
-                raise Exception("Failed to read EEPROM")
+                if data is None:
+                    raise Exception("Failed to read EEPROM")
 
-            self.progress_updated.emit("Decoding cartridge...", 50)
+                self.progress_updated.emit("Decoding cartridge...", 50)
 
-            # Decode cartridge
-            machine_number = machine.get_number_from_type(machine_type)
-            eeprom_uid = bytes.fromhex(rom_address)
+                # Decode cartridge
+                machine_number = machine.get_number_from_type(machine_type)
+                eeprom_uid = bytes.fromhex(rom_address)
 
-            self.log(f"Attempting decode with machine type: {machine_type}, ROM: {rom_address}")
+                self.log(f"Attempting decode with machine type: {machine_type}, ROM: {rom_address}")
 
-            cartridge = self.manager.decode(machine_number, eeprom_uid, bytearray(data))
+                with cycle.phase("decode"):
+                    cartridge = self.manager.decode(machine_number, eeprom_uid, bytearray(data))
 
             self.current_cartridge = cartridge
             self.machine_type = machine_type
@@ -229,43 +247,48 @@ class CartridgeController(QObject):
             self.log(f"Writing cartridge (machine type: {machine_type})...")
             self.progress_updated.emit("Encoding cartridge...", 10)
 
-            # Encode cartridge
-            machine_number = machine.get_number_from_type(machine_type)
-            eeprom_uid = bytes.fromhex(rom_address)
+            with self._cycle(f"write {rom_address}") as cycle:
+                # Encode cartridge
+                machine_number = machine.get_number_from_type(machine_type)
+                eeprom_uid = bytes.fromhex(rom_address)
 
-            encoded = self.manager.encode(machine_number, eeprom_uid, cartridge)
-            self.log(f"Encoded cartridge: {len(encoded)} bytes")
+                with cycle.phase("encode"):
+                    encoded = self.manager.encode(machine_number, eeprom_uid, cartridge)
+                self.log(f"Encoded cartridge: {len(encoded)} bytes")
 
-            self.progress_updated.emit("Writing to EEPROM...", 30)
+                self.progress_updated.emit("Writing to EEPROM...", 30)
 
-            # Write to EEPROM
-            if not self.bridge.onewire_write(bytes(encoded)):
-                raise Exception("Failed to write EEPROM")
+                # Write to EEPROM
+                with cycle.phase("write"):
+                    written = self.bridge.onewire_write(bytes(encoded))
+                if not written:
+                    raise Exception("Failed to write EEPROM")
 
-            # Give EEPROM time to commit write
-            import time
-            time.sleep(0.5)
+                # Give EEPROM time to commit write
+                import time
+                time.sleep(0.5)
 
-            self.progress_updated.emit("Verifying write...", 80)
+                self.progress_updated.emit("Verifying write...", 80)
 
-            # Verify by reading back
-            verify_data = self.bridge.onewire_read(len(encoded))
+                # Verify by reading back
+                with cycle.phase("verify"):
+                    verify_data = self.bridge.onewire_read(len(encoded))
 
-            if verify_data is None:
-                self.log("WARNING: Could not verify write")
-            elif bytes(verify_data) != bytes(encoded):
-                # Compare as bytes to handle bytearray vs bytes
-                self.log(f"Verification mismatch: read {len(verify_data)} bytes, expected {len(encoded)} bytes")
+                if verify_data is None:
+                    self.log("WARNING: Could not verify write")
+                elif bytes(verify_data) != bytes(encoded):
+                    # Compare as bytes to handle bytearray vs bytes
+                    self.log(f"Verification mismatch: read {len(verify_data)} bytes, expected {len(encoded)} bytes")
 
-                # Show first differences for debugging
-                for i in range(min(len(verify_data), len(encoded))):
-                    if verify_data[i] != encoded[i]:
-                        self.log(f"First mismatch at byte {i}: read 0x{verify_data[i]:02x}, wrote 0x{encoded[i]:02x}")
-                        break
+                    # Show first differences for debugging
+                    for i in range(min(len(verify_data), len(encoded))):
+                        if verify_data[i] != encoded[i]:
+                            self.log(f"First mismatch at byte {i}: read 0x{verify_data[i]:02x}, wrote 0x{encoded[i]:02x}")
+                            break
 
-                raise Exception("Verification failed - data mismatch")
-            else:
-                self.log("Verification successful - data matches")
+                    raise Exception("Verification failed - data mismatch")
+                else:
+                    self.log("Verification successful - data matches")
 
             self.current_cartridge = cartridge
             self.machine_type = machine_type
@@ -362,13 +385,45 @@ class CartridgeController(QObject):
 
         try:
             self.log("Sending DEBUG command...")
-            output = self.bridge._send_command("DEBUG")
+            output = self.bridge.debug()
             return output
 
         except Exception as e:
             self.error_occurred.emit(f"DEBUG command failed: {str(e)}")
             return None
 
+    @contextlib.contextmanager
+    def _cycle(self, label):
+        """Time one operation on the timeline, OK unless it raises"""
+        try:
+            with self.timeline.cycle(self.station, label) as cycle:
+                yield cycle
+        finally:
+            self.timeline_updated.emit()
+
+    def refresh_timeline(self):
+        """
+        Fetch bridge timings (STATS, TRACE) and, through the refill
+        daemon, the cycles it ran on every station.
+
+        Emits:
+            timeline_updated() on success
+        """
+        if not self.is_connected():
+            return False
+
+        try:
+            if isinstance(self.bridge, DaemonClient):
+                self.timeline.merge(self.bridge.timeline())
+            else:
+                self.timeline.pull(self.station, self.bridge)
+            self.timeline_updated.emit()
+            return True
+
+        except Exception as e:
+            self.log(f"Timeline refresh failed: {e}")
+            return False
+
     def log(self, message):
         """
         Emit log message.
@@ -1,7 +1,7 @@
 """
 Advanced Tab Widget - Simplified Version
 
-Hex viewer, debug console, and raw operations.
+Hex viewer, debug console, performance timeline and raw operations.
 """
 
 from PyQt5.QtWidgets import (
@@ -11,6 +11,8 @@ from PyQt5.QtWidgets import (
 from PyQt5.QtGui import QFont
 from PyQt5.QtCore import Qt
 
+from stratatools.gui.widgets.timeline_panel import TimelinePanel
+
 
 class AdvancedTab(QWidget):
     """Simplified Advanced Tab for debugging and raw operations"""
@@ -87,6 +89,16 @@ class AdvancedTab(QWidget):
         debug_group.setLayout(debug_layout)
         layout.addWidget(debug_group)
 
+        # Performance Timeline Group
+        timeline_group = QGroupBox("Performance Timeline")
+        timeline_layout = QVBoxLayout()
+
+        self.timeline_panel = TimelinePanel(self.controller)
+        timeline_layout.addWidget(self.timeline_panel)
+
+        timeline_group.setLayout(timeline_layout)
+        layout.addWidget(timeline_group)
+
     def connect_signals(self):
         """Connect controller signals"""
         self.controller.log_message.connect(self.append_log)
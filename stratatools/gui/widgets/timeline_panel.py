@@ -0,0 +1,206 @@
+"""
+Performance Timeline Panel
+
+Per-cycle phase timeline and rolling percentiles of every station, fed by
+the controller's own cycles, the refill daemon's and the bridge's STATS
+and TRACE timings (see stratatools/helper/cycle_timeline.py).
+"""
+
+import time
+
+from PyQt5.QtWidgets import (
+    QWidget, QVBoxLayout, QHBoxLayout, QLabel, QPushButton, QComboBox,
+    QCheckBox, QTableWidget, QTableWidgetItem, QHeaderView
+)
+from PyQt5.QtCore import Qt, QTimer, QRectF
+from PyQt5.QtGui import QColor, QFont, QPainter
+
+from stratatools.helper.cycle_timeline import PHASES, PERCENTILES
+
+PHASE_COLORS = {
+    "detect": QColor(120, 144, 156),
+    "read": QColor(66, 133, 244),
+    "decode": QColor(171, 71, 188),
+    "encode": QColor(255, 167, 38),
+    "write": QColor(229, 57, 53),
+    "verify": QColor(67, 160, 71),
+}
+
+# Cycles drawn, newest at the bottom
+TIMELINE_ROWS = 12
+
+REFRESH_MS = 2000
+
+
+class TimelineView(QWidget):
+    """Recent cycles of one station as rows of phase bars on a shared time axis"""
+
+    ROW_HEIGHT = 18
+    LABEL_WIDTH = 190
+
+    def __init__(self):
+        super().__init__()
+        self.cycles = []
+        self.setMinimumHeight(self.ROW_HEIGHT * (TIMELINE_ROWS + 2))
+
+    def set_cycles(self, cycles):
+        self.cycles = cycles[-TIMELINE_ROWS:]
+        self.update()
+
+    def paintEvent(self, event):
+        painter = QPainter(self)
+        painter.setFont(QFont("Courier", 8))
+
+        # Legend
+        x = self.LABEL_WIDTH
+        for phase in PHASES:
+            painter.fillRect(x, 4, 10, 10, PHASE_COLORS[phase])
+            painter.setPen(Qt.black)
+            painter.drawText(x + 14, 13, phase)
+            x += 80
+
+        if not self.cycles:
+            painter.drawText(8, self.ROW_HEIGHT * 2, "No cycles yet")
+            return
+
+        longest = max(cycle.elapsed() for cycle in self.cycles) or 1.0
+        width = max(1, self.width() - self.LABEL_WIDTH - 70)
+        scale = width / longest
+
+        for row, cycle in enumerate(self.cycles):
+            y = self.ROW_HEIGHT * (row + 1)
+
+            stamp = time.strftime("%H:%M:%S", time.localtime(cycle.started))
+            failed = cycle.result and cycle.result.startswith("ERROR")
+            painter.setPen(Qt.red if failed else Qt.black)
+            painter.drawText(4, y + 13, f"{stamp} {cycle.label or ''}"[:30])
+
+            for name, offset, seconds in cycle.phases:
+                rect = QRectF(self.LABEL_WIDTH + offset * scale, y + 3, max(1.0, seconds * scale), self.ROW_HEIGHT - 6)
+                painter.fillRect(rect, PHASE_COLORS.get(name, Qt.gray))
+
+            painter.setPen(Qt.black)
+            painter.drawText(self.width() - 66, y + 13, f"{cycle.elapsed() * 1000:7.0f} ms")
+
+
+class TimelinePanel(QWidget):
+    """Station picker, cycle timeline, percentile table and bridge counters"""
+
+    def __init__(self, controller):
+        super().__init__()
+        self.controller = controller
+        self.setup_ui()
+        self.connect_signals()
+
+    def setup_ui(self):
+        """Setup the user interface"""
+        layout = QVBoxLayout(self)
+
+        top_layout = QHBoxLayout()
+        top_layout.addWidget(QLabel("Station:"))
+        self.station_combo = QComboBox()
+        self.station_combo.setMinimumWidth(200)
+        self.station_combo.currentIndexChanged.connect(self.show_station)
+        top_layout.addWidget(self.station_combo)
+
+        self.refresh_btn = QPushButton("Refresh")
+        self.refresh_btn.setToolTip("Fetch STATS and TRACE from the bridge (and the daemon's cycles)")
+        self.refresh_btn.clicked.connect(self.refresh)
+        top_layout.addWidget(self.refresh_btn)
+
+        self.auto_check = QCheckBox("Auto refresh")
+        self.auto_check.toggled.connect(self.toggle_auto)
+        top_layout.addWidget(self.auto_check)
+
+        top_layout.addStretch()
+        layout.addLayout(top_layout)
+
+        self.view = TimelineView()
+        layout.addWidget(self.view)
+
+        self.table = QTableWidget(0, 3 + len(PERCENTILES))
+        self.table.setHorizontalHeaderLabels(
+            ["Phase / command", "Count", "Last ms"] + [f"p{pct} ms" for pct in PERCENTILES])
+        self.table.horizontalHeader().setSectionResizeMode(QHeaderView.Stretch)
+        self.table.verticalHeader().setVisible(False)
+        self.table.setEditTriggers(QTableWidget.NoEditTriggers)
+        self.table.setMinimumHeight(150)
+        layout.addWidget(self.table)
+
+        self.stats_label = QLabel("Bridge counters: -")
+        self.stats_label.setFont(QFont("Courier", 9))
+        self.stats_label.setWordWrap(True)
+        layout.addWidget(self.stats_label)
+
+        self.timer = QTimer(self)
+        self.timer.setInterval(REFRESH_MS)
+        self.timer.timeout.connect(self.refresh)
+
+    def connect_signals(self):
+        """Connect controller signals"""
+        self.controller.timeline_updated.connect(self.update_view)
+        self.controller.connection_changed.connect(self.on_connection_changed)
+
+    def on_connection_changed(self, connected):
+        if not connected:
+            self.auto_check.setChecked(False)
+
+    def toggle_auto(self, enabled):
+        if enabled:
+            self.refresh()
+            self.timer.start()
+        else:
+            self.timer.stop()
+
+    def refresh(self):
+        """Pull bridge and daemon timings"""
+        if not self.controller.is_connected():
+            self.update_view()
+            return
+        self.controller.refresh_timeline()
+
+    def update_view(self):
+        """Refresh the station list, then redraw the selected one"""
+        stations = self.controller.timeline.stations()
+        current = self.station_combo.currentText() or self.controller.station
+
+        self.station_combo.blockSignals(True)
+        self.station_combo.clear()
+        self.station_combo.addItems(stations)
+        if current in stations:
+            self.station_combo.setCurrentText(current)
+        self.station_combo.blockSignals(False)
+
+        self.show_station()
+
+    def show_station(self):
+        station = self.station_combo.currentText()
+        timeline = self.controller.timeline
+
+        self.view.set_cycles(timeline.recent(station) if station else [])
+
+        summary = timeline.summary(station) if station else {}
+        self.table.setRowCount(len(summary))
+        for row, (name, values) in enumerate(summary.items()):
+            cells = [name, str(values["count"]), f"{values['last'] * 1000:.1f}"]
+            cells += [f"{values[f'p{pct}'] * 1000:.1f}" for pct in PERCENTILES]
+            for column, text in enumerate(cells):
+                item = QTableWidgetItem(text)
+                if name in PHASE_COLORS and column == 0:
+                    item.setForeground(PHASE_COLORS[name])
+                self.table.setItem(row, column, item)
+
+        self.stats_label.setText("Bridge counters: " + self.format_stats(timeline.stats.get(station)))
+
+    def format_stats(self, stats):
+        """Average time per bridge command since the last STATS RESET"""
+        if not stats:
+            return "-"
+
+        parts = []
+        for op, values in stats.items():
+            if op == "CONTACT":
+                parts.append(f"contact {values['score']}/100")
+            elif values.get("count"):
+                parts.append(f"{op} {values['count']}x avg {values['total_us'] / values['count'] / 1000:.1f} ms")
+        return ", ".join(parts) or "-"
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+DS2433 Cartridge Emulator Control
+
+Loads cartridge images into the emulator firmware (ds2433_emulator/),
+which answers on a station's 1-Wire line as the cartridge, and starts
+the insert/remove cycle. Each image file is named after the ROM address
+of its cartridge, e.g. 2362474d0100006b.bin, and takes one slot.
+
+With --restore every insertion brings back the original image, so the
+station refills each time; --watch then reports cycles and copies per
+hour until Ctrl+C.
+
+Usage:
+    stratatools_cartridge_emulator /dev/ttyACM1 images/*.bin --auto 20000 2000 --restore --watch
+    stratatools_cartridge_emulator /dev/ttyACM1 --prog 3000 5000
+    stratatools_cartridge_emulator /dev/ttyACM1 --status
+"""
+
+import argparse
+import sys
+import time
+
+import serial
+
+from stratatools.helper.esp32_jobs import rom_from_filename
+
+# Image bytes per IMAGE command (the firmware takes up to 256)
+IMAGE_CHUNK = 128
+
+# Seconds between STATUS reports with --watch
+WATCH_INTERVAL = 10.0
+
+def parse_status(line):
+    """
+    Parse a STATUS response
+
+    STATUS:SLOT=<n>,ROM=<rom>,FAMILY=<name>,PROG=<min>/<max>,...
+
+    Returns:
+        dict of field -> value, numbers as int (SLOT is None when no
+        cartridge is inserted)
+    """
+    if line.startswith("STATUS:"):
+        line = line[len("STATUS:"):]
+
+    status = {}
+    for field in line.split(","):
+        if "=" not in field:
+            continue
+        key, value = field.split("=", 1)
+        key = key.lower()
+        if value == "-":
+            status[key] = None
+        elif value.isdigit():
+            status[key] = int(value)
+        else:
+            status[key] = value
+    return status
+
+class CartridgeEmulator:
+    """Serial interface to the emulator firmware"""
+
+    def __init__(self, port, baudrate=115200, timeout=2):
+        self.serial = serial.Serial(port, baudrate, timeout=timeout)
+        time.sleep(0.5)
+        while self.serial.in_waiting:
+            self.serial.readline()
+
+    def close(self):
+        self.serial.close()
+
+    def command(self, line):
+        """Send a command; returns the response, raises on ERROR"""
+        self.serial.write((line + "\n").encode())
+        response = self.serial.readline().decode("ascii", errors="ignore").strip()
+        if not response:
+            raise IOError(f"No response to {line.split()[0]}")
+        if response.startswith("ERROR"):
+            raise IOError(f"{line.split()[0]}: {response[len('ERROR'):].strip()}")
+        return response
+
+    def version(self):
+        return self.command("VERSION")
+
+    def load(self, slot, rom, image):
+        """Give a slot its ROM and image"""
+        self.command(f"ROM {slot} {rom}")
+        for offset in range(0, len(image), IMAGE_CHUNK):
+            self.command(f"IMAGE {slot} {offset} {image[offset:offset + IMAGE_CHUNK].hex()}")
+
+    def dump(self, slot, offset=0, length=None):
+        """Memory of a slot as the station left it"""
+        command = f"DUMP {slot}" if length is None else f"DUMP {slot} {offset} {length}"
+        return bytes.fromhex(self.command(command)[len("DATA:"):])
+
+    def restore(self, slot):
+        self.command(f"RESTORE {slot}")
+
+    def insert(self, slot):
+        self.command(f"INSERT {slot}")
+
+    def remove(self):
+        self.command("REMOVE")
+
+    def set_prog_delay(self, min_us, max_us=None):
+        self.command(f"PROG {min_us}" if max_us is None else f"PROG {min_us} {max_us}")
+
+    def start_auto(self, present_ms, absent_ms, restore=False):
+        self.command(f"AUTO {present_ms} {absent_ms}" + (" RESTORE" if restore else ""))
+
+    def stop_auto(self):
+        self.command("AUTO OFF")
+
+    def status(self):
+        return parse_status(self.command("STATUS"))
+
+def watch(emulator):
+    """Print cycle and copy rates until Ctrl+C"""
+    first = emulator.status()
+    started = time.time()
+    while True:
+        time.sleep(WATCH_INTERVAL)
+        status = emulator.status()
+        hours = (time.time() - started) / 3600
+        cycles = status["cycles"] - first["cycles"]
+        copies = status["copies"] - first["copies"]
+        print(f"{cycles} cycles ({cycles / hours:.0f}/h), {copies} copies ({copies / hours:.0f}/h), "
+              f"{status['rejected']} rejected, {status['stuck']} stuck, slot {status['slot']}")
+
+def main():
+    parser = argparse.ArgumentParser(description="Load and cycle cartridges on the DS2433 emulator")
+    parser.add_argument("port", help="Emulator serial port")
+    parser.add_argument("images", nargs="*", help="<rom>.bin images, one slot each")
+    parser.add_argument("--prog", type=int, nargs="+", metavar="US",
+                        help="Programming time of each copy scratchpad: <us> or <min_us> <max_us>")
+    parser.add_argument("--auto", type=int, nargs=2, metavar=("PRESENT_MS", "ABSENT_MS"),
+                        help="Cycle through the slots: inserted for PRESENT_MS, then removed for ABSENT_MS")
+    parser.add_argument("--restore", action="store_true", help="Restore each image when it is inserted again")
+    parser.add_argument("--watch", action="store_true", help="Report cycle rates until Ctrl+C")
+    parser.add_argument("--status", action="store_true", help="Print the emulator status")
+    args = parser.parse_args()
+
+    images = []
+    for path in args.images:
+        rom = rom_from_filename(path)
+        if rom is None:
+            print(f"ERROR: {path} is not named after a ROM address")
+            sys.exit(1)
+        with open(path, "rb") as f:
+            images.append((rom, f.read()))
+
+    try:
+        emulator = CartridgeEmulator(args.port)
+        print(emulator.version())
+
+        if images:
+            emulator.stop_auto()
+            emulator.remove()
+            for slot, (rom, image) in enumerate(images):
+                emulator.load(slot, rom, image)
+                print(f"Slot {slot}: {rom}, {len(image)} bytes")
+
+        if args.prog:
+            emulator.set_prog_delay(*args.prog[:2])
+
+        if args.auto:
+            emulator.start_auto(args.auto[0], args.auto[1], args.restore)
+        elif images:
+            emulator.insert(0)
+
+        if args.status:
+            for key, value in emulator.status().items():
+                print(f"{key}: {value}")
+
+        if args.watch:
+            watch(emulator)
+
+        emulator.close()
+        sys.exit(0)
+
+    except KeyboardInterrupt:
+        sys.exit(0)
+
+    except Exception as e:
+        print(f"ERROR: {str(e)}")
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
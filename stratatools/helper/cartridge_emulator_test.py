@@ -0,0 +1,55 @@
+import unittest
+from unittest import mock
+
+from stratatools.helper.cartridge_emulator import CartridgeEmulator, parse_status
+
+class FakeSerial:
+    def __init__(self, responses):
+        self.responses = [r.encode() + b"\r\n" for r in responses]
+        self.written = []
+        self.in_waiting = 0
+
+    def write(self, data):
+        self.written.append(data.decode().strip())
+
+    def readline(self):
+        return self.responses.pop(0) if self.responses else b""
+
+def make_emulator(responses):
+    with mock.patch("serial.Serial", return_value=FakeSerial([])), mock.patch("time.sleep"):
+        emulator = CartridgeEmulator("/dev/null")
+    emulator.serial = FakeSerial(responses)
+    return emulator
+
+class TestCartridgeEmulator(unittest.TestCase):
+    def test_parse_status(self):
+        status = parse_status("STATUS:SLOT=-,ROM=-,FAMILY=DS2433,PROG=3000/5000,AUTO=ON,CYCLES=12,COPIES=192")
+
+        assert status["slot"] is None
+        assert status["family"] == "DS2433"
+        assert status["prog"] == "3000/5000"
+        assert status["cycles"] == 12
+        assert status["copies"] == 192
+
+    def test_load_sends_image_in_chunks(self):
+        emulator = make_emulator(["OK"] * 6)
+        emulator.load(1, "2362474d0100006b", bytes(range(256)) * 2)
+
+        written = emulator.serial.written
+        assert written[0] == "ROM 1 2362474d0100006b"
+        assert len(written) == 5
+        assert written[1] == "IMAGE 1 0 " + bytes(range(128)).hex()
+        assert written[4].startswith("IMAGE 1 384 80818283")
+
+    def test_error_response_raises(self):
+        emulator = make_emulator(["ERROR No ROM in that slot"])
+
+        with self.assertRaises(IOError) as context:
+            emulator.insert(3)
+        assert "No ROM in that slot" in str(context.exception)
+
+    def test_dump(self):
+        emulator = make_emulator(["DATA:0a0b0c"])
+
+        assert emulator.dump(0, 16, 3) == b"\x0a\x0b\x0c"
+        assert emulator.serial.written == ["DUMP 0 16 3"]
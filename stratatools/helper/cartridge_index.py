@@ -0,0 +1,376 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Cartridge Index
+
+Per-station record of every cartridge seen: UID -> machine type, hash of
+the last image read or written, refill count. The refill daemon uses it
+to try the right machine type first, so the fast path works on the first
+attempt.
+
+Stations replicate their index with each other over TCP:
+
+    request:  {"op": "changes", "since": 42}
+    response: {"seq": 57, "entries": [{"uid": ..., "machine_type": ...,
+               "image_hash": ..., "refills": 3, "station_refills":
+               {"station-a": 2, "station-b": 1}, "stamp": 1700000000.25,
+               "station": "station-a"}, ...]}
+
+Every entry a station accepts (recorded locally or pulled from a peer)
+gets the next local sequence number. Each station periodically pulls the
+changes after the last sequence number it saw from each peer. An
+offline station catches up on its next pull, and entries spread
+transitively through any chain of peers. Conflicts are last-writer-wins
+on (stamp, station), except for the refill count: each station counts
+its own refills and a merge keeps the higher count per station, so
+refills recorded at two stations between pulls are all kept.
+
+Other operations: get (one UID), put (record an entry, for tools and
+tests; only accepted from the station's own host) and ping.
+
+Usage:
+    # Standalone station (the refill daemon embeds the same thing)
+    stratatools_cartridge_index --index ~/.stratatools/cartridges.json \\
+        --listen 0.0.0.0:7600 --peer station-b:7600 --peer station-c:7600
+"""
+
+import argparse
+import ipaddress
+import json
+import os
+import socket
+import socketserver
+import threading
+import time
+
+DEFAULT_PORT = 7600
+
+# Seconds between pulls from each peer
+DEFAULT_SYNC_INTERVAL = 5.0
+
+ENTRY_FIELDS = ("uid", "machine_type", "image_hash", "refills", "station_refills", "stamp", "station")
+
+def station_refills(entry):
+    """Refills per station of an entry (older entries only have a total)"""
+    if entry.get("station_refills") is not None:
+        return dict(entry["station_refills"])
+    if entry.get("refills"):
+        return {entry["station"]: entry["refills"]}
+    return {}
+
+def merge_refills(a, b):
+    """Per-station maximum of two station_refills dicts"""
+    merged = dict(a)
+    for station, count in b.items():
+        merged[station] = max(merged.get(station, 0), count)
+    return merged
+
+def parse_address(address):
+    """Split "host:port" (port defaults to DEFAULT_PORT)"""
+    host, _, port = address.rpartition(":")
+    if not host:
+        return (address, DEFAULT_PORT)
+    return (host, int(port))
+
+def query(address, op, timeout=5, **kwargs):
+    """Send one request to a station, returns the response dict"""
+    request = {"op": op}
+    request.update(kwargs)
+
+    with socket.create_connection(parse_address(address), timeout=timeout) as sock:
+        f = sock.makefile("rwb")
+        f.write((json.dumps(request) + "\n").encode())
+        f.flush()
+        line = f.readline()
+
+    if not line:
+        raise Exception(f"{address} closed the connection")
+
+    response = json.loads(line)
+    if not response.get("ok"):
+        raise Exception(response.get("error", "request failed"))
+    return response
+
+class CartridgeIndex:
+    """
+    UID -> cartridge record, with a local change sequence for delta sync
+    """
+
+    def __init__(self, path=None, station=None):
+        """
+        Args:
+            path: JSON file to persist to (None keeps the index in memory)
+            station: Name of this station, breaks last-writer-wins ties
+        """
+        self.path = path
+        self.station = station or socket.gethostname()
+        self.entries = {}
+        self.seq = 0
+        self.peers = {}
+        self.lock = threading.Lock()
+        self.save_lock = threading.Lock()
+
+        if path and os.path.exists(path):
+            with open(path) as f:
+                state = json.load(f)
+            self.entries = state.get("entries", {})
+            self.seq = state.get("seq", 0)
+            self.peers = state.get("peers", {})
+
+    def save(self):
+        """Write the index (atomically) if it has a file"""
+        if not self.path:
+            return
+
+        with self.lock:
+            state = {"station": self.station, "seq": self.seq, "entries": self.entries, "peers": self.peers}
+            data = json.dumps(state, indent=1, sort_keys=True)
+
+        directory = os.path.dirname(self.path)
+        if directory:
+            os.makedirs(directory, exist_ok=True)
+
+        with self.save_lock:
+            tmp = self.path + ".tmp"
+            with open(tmp, "w") as f:
+                f.write(data)
+            os.replace(tmp, self.path)
+
+    def get(self, uid):
+        """Return a copy of the entry for a UID, or None"""
+        with self.lock:
+            entry = self.entries.get(uid.lower())
+            return dict(entry) if entry else None
+
+    def machine_type(self, uid):
+        """Known machine type of a cartridge, or None"""
+        entry = self.get(uid)
+        return entry["machine_type"] if entry else None
+
+    def record(self, uid, machine_type=None, image_hash=None, refilled=False):
+        """
+        Update the entry for a cartridge handled at this station
+
+        Fields left as None keep their current value.
+
+        Returns:
+            The new entry
+        """
+        uid = uid.lower()
+        with self.lock:
+            old = self.entries.get(uid, {})
+
+            # Always newer than the version we are replacing, even if this
+            # station's clock is behind the one that wrote it
+            stamp = max(time.time(), old.get("stamp", 0) + 1e-3)
+
+            refills = station_refills(old)
+            if refilled:
+                refills[self.station] = refills.get(self.station, 0) + 1
+
+            entry = {
+                "uid": uid,
+                "machine_type": machine_type or old.get("machine_type"),
+                "image_hash": image_hash or old.get("image_hash"),
+                "refills": sum(refills.values()),
+                "station_refills": refills,
+                "stamp": stamp,
+                "station": self.station,
+            }
+            self._store(entry)
+
+        self.save()
+        return dict(entry)
+
+    def merge(self, entry):
+        """
+        Apply an entry from another station (last writer wins, refill
+        counts merged per station)
+
+        Returns:
+            True if the entry changed the local one
+        """
+        entry = {field: entry.get(field) for field in ENTRY_FIELDS}
+        entry["uid"] = entry["uid"].lower()
+
+        with self.lock:
+            old = self.entries.get(entry["uid"])
+            if old:
+                refills = merge_refills(station_refills(old), station_refills(entry))
+                if (old["stamp"], old["station"]) >= (entry["stamp"], entry["station"]):
+                    # Older fields, but it may carry refills this station missed
+                    if refills == station_refills(old):
+                        return False
+                    entry = dict(old)
+                entry["station_refills"] = refills
+                entry["refills"] = sum(refills.values())
+            else:
+                entry["station_refills"] = station_refills(entry)
+            self._store(entry)
+            return True
+
+    def _store(self, entry):
+        # Caller holds the lock
+        self.seq += 1
+        entry["seq"] = self.seq
+        self.entries[entry["uid"]] = entry
+
+    def changes(self, since):
+        """
+        Entries accepted after local sequence number since
+
+        Returns:
+            (current sequence number, list of entries)
+        """
+        with self.lock:
+            changed = [{field: entry[field] for field in ENTRY_FIELDS}
+                       for entry in sorted(self.entries.values(), key=lambda e: e["seq"])
+                       if entry["seq"] > since]
+            return (self.seq, changed)
+
+class _IndexHandler(socketserver.StreamRequestHandler):
+    def handle(self):
+        local = ipaddress.ip_address(self.client_address[0]).is_loopback
+        for line in self.rfile:
+            try:
+                response = self.server.replicator.handle_request(json.loads(line), local)
+                response["ok"] = True
+            except Exception as e:
+                response = {"ok": False, "error": str(e)}
+            self.wfile.write((json.dumps(response) + "\n").encode())
+
+class _IndexServer(socketserver.ThreadingTCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+class IndexReplicator:
+    """
+    Serves a CartridgeIndex to peers and pulls their changes
+    """
+
+    def __init__(self, index, listen=None, peers=(), interval=DEFAULT_SYNC_INTERVAL):
+        """
+        Args:
+            index: CartridgeIndex to replicate
+            listen: "host:port" to serve on (None: pull only)
+            peers: "host:port" of the other stations
+            interval: Seconds between pull rounds
+        """
+        self.index = index
+        self.peers = list(peers)
+        self.interval = interval
+        self.server = None
+        self.stopped = threading.Event()
+
+        if listen:
+            self.server = _IndexServer(parse_address(listen), _IndexHandler)
+            self.server.replicator = self
+
+    @property
+    def address(self):
+        """"host:port" actually listened on"""
+        host, port = self.server.server_address[:2]
+        return f"{host}:{port}"
+
+    def handle_request(self, request, local=True):
+        """
+        Answer one request; local is False for clients on other hosts,
+        which may only read
+        """
+        op = request.get("op")
+
+        if op == "ping":
+            return {"station": self.index.station}
+
+        if op == "changes":
+            seq, entries = self.index.changes(int(request.get("since", 0)))
+            return {"seq": seq, "entries": entries}
+
+        if op == "get":
+            return {"entry": self.index.get(request["uid"])}
+
+        if op == "put":
+            if not local:
+                raise Exception("put is only accepted from this host")
+            return {"entry": self.index.record(request["uid"], request.get("machine_type"),
+                                               request.get("image_hash"), bool(request.get("refilled")))}
+
+        raise Exception(f"Unknown operation: {op}")
+
+    def pull(self, peer):
+        """
+        Fetch and merge a peer's changes since the last pull
+
+        Returns:
+            Number of entries that replaced local ones
+        """
+        since = self.index.peers.get(peer, 0)
+        response = query(peer, "changes", since=since)
+
+        if response["seq"] < since:
+            # The peer lost its index; start over from its beginning
+            response = query(peer, "changes", since=0)
+
+        applied = sum(1 for entry in response["entries"] if self.index.merge(entry))
+        with self.index.lock:
+            self.index.peers[peer] = response["seq"]
+        return applied
+
+    def sync(self):
+        """Pull from every reachable peer, returns entries applied"""
+        applied = 0
+        for peer in self.peers:
+            try:
+                applied += self.pull(peer)
+            except Exception:
+                # Offline peers are caught up with on a later round
+                continue
+        self.index.save()
+        return applied
+
+    def _sync_loop(self):
+        while not self.stopped.wait(self.interval):
+            self.sync()
+
+    def start(self):
+        if self.server:
+            threading.Thread(target=self.server.serve_forever, daemon=True).start()
+        threading.Thread(target=self._sync_loop, daemon=True).start()
+        return self
+
+    def close(self):
+        self.stopped.set()
+        if self.server:
+            self.server.shutdown()
+            self.server.server_close()
+        self.index.save()
+
+def main():
+    parser = argparse.ArgumentParser(description="Replicate the cartridge index between refill stations")
+    parser.add_argument("--index", required=True, help="Index file")
+    parser.add_argument("--station", help="Station name (default: host name)")
+    parser.add_argument("--listen", default=f"127.0.0.1:{DEFAULT_PORT}",
+                        help="Address to serve on (0.0.0.0:<port> to reach other stations)")
+    parser.add_argument("--peer", action="append", default=[], help="Peer station host:port (repeatable)")
+    parser.add_argument("--interval", type=float, default=DEFAULT_SYNC_INTERVAL,
+                        help="Seconds between pulls from each peer")
+    args = parser.parse_args()
+
+    index = CartridgeIndex(args.index, args.station)
+    replicator = IndexReplicator(index, args.listen, args.peer, args.interval).start()
+    print(f"Station {index.station} serving on {replicator.address}", flush=True)
+
+    try:
+        while True:
+            time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        replicator.close()
+
+if __name__ == "__main__":
+    main()
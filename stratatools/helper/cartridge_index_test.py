@@ -0,0 +1,162 @@
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+import unittest
+
+from stratatools.helper.cartridge_index import CartridgeIndex, IndexReplicator, query
+
+UID = "2362474d0100006b"
+
+def free_port():
+    with socket.socket() as sock:
+        sock.bind(("127.0.0.1", 0))
+        return sock.getsockname()[1]
+
+def wait_for(check, timeout=10):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        try:
+            if check():
+                return True
+        except Exception:
+            pass
+        time.sleep(0.05)
+    return False
+
+class TestCartridgeIndex(unittest.TestCase):
+    def test_delta_changes(self):
+        index = CartridgeIndex(station="a")
+        index.record(UID, machine_type="prodigy")
+        seq, _ = index.changes(0)
+        index.record("11010a01ba325d23", machine_type="fox")
+
+        newer_seq, entries = index.changes(seq)
+        assert newer_seq == seq + 1
+        assert [e["uid"] for e in entries] == ["11010a01ba325d23"]
+
+    def test_last_writer_wins(self):
+        index = CartridgeIndex(station="a")
+        entry = index.record(UID, machine_type="prodigy", refilled=True)
+
+        older = dict(entry, machine_type="fox", stamp=entry["stamp"] - 1, station="b")
+        assert not index.merge(older)
+        assert index.machine_type(UID) == "prodigy"
+
+        newer = dict(entry, machine_type="fox", stamp=entry["stamp"] + 1, station="b")
+        assert index.merge(newer)
+        assert index.get(UID)["machine_type"] == "fox"
+
+        # Equal stamps: the station name breaks the tie the same way everywhere
+        tie = dict(newer, machine_type="uprint", station="c")
+        assert index.merge(tie)
+        assert not index.merge(newer)
+
+    def test_record_keeps_fields(self):
+        index = CartridgeIndex(station="a")
+        index.record(UID, machine_type="prodigy", image_hash="aa", refilled=True)
+        entry = index.record(UID, refilled=True)
+
+        assert entry["machine_type"] == "prodigy"
+        assert entry["image_hash"] == "aa"
+        assert entry["refills"] == 2
+
+    def test_concurrent_refills(self):
+        a = CartridgeIndex(station="a")
+        b = CartridgeIndex(station="b")
+        b.merge(a.record(UID, machine_type="prodigy"))
+
+        # Both stations refill before either pulls: neither increment is lost
+        first = a.record(UID, refilled=True)
+        second = b.record(UID, refilled=True)
+        assert a.merge(second)
+        assert b.merge(first)
+        assert a.get(UID)["refills"] == b.get(UID)["refills"] == 2
+        assert a.get(UID)["station_refills"] == {"a": 1, "b": 1}
+
+        # Settled: nothing left to exchange
+        assert not a.merge(b.get(UID))
+        assert not b.merge(a.get(UID))
+
+    def test_legacy_refills(self):
+        index = CartridgeIndex(station="a")
+        legacy = {"uid": UID, "machine_type": "prodigy", "image_hash": None, "refills": 3,
+                  "stamp": 1.0, "station": "b"}
+        assert index.merge(legacy)
+        assert index.record(UID, refilled=True)["station_refills"] == {"a": 1, "b": 3}
+
+    def test_put_only_local(self):
+        replicator = IndexReplicator(CartridgeIndex(station="a"))
+        with self.assertRaises(Exception):
+            replicator.handle_request({"op": "put", "uid": UID, "machine_type": "fox"}, local=False)
+        assert replicator.handle_request({"op": "get", "uid": UID}, local=False) == {"entry": None}
+
+    def test_pull(self):
+        a = IndexReplicator(CartridgeIndex(station="a"), "127.0.0.1:0").start()
+        try:
+            b = IndexReplicator(CartridgeIndex(station="b"), peers=[a.address])
+            a.index.record(UID, machine_type="prodigy")
+
+            assert b.pull(a.address) == 1
+            assert b.pull(a.address) == 0
+            assert b.index.machine_type(UID) == "prodigy"
+        finally:
+            a.close()
+
+class TestStationReplication(unittest.TestCase):
+    """Three station processes on loopback, chained a <-> b <-> c"""
+
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.ports = {name: free_port() for name in "abc"}
+        self.peers = {"a": ["b"], "b": ["a", "c"], "c": ["b"]}
+        self.procs = {}
+        for name in "abc":
+            self.start(name)
+
+    def tearDown(self):
+        for proc in self.procs.values():
+            proc.terminate()
+            proc.wait()
+
+    def address(self, name):
+        return f"127.0.0.1:{self.ports[name]}"
+
+    def start(self, name):
+        args = [sys.executable, "-m", "stratatools.helper.cartridge_index",
+                "--index", os.path.join(self.dir, f"{name}.json"), "--station", name,
+                "--listen", self.address(name), "--interval", "0.1"]
+        for peer in self.peers[name]:
+            args += ["--peer", self.address(peer)]
+
+        env = dict(os.environ, PYTHONDONTWRITEBYTECODE="1")
+        self.procs[name] = subprocess.Popen(args, stdout=subprocess.DEVNULL, env=env)
+        assert wait_for(lambda: query(self.address(name), "ping"))
+
+    def stop(self, name):
+        self.procs[name].terminate()
+        self.procs[name].wait()
+
+    def entry(self, name, uid=UID):
+        return query(self.address(name), "get", uid=uid)["entry"]
+
+    def test_replication(self):
+        query(self.address("a"), "put", uid=UID, machine_type="prodigy")
+        assert wait_for(lambda: self.entry("c")["machine_type"] == "prodigy")
+
+        # c goes offline and misses two updates
+        self.stop("c")
+        query(self.address("a"), "put", uid=UID, refilled=True)
+        query(self.address("a"), "put", uid="11010a01ba325d23", machine_type="fox")
+        assert wait_for(lambda: self.entry("b")["refills"] == 1)
+
+        self.start("c")
+        assert wait_for(lambda: self.entry("c", "11010a01ba325d23")["machine_type"] == "fox")
+        assert self.entry("c")["refills"] == 1
+
+        # Concurrent writes at both ends: everyone settles on the later one
+        query(self.address("a"), "put", uid=UID, machine_type="fox")
+        query(self.address("c"), "put", uid=UID, machine_type="uprint")
+        assert wait_for(lambda: all(self.entry(n)["machine_type"] == "uprint" for n in "abc"))
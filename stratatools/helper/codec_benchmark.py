@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Decode Scaling Benchmark
+
+Times the decryption of a batch of cartridge images (one per station) for
+1..N threads:
+
+    python   pure-Python Manager.decrypt, one image after the other
+    batch    native codec decrypt_batch() on its worker pool
+    callers  N Python threads each calling Manager.decrypt (what a
+             multi-station daemon does); scales only because the native
+             codec releases the GIL
+
+Speedup is against one thread of the same mode. On a machine with enough
+cores, a batch of 16 should take about as long as a single image.
+
+Usage:
+    stratatools_codec_benchmark
+    stratatools_codec_benchmark --images 16 --threads 16 --repeat 500
+"""
+
+import argparse
+import os
+import sys
+import threading
+import time
+
+from stratatools import codec, machine
+from stratatools.cartridge_pb2 import Cartridge
+from stratatools.checksum import Crc16_Checksum
+from stratatools.crypto import Desx_Crypto
+from stratatools.manager import Manager
+
+MACHINE_TYPE = "prodigy"
+
+def make_items(count):
+    """count encoded images, each with its own UID and serial number"""
+    manager = Manager(Desx_Crypto(), Crc16_Checksum())
+    manager.native = False
+    machine_number = machine.get_number_from_type(MACHINE_TYPE)
+
+    items = []
+    for i in range(count):
+        cartridge = Cartridge()
+        cartridge.serial_number = 1000.0 + i
+        cartridge.material_name = "ABS"
+        cartridge.manufacturing_lot = "1234"
+        cartridge.manufacturing_date.FromSeconds(978310861)
+        cartridge.last_use_date.FromSeconds(1012615322)
+        cartridge.initial_material_quantity = 56.3
+        cartridge.current_material_quantity = 1.2
+        cartridge.key_fragment = bytes.fromhex("4142434441424344")
+        cartridge.version = 1
+
+        eeprom_uid = bytes([0x23, i & 0xFF, 0x47, 0x4D, 0x01, 0x00, 0x00, 0x6B])
+        items.append((machine_number, eeprom_uid, bytes(manager.encode(machine_number, eeprom_uid, cartridge))))
+    return items
+
+def time_it(run, repeat):
+    """Seconds per run, best of three rounds"""
+    best = None
+    for _ in range(3):
+        start = time.perf_counter()
+        for _ in range(repeat):
+            run()
+        elapsed = (time.perf_counter() - start) / repeat
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+def callers(manager, items, threads):
+    """Decrypt items from 'threads' Python threads, each taking its share"""
+    def work(share):
+        for machine_number, eeprom_uid, image in share:
+            manager.decrypt(machine_number, eeprom_uid, bytearray(image))
+
+    workers = [threading.Thread(target=work, args=(items[i::threads],)) for i in range(threads)]
+    for worker in workers:
+        worker.start()
+    for worker in workers:
+        worker.join()
+
+def thread_counts(maximum):
+    """1, 2, 4, ... up to and including maximum"""
+    counts = []
+    n = 1
+    while n < maximum:
+        counts.append(n)
+        n *= 2
+    counts.append(maximum)
+    return counts
+
+def main():
+    parser = argparse.ArgumentParser(description="Cartridge decode scaling benchmark")
+    parser.add_argument("--images", type=int, default=16, help="Images per batch (default: 16)")
+    parser.add_argument("--threads", type=int, default=max(codec.default_threads(), 16),
+                        help="Most threads to try (default: 16 or the core count)")
+    parser.add_argument("--repeat", type=int, default=200, help="Batches per measurement (default: 200)")
+    args = parser.parse_args()
+
+    items = make_items(args.images)
+    python = Manager(Desx_Crypto(), Crc16_Checksum())
+    python.native = False
+    native = Manager(Desx_Crypto(), Crc16_Checksum())
+
+    print(f"{args.images} images per batch, {codec.default_threads()} core(s)")
+    print(f"{'mode':<8} {'threads':>7} {'ms/batch':>10} {'us/image':>10} {'speedup':>8}")
+
+    def report(mode, threads, seconds, base):
+        print(f"{mode:<8} {threads:>7} {seconds * 1e3:>10.3f} {seconds * 1e6 / args.images:>10.1f} "
+              f"{base / seconds:>7.2f}x")
+
+    # The pure-Python path is slow; fewer rounds keep the run short
+    seconds = time_it(lambda: callers(python, items, 1), max(1, args.repeat // 20))
+    report("python", 1, seconds, seconds)
+
+    if not codec.NATIVE:
+        print("Native codec not built (pip install . with a C++ compiler)")
+        sys.exit(1)
+
+    base = None
+    for threads in thread_counts(args.threads):
+        seconds = time_it(lambda: codec.decrypt_batch(items, threads), args.repeat)
+        base = base or seconds
+        report("batch", threads, seconds, base)
+
+    base = None
+    for threads in thread_counts(min(args.threads, args.images)):
+        seconds = time_it(lambda: callers(native, items, threads), args.repeat)
+        base = base or seconds
+        report("callers", threads, seconds, base)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,316 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Local Control Socket
+
+The refill daemon owns every bridge and serves this Unix-socket API so
+the GUI and console tools share bridges instead of each opening the
+serial port (and paying the handshake) themselves.
+
+Protocol: one JSON object per line.
+
+    request:  {"id": 1, "op": "read", "port": "/dev/ttyUSB0", "length": 512, "address": 0}
+    response: {"id": 1, "ok": true, "data": "0001..."}
+              {"id": 1, "ok": false, "error": "No device found"}
+
+Operations: ping, status, timeline, reset, search, read, write, debug,
+job, jobs, clear_jobs, results, backups, contact, stats, trace, subscribe.
+"port" may be omitted when the daemon owns a single bridge. After a
+subscribe request the connection receives {"event": ..., "port": ...}
+lines until it is closed.
+"""
+
+import errno
+import json
+import logging
+import os
+import queue
+import socket
+import socketserver
+import stat
+import threading
+
+from stratatools.helper.esp32_bridge import ESP32Bridge
+from stratatools.helper.pico_station import PicoStation, split_port
+
+DEFAULT_SOCKET_PATH = os.environ.get("STRATATOOLS_SOCKET", "/tmp/stratatools.sock")
+
+# No Unix sockets on Windows: there is no daemon to find and clients
+# always open the serial port directly
+UNIX_SOCKETS = hasattr(socket, "AF_UNIX")
+_UnixStreamServer = getattr(socketserver, "UnixStreamServer", object)
+
+class _ControlHandler(socketserver.StreamRequestHandler):
+    def handle(self):
+        for line in self.rfile:
+            try:
+                request = json.loads(line)
+            except ValueError:
+                self._reply({"ok": False, "error": "invalid request"})
+                continue
+
+            if request.get("op") == "subscribe":
+                self._reply({"id": request.get("id"), "ok": True})
+                self._stream_events()
+                return
+
+            try:
+                response = self.server.owner.handle_request(request)
+                response["ok"] = True
+            except Exception as e:
+                response = {"ok": False, "error": str(e)}
+
+            response["id"] = request.get("id")
+            self._reply(response)
+
+    def _reply(self, message):
+        self.wfile.write((json.dumps(message) + "\n").encode())
+
+    def _stream_events(self):
+        events = queue.Queue()
+        self.server.subscribers.append(events)
+        try:
+            while True:
+                self._reply(events.get())
+        except OSError:
+            pass
+        finally:
+            self.server.subscribers.remove(events)
+
+class ControlServer(socketserver.ThreadingMixIn, _UnixStreamServer):
+    """
+    Unix-socket server in front of the bridge owner
+
+    The owner implements handle_request(request) -> dict and raises on
+    failure; events are pushed with publish().
+    """
+
+    daemon_threads = True
+
+    def __init__(self, owner, path=DEFAULT_SOCKET_PATH):
+        """
+        Raises:
+            OSError: path is served by another process, or is not a socket
+        """
+        self._remove_stale(path)
+
+        self.owner = owner
+        self.path = path
+        self.subscribers = []
+        super().__init__(path, _ControlHandler)
+        os.chmod(path, 0o660)
+
+        self.thread = threading.Thread(target=self.serve_forever, daemon=True)
+
+    @staticmethod
+    def _remove_stale(path):
+        """Unlink a socket left behind by a process that is gone"""
+        try:
+            mode = os.lstat(path).st_mode
+        except FileNotFoundError:
+            return
+
+        if not stat.S_ISSOCK(mode):
+            raise OSError(errno.EEXIST, f"{path} exists and is not a socket")
+
+        probe = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            probe.connect(path)
+        except OSError:
+            os.unlink(path)
+            return
+        finally:
+            probe.close()
+        raise OSError(errno.EADDRINUSE, f"{path} is served by another process")
+
+    def start(self):
+        self.thread.start()
+        return self
+
+    def publish(self, port, event):
+        """Send an event to every subscriber"""
+        for subscriber in list(self.subscribers):
+            subscriber.put({"event": event, "port": port})
+
+    def close(self):
+        self.shutdown()
+        self.server_close()
+        if os.path.exists(self.path):
+            os.unlink(self.path)
+
+class DaemonClient:
+    """
+    Thin client for the control socket
+
+    Offers the same methods as ESP32Bridge, so callers can use either.
+    """
+
+    def __init__(self, path=DEFAULT_SOCKET_PATH, port=None, timeout=30):
+        """
+        Args:
+            path: Control socket path
+            port: Bridge serial port to address (None if the daemon has one)
+            timeout: Seconds to wait for a response
+        """
+        self.port = port
+        self.log = logging.getLogger(__name__)
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.settimeout(timeout)
+        self.sock.connect(path)
+        self.file = self.sock.makefile("rwb")
+        self.next_id = 0
+
+    def _request(self, op, **kwargs):
+        self.next_id += 1
+        request = {"id": self.next_id, "op": op, "port": self.port}
+        request.update(kwargs)
+
+        self.file.write((json.dumps(request) + "\n").encode())
+        self.file.flush()
+
+        line = self.file.readline()
+        if not line:
+            raise Exception("refill daemon closed the connection")
+
+        response = json.loads(line)
+        if not response.get("ok"):
+            raise Exception(response.get("error", "request failed"))
+        return response
+
+    def _clear_buffer(self):
+        """Nothing to clear - kept for ESP32Bridge compatibility"""
+        pass
+
+    def initialize(self):
+        try:
+            self._request("ping")
+            return True
+        except Exception:
+            return False
+
+    def status(self):
+        """Return the daemon status (bridges, cartridges, counters)"""
+        return self._request("status")
+
+    def onewire_reset_bus(self):
+        return self._request("reset")["result"]
+
+    def onewire_macro_search(self):
+        try:
+            return self._request("search")["rom"]
+        except Exception:
+            return None
+
+    def onewire_search(self):
+        return self.onewire_macro_search()
+
+    def onewire_read(self, length, address=0):
+        try:
+            return bytes.fromhex(self._request("read", length=length, address=address)["data"])
+        except Exception as e:
+            self.log.error(f"Daemon read failed: {e}")
+            return None
+
+    def onewire_write(self, data):
+        try:
+            return self._request("write", data=bytes(data).hex())["result"]
+        except Exception:
+            return False
+
+    def debug(self):
+        return self._request("debug")["output"]
+
+    def queue_job(self, rom_address, data):
+        try:
+            return self._request("job", rom=rom_address, data=bytes(data).hex())["pending"]
+        except Exception:
+            return None
+
+    def job_status(self):
+        response = self._request("jobs")
+        return (response["pending"], response["completed"])
+
+    def clear_jobs(self):
+        return self._request("clear_jobs")["result"]
+
+    def job_results(self):
+        return [tuple(result) for result in self._request("results")["results"]]
+
+    def job_backups(self, since=0):
+        result = self._request("backups", since=since)["backups"]
+        if result is None:
+            return None
+        last_seq, records = result
+        return (last_seq, [(seq, millis, rom, bytes.fromhex(image)) for seq, millis, rom, image in records])
+
+    def contact_quality(self):
+        return self._request("contact")["contact"]
+
+    def stats(self):
+        return self._request("stats")["stats"]
+
+    def trace(self, since=0):
+        result = self._request("trace", since=since)["trace"]
+        return tuple(result) if result else None
+
+    def timeline(self):
+        """Cycles the daemon ran, per port (CycleTimeline.to_dict())"""
+        return self._request("timeline")["timeline"]
+
+    def events(self):
+        """Subscribe, returns an iterator of (port, event) tuples"""
+        self.sock.settimeout(None)
+        self._request("subscribe")
+        return self._iter_events()
+
+    def _iter_events(self):
+        for line in self.file:
+            message = json.loads(line)
+            yield (message["port"], message["event"])
+
+    def close(self):
+        try:
+            self.file.close()
+            self.sock.close()
+        except OSError:
+            pass
+
+def daemon_running(path=DEFAULT_SOCKET_PATH):
+    """Check whether a refill daemon is listening on the control socket"""
+    if not UNIX_SOCKETS or not os.path.exists(path):
+        return False
+
+    try:
+        client = DaemonClient(path, timeout=1)
+        alive = client.initialize()
+        client.close()
+        return alive
+    except OSError:
+        return False
+
+def open_bridge(port, timeout=2, path=DEFAULT_SOCKET_PATH):
+    """
+    Open a bridge, going through the daemon when it owns the port
+
+    Returns:
+        DaemonClient if a running daemon owns the port, else an ESP32Bridge
+        (a SocketBridge for "<port>#<n>", a multi-socket station socket)
+    """
+    if daemon_running(path):
+        client = DaemonClient(path, port=port)
+        try:
+            if port is None or port in client.status()["ports"]:
+                return client
+        except Exception:
+            pass
+        client.close()
+
+    device, socket_number = split_port(port) if port else (port, None)
+    if socket_number is not None:
+        return PicoStation(device, timeout=timeout).socket(socket_number)
+
+    return ESP32Bridge(port=port, timeout=timeout)
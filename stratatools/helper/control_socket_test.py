@@ -0,0 +1,79 @@
+import os
+import tempfile
+import unittest
+
+from stratatools.helper.control_socket import ControlServer, DaemonClient, daemon_running
+
+class FakeOwner:
+    def __init__(self):
+        self.image = bytearray(512)
+
+    def handle_request(self, request):
+        op = request["op"]
+        if op == "ping":
+            return {}
+        if op == "status":
+            return {"ports": {"/dev/fake": {"refills": 0}}}
+        if op == "search":
+            return {"rom": "2362474d0100006b"}
+        if op == "read":
+            return {"data": bytes(self.image[:request["length"]]).hex()}
+        if op == "write":
+            data = bytes.fromhex(request["data"])
+            self.image[:len(data)] = data
+            return {"result": True}
+        if op == "backups":
+            return {"backups": [2, [[2, 1200, "2362474d0100006b", "0102"]]]}
+        raise Exception("Unknown operation")
+
+class TestControlSocket(unittest.TestCase):
+    def setUp(self):
+        self.path = os.path.join(tempfile.mkdtemp(), "stratatools.sock")
+        self.owner = FakeOwner()
+        self.server = ControlServer(self.owner, self.path).start()
+
+    def tearDown(self):
+        self.server.close()
+
+    def test_bridge_operations(self):
+        assert daemon_running(self.path)
+
+        client = DaemonClient(self.path, port="/dev/fake")
+        assert client.initialize()
+        assert client.onewire_macro_search() == "2362474d0100006b"
+        assert client.onewire_write(b"\x01\x02\x03")
+        assert client.onewire_read(4) == b"\x01\x02\x03\x00"
+        assert client.job_backups(1) == (2, [(2, 1200, "2362474d0100006b", b"\x01\x02")])
+        client.close()
+
+    def test_refuses_live_socket(self):
+        with self.assertRaises(OSError):
+            ControlServer(FakeOwner(), self.path)
+        assert daemon_running(self.path)
+
+    def test_replaces_stale_socket(self):
+        self.server.shutdown()
+        self.server.server_close()
+
+        # The path is still there, but nobody listens
+        assert os.path.exists(self.path)
+        self.server = ControlServer(self.owner, self.path).start()
+        assert daemon_running(self.path)
+
+    def test_errors_are_reported(self):
+        client = DaemonClient(self.path)
+        with self.assertRaises(Exception):
+            client._request("bogus")
+        client.close()
+
+    def test_events(self):
+        client = DaemonClient(self.path)
+        events = client.events()
+
+        # The handler registers the subscriber right after acknowledging
+        while not self.server.subscribers:
+            self.server.thread.join(0.01)
+
+        self.server.publish("/dev/fake", "CARTRIDGE_INSERTED:2362474d0100006b")
+        assert next(events) == ("/dev/fake", "CARTRIDGE_INSERTED:2362474d0100006b")
+        client.close()
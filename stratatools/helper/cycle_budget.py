@@ -0,0 +1,375 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Cycle-Time Budget for the 1-Wire Bridge
+
+Computes the least time each bridge operation can take from first
+principles and compares it with measured timings, so the phase with the
+largest gap (1-Wire bus, EEPROM programming, serial link, firmware or
+host) is the one worth optimising next.
+
+Model inputs:
+    - 1-Wire slot and reset timings (standard or overdrive, Maxim AN126
+      recommended values)
+    - bytes on the bus, as the bridge firmware sends them
+    - serial baud rate, 8N1 framing and channel framing overhead
+    - EEPROM page size and the programming time the firmware waits (the
+      part's maximum tPROG)
+
+Measurements come from the firmware's STATS counters (device time) and
+from a benchmark run on the host (round-trip time).
+
+Usage:
+    # Model only
+    stratatools_cycle_budget --family DS2433 --baud 115200
+
+    # Benchmark a bridge and compare
+    stratatools_cycle_budget --port /dev/ttyUSB0 --iterations 10
+
+    # Compare a STATS line captured earlier
+    stratatools_cycle_budget --stats "STATS:SEARCH=5/0/61000/12000,..."
+"""
+
+import argparse
+import math
+import sys
+import time
+
+# Slot times in microseconds (Maxim AN126): write 1 = A+B, write 0 = C+D,
+# read = A+E+F, reset = G+H+I+J. One bit costs the longest of the three.
+ONEWIRE_TIMINGS = {
+    "standard": {"write1": 70, "write0": 70, "read": 70, "reset": 960},
+    "overdrive": {"write1": 8.5, "write0": 10, "read": 9, "reset": 121},
+}
+
+# Mirrors esp32_bridge/src/onewire_families.h: (memory, page size,
+# full page write, typical and maximum programming time in us). The
+# firmware waits the maximum after every copy, so that is what the budget
+# charges; the typical time is what the part itself needs.
+FAMILIES = {
+    "DS2433": (512, 32, False, 3000, 5000),
+    "DS2431": (128, 8, True, 7000, 10000),
+    "DS28EC20": (2560, 32, False, 7000, 10000),
+}
+
+# Serial framing: start + 8 data + stop bits
+UART_BITS_PER_BYTE = 10
+
+# Channel framing (see esp32_bridge/src/channel_mux.h): tag, more flag,
+# and CRLF per frame; bulk data goes in 32-byte frames
+MUX_FRAME_OVERHEAD = 4
+MUX_CHUNK_BYTES = 32
+
+PHASES = ("bus", "prog", "link")
+OPERATIONS = ("SEARCH", "RESET", "READ", "WRITE", "PATCH")
+
+# STATS CONTACT=<score>/<delay_us>/<width_us>/<rise_us> (firmware v1.3+)
+CONTACT_FIELDS = ("score", "delay_us", "width_us", "rise_us")
+
+class CycleBudget:
+    """Theoretical minimum time per bridge operation"""
+
+    def __init__(self, family="DS2433", speed="standard", baud=115200, multiplexed=True):
+        self.timing = ONEWIRE_TIMINGS[speed]
+        (self.memory_size, self.page_size, self.full_page_write,
+         self.prog_typical_us, self.prog_us) = FAMILIES[family]
+        self.baud = baud
+        self.multiplexed = multiplexed
+
+    def bits(self, count):
+        """Bus time for count bit slots"""
+        return count * max(self.timing["write1"], self.timing["write0"], self.timing["read"])
+
+    def bytes(self, count):
+        return self.bits(count * 8)
+
+    def select(self):
+        """Reset + MATCH ROM + 8 ROM bytes"""
+        return self.timing["reset"] + self.bytes(9)
+
+    def link(self, command, response_len, bulk=False):
+        """Serial time for a command line and a response of response_len chars"""
+        sent = len(command) + 1
+        if not self.multiplexed:
+            received = response_len + 2
+        elif bulk:
+            frames = max(1, math.ceil((response_len - len("DATA:")) / (MUX_CHUNK_BYTES * 2)))
+            received = response_len + frames * MUX_FRAME_OVERHEAD
+        else:
+            received = response_len + MUX_FRAME_OVERHEAD
+        return (sent + received) * UART_BITS_PER_BYTE * 1e6 / self.baud
+
+    def blocks(self, address, length):
+        """Split a write into the blocks the firmware copies (no page crossing)"""
+        blocks = []
+        offset = 0
+        while offset < length:
+            page_offset = (address + offset) % self.page_size
+            size = min(self.page_size - page_offset, length - offset)
+            blocks.append(size)
+            offset += size
+        return blocks
+
+    def write_bus(self, address, length):
+        """(bus, prog) time to write length bytes at address"""
+        bus = 0
+        prog = 0
+        for size in self.blocks(address, length):
+            if self.full_page_write and size != self.page_size:
+                # Read-modify-write of the whole page
+                bus += self.select() + self.bytes(3 + self.page_size)
+                size = self.page_size
+
+            bus += self.select() + self.bytes(3 + size)  # write scratchpad
+            bus += self.select() + self.bytes(4 + size)  # read scratchpad
+            bus += self.select() + self.bytes(4)         # copy scratchpad
+            bus += self.bytes(1)                         # status read
+            prog += self.prog_us
+        return (bus, prog)
+
+    def operation(self, op, length=0):
+        """
+        Budget for one bridge command
+
+        Args:
+            op: SEARCH, RESET, READ, WRITE or PATCH
+            length: data bytes read or written (for PATCH the patched
+                bytes, as the firmware's STATS count them)
+
+        Returns:
+            dict phase -> microseconds
+        """
+        if op == "SEARCH":
+            # Reset, SEARCH ROM command, 64 x (bit, complement, direction)
+            bus = self.timing["reset"] + self.bytes(1) + self.bits(64 * 3)
+            return {"bus": bus, "prog": 0, "link": self.link("SEARCH", len("ROM:") + 16)}
+
+        if op == "RESET":
+            return {"bus": self.timing["reset"], "prog": 0, "link": self.link("RESET", len("OK"))}
+
+        if op == "READ":
+            bus = self.select() + self.bytes(3 + length)
+            return {"bus": bus, "prog": 0,
+                    "link": self.link(f"READ {length}", len("DATA:") + length * 2, bulk=True)}
+
+        if op == "WRITE":
+            bus, prog = self.write_bus(0, length)
+            return {"bus": bus, "prog": prog,
+                    "link": self.link(f"WRITE {length} " + "00" * length, len("OK"))}
+
+        if op == "PATCH":
+            # One run of length bytes, then the whole image read back
+            bus, prog = self.write_bus(0, length)
+            bus += self.select() + self.bytes(3 + self.memory_size)
+            return {"bus": bus, "prog": prog,
+                    "link": self.link(f"PATCH {self.memory_size} 0000 0:" + "00" * length, len("OK"))}
+
+        raise ValueError(f"Unknown operation: {op}")
+
+def parse_stats(line):
+    """
+    Parse a firmware STATS response
+
+    Returns:
+        dict op -> {"count", "bytes", "total_us", "last_us"}, plus
+        "CONTACT" -> {"score", "delay_us", "width_us", "rise_us"} from
+        firmware v1.3+
+    """
+    if line.startswith("STATS:"):
+        line = line[len("STATS:"):]
+
+    stats = {}
+    for entry in line.split(","):
+        if "=" not in entry:
+            continue
+        op, values = entry.split("=", 1)
+        values = [int(v) for v in values.split("/")]
+        keys = CONTACT_FIELDS if op == "CONTACT" else ("count", "bytes", "total_us", "last_us")
+        stats[op] = dict(zip(keys, values))
+    return stats
+
+def format_contact(contact):
+    """One line on the socket contact behind the timings"""
+    return (f"Contact score {contact['score']}/100: presence {contact['delay_us']} us after the rise "
+            f"(15-60), {contact['width_us']} us wide (60-240), pull-up rise {contact['rise_us']} us")
+
+def compare(budget, device_stats, host_times=None):
+    """
+    Line up model, device and host timings per operation
+
+    Args:
+        budget: CycleBudget
+        device_stats: parse_stats() result
+        host_times: optional dict op -> (mean round trip in us, size argument)
+
+    Returns:
+        list of dicts, one per measured operation, with the model phases,
+        measured device/host time, and the gaps:
+            firmware = device - bus - prog
+            transport = host - device - link
+    """
+    host_times = host_times or {}
+    rows = []
+
+    for op in OPERATIONS:
+        stat = device_stats.get(op)
+        measured = stat is not None and stat["count"] > 0
+        if not measured and op not in host_times:
+            continue
+
+        if measured:
+            device = stat["total_us"] / stat["count"]
+            length = stat["bytes"] // stat["count"]
+        else:
+            device = None
+            length = host_times[op][1]
+
+        model = budget.operation(op, length)
+        row = {"op": op, "length": length, "device": device, "host": None}
+        row.update(model)
+        row["model"] = sum(model[phase] for phase in PHASES)
+
+        if device is not None:
+            row["firmware"] = device - model["bus"] - model["prog"]
+
+        if op in host_times:
+            row["host"] = host_times[op][0]
+            base = device if device is not None else model["bus"] + model["prog"]
+            row["transport"] = row["host"] - base - model["link"]
+
+        rows.append(row)
+
+    # Programming waits measured by the firmware, against the maximum it waits
+    prog = device_stats.get("PROG")
+    if prog and prog["count"]:
+        measured = prog["total_us"] / prog["count"]
+        rows.append({"op": "PROG", "length": 0, "bus": 0, "prog": budget.prog_us, "link": 0,
+                     "model": budget.prog_us, "device": measured, "host": None,
+                     "firmware": measured - budget.prog_us})
+
+    return rows
+
+def biggest_gap(rows):
+    """Return (op, gap name, microseconds) of the largest gap, or None"""
+    gaps = [(row["op"], name, row[name]) for row in rows
+            for name in ("firmware", "transport") if row.get(name) is not None]
+    return max(gaps, key=lambda gap: gap[2]) if gaps else None
+
+def format_report(rows):
+    def ms(value):
+        return "-" if value is None else f"{value / 1000:.2f}"
+
+    lines = [f"{'op':<7}{'bytes':>6}{'bus':>9}{'prog':>9}{'link':>9}{'model':>9}"
+             f"{'device':>9}{'host':>9}{'fw gap':>9}{'xfer gap':>9}   (ms)"]
+    for row in rows:
+        lines.append(f"{row['op']:<7}{row['length']:>6}{ms(row['bus']):>9}{ms(row['prog']):>9}"
+                     f"{ms(row['link']):>9}{ms(row['model']):>9}{ms(row['device']):>9}{ms(row['host']):>9}"
+                     f"{ms(row.get('firmware')):>9}{ms(row.get('transport')):>9}")
+
+    gap = biggest_gap(rows)
+    if gap:
+        op, name, value = gap
+        lines.append("")
+        lines.append(f"Largest gap: {op} {name} ({value / 1000:.2f} ms over the model)")
+    if any(row.get("firmware") is not None for row in rows):
+        lines.append("fw gap includes time the bridge spent blocked on its serial TX buffer")
+    return "\n".join(lines)
+
+def benchmark(bridge, iterations, write=False):
+    """
+    Time bridge commands from the host
+
+    Returns:
+        (device STATS dict, host_times dict)
+    """
+    def timed(op, command, length):
+        start = time.perf_counter()
+        response = bridge._send_command(command)
+        elapsed = (time.perf_counter() - start) * 1e6
+        if response.startswith("ERROR") or not response:
+            raise Exception(f"{op} failed: {response[:100]}")
+        totals.setdefault(op, []).append(elapsed)
+        lengths[op] = length
+        return response
+
+    totals = {}
+    lengths = {}
+
+    bridge._send_command("STATS RESET")
+    image = None
+    for _ in range(iterations):
+        timed("RESET", "RESET", 0)
+        timed("SEARCH", "SEARCH", 0)
+        response = timed("READ", "READ 512", 512)
+        image = response[5:].strip()
+
+    if write and image:
+        # Rewrites the same image; sent as a full WRITE to bypass patching
+        for _ in range(iterations):
+            timed("WRITE", f"WRITE {len(image) // 2} {image}", len(image) // 2)
+
+    stats = parse_stats(bridge._send_command("STATS"))
+    host_times = {op: (sum(values) / len(values), lengths[op]) for op, values in totals.items()}
+    return (stats, host_times)
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare bridge timings with a first-principles budget")
+    parser.add_argument("--port", help="Bridge serial port to benchmark")
+    parser.add_argument("--stats", help="STATS line captured from the firmware")
+    parser.add_argument("--family", default="DS2433", choices=sorted(FAMILIES))
+    parser.add_argument("--overdrive", action="store_true", help="Model overdrive 1-Wire speed")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--plain", action="store_true", help="Model the plain protocol (no channel framing)")
+    parser.add_argument("--iterations", type=int, default=5)
+    parser.add_argument("--write", action="store_true",
+                        help="Also time WRITE by rewriting the cartridge with its own image")
+    args = parser.parse_args()
+
+    multiplexed = not args.plain
+    device_stats = {}
+    host_times = {}
+
+    if args.port:
+        from stratatools.helper.esp32_bridge import ESP32Bridge
+
+        bridge = ESP32Bridge(args.port, multiplex=multiplexed)
+        if not bridge.initialize():
+            print("ERROR: Failed to initialize ESP32 bridge")
+            sys.exit(1)
+        multiplexed = bridge.multiplexed
+
+        try:
+            device_stats, host_times = benchmark(bridge, args.iterations, args.write)
+        except Exception as e:
+            print(f"ERROR: {e}")
+            sys.exit(1)
+        finally:
+            bridge.close()
+    elif args.stats:
+        device_stats = parse_stats(args.stats)
+
+    budget = CycleBudget(args.family, "overdrive" if args.overdrive else "standard", args.baud, multiplexed)
+
+    if not device_stats and not host_times:
+        # Model only: a typical refill cycle
+        host_times = {"SEARCH": (None, 0), "READ": (None, 512), "WRITE": (None, 512), "PATCH": (None, 16)}
+        rows = []
+        for op, (_, length) in host_times.items():
+            model = budget.operation(op, length)
+            row = {"op": op, "length": length, "device": None, "host": None}
+            row.update(model)
+            row["model"] = sum(model.values())
+            rows.append(row)
+    else:
+        rows = compare(budget, device_stats, host_times)
+
+    print(format_report(rows))
+    if "CONTACT" in device_stats:
+        print(format_contact(device_stats["CONTACT"]))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,61 @@
+import unittest
+
+from stratatools.helper.cycle_budget import CycleBudget, parse_stats, compare, biggest_gap, format_report
+
+STATS = "STATS:SEARCH=2/0/40000/20000,RESET=0/0/0/0,READ=2/1024/600000/300000,WRITE=0/0/0/0,PATCH=0/0/0/0,PROG=32/0/160000/5000"
+
+class TestCycleBudget(unittest.TestCase):
+    def test_read_budget(self):
+        budget = CycleBudget("DS2433", "standard", 115200, multiplexed=False)
+        read = budget.operation("READ", 512)
+
+        # Reset + MATCH ROM + 8 ROM bytes + command + address + 512 data bytes
+        assert read["bus"] == 960 + (9 + 3 + 512) * 8 * 70
+        # "READ 512\n" out, "DATA:" + 1024 hex + CRLF back, 10 bits a byte
+        assert abs(read["link"] - (9 + 5 + 1024 + 2) * 10 * 1e6 / 115200) < 1e-6
+        assert read["prog"] == 0
+
+    def test_overdrive_is_faster(self):
+        standard = CycleBudget(speed="standard").operation("READ", 512)["bus"]
+        overdrive = CycleBudget(speed="overdrive").operation("READ", 512)["bus"]
+        assert overdrive * 6 < standard
+
+    def test_write_pages(self):
+        budget = CycleBudget("DS2433")
+        assert budget.blocks(0x58, 16) == [8, 8]
+        # The firmware waits the maximum tPROG (5 ms), not the typical 3 ms
+        assert budget.operation("WRITE", 512)["prog"] == 16 * 5000
+
+        # DS2431 rewrites whole 8-byte pages
+        partial = CycleBudget("DS2431").write_bus(1, 2)[0]
+        full = CycleBudget("DS2431").write_bus(0, 8)[0]
+        assert partial > full
+
+    def test_patch_reads_back_image(self):
+        # STATS counts the patched bytes; the verify still reads the whole image
+        budget = CycleBudget("DS2433")
+        patch = budget.operation("PATCH", 16)
+        write_bus = budget.write_bus(0, 16)[0]
+        assert patch["bus"] == write_bus + budget.select() + budget.bytes(3 + 512)
+
+    def test_parse_stats(self):
+        stats = parse_stats(STATS)
+        assert stats["READ"] == {"count": 2, "bytes": 1024, "total_us": 600000, "last_us": 300000}
+        assert stats["PROG"]["count"] == 32
+
+    def test_parse_contact(self):
+        stats = parse_stats(STATS + ",CONTACT=72/31/118/6")
+        assert stats["CONTACT"] == {"score": 72, "delay_us": 31, "width_us": 118, "rise_us": 6}
+        assert [row["op"] for row in compare(CycleBudget(), stats)] == ["SEARCH", "READ", "PROG"]
+
+    def test_compare(self):
+        budget = CycleBudget("DS2433", multiplexed=False)
+        rows = compare(budget, parse_stats(STATS), {"READ": (390000, 512)})
+        read = next(row for row in rows if row["op"] == "READ")
+
+        assert read["device"] == 300000
+        assert read["firmware"] == 300000 - read["bus"]
+        assert read["transport"] == 390000 - 300000 - read["link"]
+        assert [row["op"] for row in rows] == ["SEARCH", "READ", "PROG"]
+        assert biggest_gap(rows)[:2] == ("READ", "firmware")
+        assert "serial TX buffer" in format_report(rows)
@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Per-Cycle Timeline of Refill Stations
+
+Every read or refill cycle is split into host-side phases:
+
+    detect   bus reset and ROM search
+    read     EEPROM reads (quantity block, metadata, full image)
+    decode   decryption and checksums
+    encode   encryption of the new image
+    write    the EEPROM write
+    verify   read-back and compare
+
+CycleTimeline keeps the last cycles of each station (a bridge port, or
+"<port>#<n>" for a socket of a multi-socket station) with rolling
+percentiles per phase. Bridges with firmware v1.4+ also report every
+command they timed (TRACE), so the device time of each READ or WRITE
+sits next to the host phase it belongs to. A station whose percentiles
+stand out from the others points at its socket, cable or cartridges.
+
+The refill daemon records its own cycles and serves them on the control
+socket ("timeline" op); the GUI records the cycles it runs and shows both.
+"""
+
+import collections
+import contextlib
+import threading
+import time
+
+PHASES = ("detect", "read", "decode", "encode", "write", "verify")
+
+PERCENTILES = (50, 90, 99)
+
+# Cycles and bridge commands kept per station
+WINDOW = 50
+TRACE_WINDOW = 200
+
+def percentile(values, pct):
+    """Nearest-rank percentile of values, None if there are none"""
+    if not values:
+        return None
+    ordered = sorted(values)
+    rank = max(1, -(-len(ordered) * pct // 100))
+    return ordered[min(rank, len(ordered)) - 1]
+
+def parse_trace(line):
+    """
+    Parse a firmware TRACE response
+
+    TRACE:<last_seq>:<seq>=<op>/<start_ms>/<elapsed_us>/<bytes>,...
+
+    Returns:
+        (last_seq, [{"seq", "op", "start_ms", "elapsed_us", "bytes"}, ...])
+    """
+    if line.startswith("TRACE:"):
+        line = line[len("TRACE:"):]
+
+    last_seq, _, entries = line.partition(":")
+    trace = []
+    for entry in entries.split(","):
+        if "=" not in entry:
+            continue
+        seq, values = entry.split("=", 1)
+        op, start_ms, elapsed_us, size = values.split("/")
+        trace.append({"seq": int(seq), "op": op, "start_ms": int(start_ms),
+                      "elapsed_us": int(elapsed_us), "bytes": int(size)})
+    return (int(last_seq), trace)
+
+class Cycle:
+    """One read or refill cycle on a station"""
+
+    def __init__(self, station, label=None, started=None):
+        self.station = station
+        self.label = label
+        self.started = time.time() if started is None else started
+        self.result = None
+        # (phase, seconds from the start, seconds) in the order they ran
+        self.phases = []
+        self._clock = time.perf_counter()
+
+    @contextlib.contextmanager
+    def phase(self, name):
+        """Time the body of a with statement as one phase"""
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            self.phases.append((name, start - self._clock, time.perf_counter() - start))
+
+    def durations(self):
+        """Seconds spent in each phase (a phase can run more than once)"""
+        totals = {}
+        for name, _, seconds in self.phases:
+            totals[name] = totals.get(name, 0.0) + seconds
+        return totals
+
+    def elapsed(self):
+        """Seconds from the start of the first phase to the end of the last"""
+        return max((offset + seconds for _, offset, seconds in self.phases), default=0.0)
+
+    def to_dict(self):
+        return {"station": self.station, "label": self.label, "started": self.started,
+                "result": self.result, "phases": [list(p) for p in self.phases]}
+
+    @classmethod
+    def from_dict(cls, d):
+        cycle = cls(d["station"], d.get("label"), d["started"])
+        cycle.result = d.get("result")
+        cycle.phases = [tuple(p) for p in d["phases"]]
+        return cycle
+
+class CycleTimeline:
+    """Recent cycles, bridge traces and STATS of every station"""
+
+    def __init__(self, window=WINDOW):
+        self.window = window
+        self.lock = threading.Lock()
+        self.cycles = {}
+        self.traces = {}
+        self.trace_seq = {}
+        self.stats = {}
+
+    def stations(self):
+        with self.lock:
+            return sorted(set(self.cycles) | set(self.traces) | set(self.stats))
+
+    @contextlib.contextmanager
+    def cycle(self, station, label=None):
+        """
+        Record the body of a with statement as one cycle
+
+            with timeline.cycle(port, rom) as cycle:
+                with cycle.phase("read"):
+                    ...
+
+        The result is "OK" unless the body raises (or sets cycle.result).
+        """
+        cycle = Cycle(station, label)
+        try:
+            yield cycle
+        except Exception as e:
+            cycle.result = cycle.result or f"ERROR:{e}"
+            raise
+        finally:
+            cycle.result = cycle.result or "OK"
+            self.add(cycle)
+
+    def add(self, cycle):
+        with self.lock:
+            cycles = self.cycles.setdefault(cycle.station, collections.deque(maxlen=self.window))
+            cycles.append(cycle)
+
+    def recent(self, station, count=None):
+        """Cycles of a station, oldest first"""
+        with self.lock:
+            cycles = list(self.cycles.get(station, ()))
+        return cycles[-count:] if count else cycles
+
+    def add_trace(self, station, last_seq, entries):
+        """Keep bridge commands not seen yet (a restarted bridge starts over)"""
+        with self.lock:
+            trace = self.traces.setdefault(station, collections.deque(maxlen=TRACE_WINDOW))
+            if last_seq < self.trace_seq.get(station, 0):
+                trace.clear()
+            seen = trace[-1]["seq"] if trace else 0
+            trace.extend(entry for entry in entries if entry["seq"] > seen)
+            self.trace_seq[station] = last_seq
+
+    def trace(self, station):
+        with self.lock:
+            return list(self.traces.get(station, ()))
+
+    def pull(self, station, bridge):
+        """
+        Fetch STATS and new TRACE entries from a bridge
+
+        Bridges without them (older firmware, multi-station sockets)
+        return None and are skipped.
+        """
+        stats = bridge.stats()
+        if stats:
+            with self.lock:
+                self.stats[station] = stats
+
+        result = bridge.trace(self.trace_seq.get(station, 0))
+        if result:
+            self.add_trace(station, *result)
+
+    def summary(self, station):
+        """
+        Rolling percentiles of a station
+
+        Returns:
+            dict name -> {"count", "last", "p50", "p90", "p99"} in seconds,
+            host phases (lowercase) first, then bridge commands from the
+            trace (uppercase)
+        """
+        samples = collections.OrderedDict((name, []) for name in PHASES)
+        for cycle in self.recent(station):
+            for name, seconds in cycle.durations().items():
+                samples.setdefault(name, []).append(seconds)
+        for entry in self.trace(station):
+            samples.setdefault(entry["op"], []).append(entry["elapsed_us"] / 1e6)
+
+        summary = collections.OrderedDict()
+        for name, values in samples.items():
+            if not values:
+                continue
+            row = {"count": len(values), "last": values[-1]}
+            for pct in PERCENTILES:
+                row[f"p{pct}"] = percentile(values, pct)
+            summary[name] = row
+        return summary
+
+    def to_dict(self):
+        with self.lock:
+            return {station: {"cycles": [c.to_dict() for c in self.cycles.get(station, ())],
+                              "trace": list(self.traces.get(station, ())),
+                              "stats": self.stats.get(station)}
+                    for station in set(self.cycles) | set(self.traces) | set(self.stats)}
+
+    def merge(self, d):
+        """Replace the stations in a to_dict() result (from the daemon)"""
+        with self.lock:
+            for station, entry in d.items():
+                self.cycles[station] = collections.deque(
+                    (Cycle.from_dict(c) for c in entry["cycles"]), maxlen=self.window)
+                self.traces[station] = collections.deque(entry["trace"], maxlen=TRACE_WINDOW)
+                self.trace_seq[station] = entry["trace"][-1]["seq"] if entry["trace"] else 0
+                if entry.get("stats"):
+                    self.stats[station] = entry["stats"]
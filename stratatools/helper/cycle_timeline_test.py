@@ -0,0 +1,86 @@
+import json
+import unittest
+
+from stratatools.helper.cycle_timeline import CycleTimeline, Cycle, percentile, parse_trace
+
+TRACE = "TRACE:7:5=READ/1200/310000/512,6=WRITE/1530/820000/512,7=READ/2400/305000/512"
+
+class FakeBridge:
+    def __init__(self, traces):
+        self.traces = traces
+        self.since = []
+
+    def stats(self):
+        return {"READ": {"count": 2, "bytes": 1024, "total_us": 615000, "last_us": 305000}}
+
+    def trace(self, since=0):
+        self.since.append(since)
+        return parse_trace(self.traces.pop(0)) if self.traces else None
+
+class TestCycleTimeline(unittest.TestCase):
+    def test_percentile(self):
+        values = list(range(1, 101))
+        assert percentile(values, 50) == 50
+        assert percentile(values, 99) == 99
+        assert percentile([3.0], 90) == 3.0
+        assert percentile([], 50) is None
+
+    def test_parse_trace(self):
+        last_seq, entries = parse_trace(TRACE)
+        assert last_seq == 7
+        assert entries[1] == {"seq": 6, "op": "WRITE", "start_ms": 1530, "elapsed_us": 820000, "bytes": 512}
+        assert parse_trace("TRACE:0:") == (0, [])
+
+    def test_cycles_and_summary(self):
+        timeline = CycleTimeline(window=3)
+        for n in range(4):
+            cycle = Cycle("/dev/ttyUSB0", f"rom{n}")
+            cycle.phases = [("detect", 0.0, 0.01), ("read", 0.01, 0.1 * (n + 1)), ("read", 0.5, 0.1)]
+            timeline.add(cycle)
+
+        with self.assertRaises(ValueError):
+            with timeline.cycle("/dev/ttyUSB1", "rom") as cycle:
+                with cycle.phase("decode"):
+                    raise ValueError("invalid content checksum")
+
+        # Oldest cycle dropped; repeated phases add up
+        assert [c.label for c in timeline.recent("/dev/ttyUSB0")] == ["rom1", "rom2", "rom3"]
+        summary = timeline.summary("/dev/ttyUSB0")
+        assert list(summary) == ["detect", "read"]
+        assert summary["read"]["count"] == 3
+        assert abs(summary["read"]["p50"] - 0.4) < 1e-9
+        assert abs(summary["read"]["last"] - 0.5) < 1e-9
+
+        failed = timeline.recent("/dev/ttyUSB1")[0]
+        assert failed.result == "ERROR:invalid content checksum"
+        assert failed.phases[0][0] == "decode"
+
+    def test_pull_trace(self):
+        bridge = FakeBridge([TRACE, "TRACE:8:6=WRITE/1530/820000/512,7=READ/2400/305000/512,8=SEARCH/3000/12000/0",
+                             "TRACE:2:1=RESET/10/1000/0,2=SEARCH/20/12000/0"])
+        timeline = CycleTimeline()
+
+        timeline.pull("port", bridge)
+        timeline.pull("port", bridge)
+        assert [e["seq"] for e in timeline.trace("port")] == [5, 6, 7, 8]
+        assert bridge.since == [0, 7]
+        assert timeline.summary("port")["READ"]["count"] == 2
+        assert timeline.stats["port"]["READ"]["count"] == 2
+
+        # Bridge restarted: its sequence numbers start over
+        timeline.pull("port", bridge)
+        assert [e["op"] for e in timeline.trace("port")] == ["RESET", "SEARCH"]
+
+    def test_round_trip(self):
+        timeline = CycleTimeline()
+        with timeline.cycle("/dev/ttyACM0#3", "2362474d0100006b") as cycle:
+            with cycle.phase("write"):
+                pass
+        timeline.add_trace("/dev/ttyACM0#3", *parse_trace(TRACE))
+
+        copy = CycleTimeline()
+        copy.merge(json.loads(json.dumps(timeline.to_dict())))
+        cycle = copy.recent("/dev/ttyACM0#3")[0]
+        assert (cycle.label, cycle.result, cycle.phases[0][0]) == ("2362474d0100006b", "OK", "write")
+        assert copy.trace_seq["/dev/ttyACM0#3"] == 7
+        assert copy.stations() == ["/dev/ttyACM0#3"]
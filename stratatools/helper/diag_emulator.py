@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Diagnostic Console Emulator
+
+Local pty stand-in for a printer diagnostic console, so DiagPortBridge
+and the in-place refill can be exercised without a printer.
+
+It understands the same 'er' (memory dump) and 'ew' (write) commands as
+diag_port.py and keeps one 512-byte EEPROM image per bay.
+
+Usage:
+    python3 -m stratatools.helper.diag_emulator [image.bin]
+"""
+
+import os
+import shlex
+import sys
+import threading
+import time
+import tty
+
+from stratatools.helper.diag_port import DIAG_ERROR_PREFIX, DIAG_PROMPT
+
+EEPROM_SIZE = 512
+
+class DiagConsoleEmulator:
+    """Emulated diagnostic console on a pseudo-terminal"""
+
+    def __init__(self, images=None, write_delay=0.0):
+        """
+        Args:
+            images: dict of bay -> initial EEPROM image
+            write_delay: Seconds to stall each 'ew' (emulates programming time)
+        """
+        self.images = {}
+        for bay, image in (images or {}).items():
+            self.images[bay] = bytearray(image).ljust(EEPROM_SIZE, b"\x00")
+        self.write_delay = write_delay
+        self.commands = []
+
+        self.master, self.slave = os.openpty()
+        tty.setraw(self.slave)
+        self.port = os.ttyname(self.slave)
+        self.thread = None
+        self.running = False
+
+    def start(self):
+        self.running = True
+        self.thread = threading.Thread(target=self._serve, daemon=True)
+        self.thread.start()
+        return self
+
+    def stop(self):
+        self.running = False
+        os.close(self.master)
+        os.close(self.slave)
+
+    def _image(self, bay):
+        return self.images.setdefault(bay, bytearray(EEPROM_SIZE))
+
+    def _serve(self):
+        pending = b""
+        while self.running:
+            try:
+                data = os.read(self.master, 4096)
+            except OSError:
+                break
+            pending += data
+            while b"\n" in pending:
+                line, pending = pending.split(b"\n", 1)
+                output = self._handle(line.decode('ascii', errors='ignore').strip())
+                # The prompt starts a line of its own
+                if not output.endswith("\n"):
+                    output += "\r\n"
+                os.write(self.master, output.encode() + DIAG_PROMPT)
+
+    def _handle(self, line):
+        if not line:
+            return ""
+
+        self.commands.append(line)
+        args = shlex.split(line)
+
+        try:
+            if args[0] == "er":
+                bay, address, length = int(args[1]), int(args[2]), int(args[3])
+                return self._dump(self._image(bay), address, length)
+
+            if args[0] == "ew":
+                bay, address = int(args[1]), int(args[2])
+                data = bytes.fromhex(args[3].replace(" ", ""))
+                if address + len(data) > EEPROM_SIZE:
+                    return f"{DIAG_ERROR_PREFIX} address out of range\r\n"
+                time.sleep(self.write_delay)
+                self._image(bay)[address:address + len(data)] = data
+                return ""
+        except (IndexError, ValueError):
+            return f"{DIAG_ERROR_PREFIX} bad arguments\r\n"
+
+        return f"{DIAG_ERROR_PREFIX} unknown command\r\n"
+
+    def _dump(self, image, address, length):
+        lines = []
+        for offset in range(address, min(address + length, EEPROM_SIZE), 16):
+            chunk = image[offset:min(offset + 16, address + length)]
+            hex_part = " ".join("%02x" % b for b in chunk)
+            ascii_part = "".join(chr(b) if 32 <= b < 127 else "." for b in chunk)
+            lines.append("%06d: %s   %s\r\n" % (offset, hex_part, ascii_part))
+        return "".join(lines)
+
+def main():
+    images = {}
+    if len(sys.argv) > 1:
+        with open(sys.argv[1], "rb") as f:
+            images[0] = f.read()
+
+    emulator = DiagConsoleEmulator(images).start()
+    print(f"Diagnostic console emulator on {emulator.port} (^c to quit)")
+
+    try:
+        while True:
+            time.sleep(0.1)
+    except KeyboardInterrupt:
+        pass
+
+    emulator.stop()
+
+if __name__ == "__main__":
+    main()
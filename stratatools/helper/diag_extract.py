@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Extract Cartridge Images from a Diagnostic-Port Capture
+
+Scans a capture of a printer's diagnostic console (a log of the serial
+session, any size) for memory dumps and lists every image found with its
+address. With an output directory each image is saved as
+<n>-<address>.bin. The capture is read in chunks, so memory use doesn't
+grow with its size.
+
+Usage:
+    stratatools_diag_extract capture.log
+    stratatools_diag_extract capture.log images/ --min-size 113
+    stratatools_diag_extract --benchmark 256
+"""
+
+import argparse
+import os
+import sys
+import tempfile
+import time
+
+from stratatools import diag_scanner
+from stratatools.formatter import DiagnosticPort_Formatter
+
+# Smallest cartridge record (see manager.py)
+CARTRIDGE_RECORD_SIZE = 0x71
+
+def write_capture(f, size):
+    """
+    Write a synthetic capture of about size bytes: 512-byte dumps from
+    four bays between prompts, commands and printer messages
+    """
+    image = bytes(range(256)) * 2
+    written = 0
+    n = 0
+    while written < size:
+        lines = [f"> er {n % 4} 0 512\r\n"]
+        for offset in range(0, len(image), 16):
+            chunk = image[offset:offset + 16]
+            hex_part = " ".join("%02x" % b for b in chunk)
+            ascii_part = "".join(chr(b) if 32 <= b < 127 else "." for b in chunk)
+            lines.append("%06d: %s   %s\r\n" % (offset, hex_part, ascii_part))
+        lines.append(f"temp: chamber 75.0C head 320.0C ({n})\r\n")
+        block = "".join(lines).encode()
+        f.write(block)
+        written += len(block)
+        n += 1
+    return n
+
+def peak_rss_mb():
+    try:
+        import resource
+    except ImportError:
+        return float("nan")  # Windows
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # kilobytes on Linux, bytes on macOS
+    return peak / (1 << 20) if sys.platform == "darwin" else peak / 1024
+
+def benchmark(size_mb):
+    """Time the scanners on a synthetic capture of size_mb megabytes"""
+    with tempfile.TemporaryFile() as f:
+        print(f"Writing a {size_mb} MB capture...")
+        dumps = write_capture(f, size_mb << 20)
+        size = f.tell()
+
+        modes = [("python", False)]
+        if diag_scanner.NATIVE:
+            modes.insert(0, ("native", True))
+        else:
+            print("Native scanner not built (pip install . with a C++ compiler)")
+
+        print(f"{'scanner':<8} {'images':>8} {'seconds':>9} {'MB/s':>8} {'peak RSS MB':>12}")
+        for name, native in modes:
+            f.seek(0)
+            start = time.perf_counter()
+            images = sum(1 for _ in diag_scanner.scan(f, native=native))
+            seconds = time.perf_counter() - start
+            print(f"{name:<8} {images:>8} {seconds:>9.2f} {size / seconds / (1 << 20):>8.1f} {peak_rss_mb():>12.1f}")
+            if images != dumps:
+                print(f"ERROR: expected {dumps} images")
+
+        # Whole-capture API, on a slice: it holds the capture and its output
+        f.seek(0)
+        sample = f.read(min(size, 8 << 20))
+        start = time.perf_counter()
+        DiagnosticPort_Formatter().from_source(sample)
+        seconds = time.perf_counter() - start
+        print(f"from_source on {len(sample) >> 20} MB: {seconds:.2f} s")
+
+def main():
+    parser = argparse.ArgumentParser(description="Extract cartridge images from a diagnostic-port capture")
+    parser.add_argument("capture", nargs="?", help="Capture file")
+    parser.add_argument("directory", nargs="?", help="Where to save the images (default: only list them)")
+    parser.add_argument("--min-size", type=int, default=CARTRIDGE_RECORD_SIZE,
+                        help=f"Skip shorter dumps (default: {CARTRIDGE_RECORD_SIZE}, one cartridge record)")
+    parser.add_argument("--benchmark", type=int, metavar="MB",
+                        help="Time the scanner on a synthetic capture of this size instead")
+    args = parser.parse_args()
+
+    if args.benchmark:
+        benchmark(args.benchmark)
+        sys.exit(0)
+
+    if not args.capture:
+        parser.error("a capture file is required")
+
+    if args.directory:
+        os.makedirs(args.directory, exist_ok=True)
+
+    count = 0
+    try:
+        with open(args.capture, "rb") as f:
+            for address, image in diag_scanner.scan(f):
+                if len(image) < args.min_size:
+                    continue
+                count += 1
+                line = f"{count}: address {address}, {len(image)} bytes"
+                if args.directory:
+                    path = os.path.join(args.directory, f"{count}-{address}.bin")
+                    with open(path, "wb") as out:
+                        out.write(image)
+                    line += f" -> {path}"
+                print(line)
+    except OSError as e:
+        print(f"ERROR: {e}")
+        sys.exit(1)
+
+    print(f"{count} image(s) found")
+    sys.exit(0)
+
+if __name__ == "__main__":
+    main()
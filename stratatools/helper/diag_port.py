@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Printer Diagnostic Port Interface
+
+This module talks to the diagnostic serial console of a uPrint-class
+printer to read and rewrite the cartridge EEPROM in place, without
+pulling the cartridge out of the machine.
+
+Reads use the console's memory dump (parsed by DiagnosticPort_Formatter)
+and writes use the 'ew' command with the quoted hex string produced by
+DiagnosticPort_Formatter.to_destination().
+
+The command syntax, prompt and error prefix below are what uPrint-class
+consoles are expected to use; they have not been checked against every
+printer generation, so DiagPortBridge (and stratatools_diag_refill) take
+each of them as an option.
+"""
+
+import serial
+import time
+
+from stratatools.formatter import DiagnosticPort_Formatter
+
+# Console prompt printed at the start of a line after every command
+DIAG_PROMPT = b"> "
+
+# Command templates - {bay} is the cartridge bay, {address}/{length} in bytes,
+# {data} is the quoted hex string accepted by 'ew'
+DIAG_READ_COMMAND = "er {bay} {address} {length}"
+DIAG_WRITE_COMMAND = "ew {bay} {address} {data}"
+
+# Start of the line the console prints when a command fails
+DIAG_ERROR_PREFIX = "error:"
+
+class DiagPortBridge:
+    """
+    Interface to a printer diagnostic console
+
+    Writes are split into chunk_size byte 'ew' commands and sent in
+    batches of window commands before waiting for their prompts, so the
+    console's turnaround is paid once per batch instead of per command.
+    """
+
+    def __init__(self, port, baudrate=38400, timeout=5, bay=0,
+                 prompt=DIAG_PROMPT, chunk_size=32, window=4,
+                 read_command=DIAG_READ_COMMAND, write_command=DIAG_WRITE_COMMAND,
+                 error_prefix=DIAG_ERROR_PREFIX):
+        """
+        Open the diagnostic console
+
+        Args:
+            port: Serial port device path
+            baudrate: Console speed
+            timeout: Read timeout in seconds
+            bay: Cartridge bay to address
+            prompt: Console prompt (bytes)
+            chunk_size: Bytes per 'ew' command
+            window: 'ew' commands sent before waiting for prompts
+            read_command: Dump command template (see DIAG_READ_COMMAND)
+            write_command: Write command template (see DIAG_WRITE_COMMAND)
+            error_prefix: Start of a console error line
+        """
+        self.serial = serial.Serial(port, baudrate, timeout=timeout)
+        self.bay = bay
+        self.prompt = prompt
+        self.chunk_size = chunk_size
+        self.window = window
+        self.read_command = read_command
+        self.write_command = write_command
+        self.error_prefix = error_prefix.lower()
+        self.formatter = DiagnosticPort_Formatter()
+
+    def _read_prompt(self, bare=False):
+        """
+        Read console output up to the next prompt
+
+        The prompt only counts at the start of a line: a dump's ASCII
+        column prints bytes 3e 20 as the prompt. bare accepts it anywhere,
+        for synchronising when the console state is unknown.
+        """
+        marker = self.prompt if bare else b"\n" + self.prompt
+        output = self.serial.read_until(marker)
+        if not output.endswith(marker):
+            raise Exception("timeout waiting for diagnostic console prompt")
+        return output[:-len(marker)].decode('ascii', errors='ignore')
+
+    def _check(self, output):
+        # Only a line that starts with the prefix: a dump's ASCII column may
+        # spell "error" anywhere
+        for line in output.splitlines():
+            if line.strip().lower().startswith(self.error_prefix):
+                raise Exception("diagnostic console: " + line.strip()[:100])
+        return output
+
+    def _command(self, command):
+        """Send one command and return its output"""
+        self.serial.write((command + "\r\n").encode())
+        return self._check(self._read_prompt())
+
+    def initialize(self):
+        """
+        Synchronise with the console prompt
+
+        Returns:
+            True if the console answered
+        """
+        self.serial.reset_input_buffer()
+        try:
+            self.serial.write(b"\r\n")
+            self._check(self._read_prompt(bare=True))
+            return True
+        except Exception:
+            return False
+
+    def read(self, address, length):
+        """
+        Read EEPROM memory with a single dump command
+
+        Returns:
+            bytes of the requested length
+        """
+        output = self._command(self.read_command.format(bay=self.bay, address=address, length=length))
+        data = self.formatter.from_source(output)
+
+        if len(data) < length:
+            raise Exception(f"short read from diagnostic console: {len(data)} of {length} bytes")
+
+        return data[:length]
+
+    def write(self, address, data):
+        """Write EEPROM memory using batched 'ew' commands"""
+        commands = []
+        for offset in range(0, len(data), self.chunk_size):
+            chunk = data[offset:offset + self.chunk_size]
+            commands.append(self.write_command.format(
+                bay=self.bay,
+                address=address + offset,
+                data=self.formatter.to_destination(chunk)))
+
+        for i in range(0, len(commands), self.window):
+            batch = commands[i:i + self.window]
+            self.serial.write("".join(c + "\r\n" for c in batch).encode())
+            for _ in batch:
+                self._check(self._read_prompt())
+
+    def write_verified(self, address, data):
+        """
+        Write then read back and compare
+
+        Returns:
+            dict of phase durations in seconds (write, verify, total)
+        """
+        start = time.monotonic()
+        self.write(address, data)
+        written = time.monotonic()
+
+        if self.read(address, len(data)) != bytes(data):
+            raise Exception("verification failed - data mismatch")
+
+        done = time.monotonic()
+        return {
+            "write": written - start,
+            "verify": done - written,
+            "total": done - start,
+        }
+
+    def close(self):
+        """Close the serial connection"""
+        if self.serial and self.serial.is_open:
+            self.serial.close()
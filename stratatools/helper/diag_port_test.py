@@ -0,0 +1,56 @@
+import unittest
+
+from stratatools.helper.diag_emulator import DiagConsoleEmulator
+from stratatools.helper.diag_port import DiagPortBridge
+
+IMAGE = bytes(range(256)) * 2
+
+class TestDiagPort(unittest.TestCase):
+    def setUp(self):
+        self.emulator = DiagConsoleEmulator({0: IMAGE}).start()
+        self.bridge = DiagPortBridge(self.emulator.port, timeout=2)
+
+    def tearDown(self):
+        self.bridge.close()
+        self.emulator.stop()
+
+    def test_read(self):
+        assert self.bridge.initialize()
+        assert self.bridge.read(0, 0x71) == IMAGE[:0x71]
+
+    def test_write_verified(self):
+        data = bytes(b ^ 0xff for b in IMAGE[:0x71])
+
+        assert self.bridge.initialize()
+        timings = self.bridge.write_verified(0, data)
+
+        assert self.emulator.images[0][:0x71] == data
+        assert timings["total"] >= timings["write"]
+        # 0x71 bytes in 32-byte chunks
+        assert len([c for c in self.emulator.commands if c.startswith("ew")]) == 4
+
+    def test_error_text_in_dump(self):
+        # "error" in the dump's ASCII column is data, not a failure
+        self.emulator.images[0][0:16] = b"ERROR: not one.."
+        assert self.bridge.initialize()
+        assert self.bridge.read(0, 16) == b"ERROR: not one.."
+
+    def test_console_error(self):
+        assert self.bridge.initialize()
+        with self.assertRaises(Exception):
+            self.bridge.write(510, b"\x00" * 4)
+
+    def test_prompt_bytes_in_dump(self):
+        # 3e 20 prints as "> " in the ASCII column, mid-line
+        image = bytearray(IMAGE[:0x71])
+        image[5:7] = b"\x3e\x20"
+        image[0x50:0x52] = b"\x3e\x20"
+        self.emulator.images[0][:0x71] = image
+
+        assert self.bridge.initialize()
+        assert self.bridge.read(0, 0x71) == bytes(image)
+
+        # Later commands still pair with their own output
+        data = bytes(b ^ 0xff for b in image)
+        self.bridge.write_verified(0, data)
+        assert self.bridge.read(0, 0x71) == data
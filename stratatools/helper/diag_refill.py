@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Refill a cartridge in place through the printer diagnostic port
+
+Reads the cartridge image over the diagnostic console, refills it,
+writes it back with batched 'ew' commands and verifies the result.
+
+Usage:
+    stratatools_diag_refill -t uprint -e 11010a01ba325d23 /dev/ttyUSB0
+"""
+
+import argparse
+import sys
+import time
+
+from stratatools import cartridge, checksum, crypto, machine, manager
+from stratatools.helper.diag_port import (DIAG_ERROR_PREFIX, DIAG_PROMPT, DIAG_READ_COMMAND,
+                                          DIAG_WRITE_COMMAND, DiagPortBridge)
+
+def main():
+    parser = argparse.ArgumentParser(description="In-place refill through the printer diagnostic port")
+    parser.add_argument("-t", "--machine-type", action="store", choices=machine.get_machine_types(), required=True)
+    parser.add_argument("-e", "--eeprom-uid", action="store", dest="eeprom_uid", required=True, help="Format: [a-f0-9]{14}23, example: 11010a01ba325d23")
+    parser.add_argument("-b", "--bay", action="store", type=int, default=0, help="Cartridge bay (default: 0)")
+    parser.add_argument("-s", "--baudrate", action="store", type=int, default=38400, help="Console speed (default: 38400)")
+    parser.add_argument("--prompt", action="store", default=DIAG_PROMPT.decode(), help="Console prompt (default: '%(default)s')")
+    parser.add_argument("--read-command", action="store", default=DIAG_READ_COMMAND, help="Dump command (default: '%(default)s')")
+    parser.add_argument("--write-command", action="store", default=DIAG_WRITE_COMMAND, help="Write command (default: '%(default)s')")
+    parser.add_argument("--error-prefix", action="store", default=DIAG_ERROR_PREFIX, help="Start of a console error line (default: '%(default)s')")
+    parser.add_argument("port", action="store", help="Diagnostic port (e.g. /dev/ttyUSB0)")
+    args = parser.parse_args()
+
+    m = manager.Manager(crypto.Desx_Crypto(), checksum.Crc16_Checksum())
+    machine_number = machine.get_number_from_type(args.machine_type)
+    eeprom_uid = bytes.fromhex(args.eeprom_uid)
+
+    bridge = DiagPortBridge(args.port, baudrate=args.baudrate, bay=args.bay, prompt=args.prompt.encode(),
+                            read_command=args.read_command, write_command=args.write_command,
+                            error_prefix=args.error_prefix)
+
+    try:
+        if not bridge.initialize():
+            print("ERROR: No response from diagnostic console")
+            sys.exit(1)
+
+        start = time.monotonic()
+
+        print("Reading cartridge...")
+        data = bridge.read(0, 0x71)
+        read_done = time.monotonic()
+
+        c = m.decode(machine_number, eeprom_uid, bytearray(data))
+        print(f"Material: {c.material_name}, current: {c.current_material_quantity:.2f} cu.in")
+
+        encoded = m.encode(machine_number, eeprom_uid, cartridge.refill(c))
+        encode_done = time.monotonic()
+
+        print("Writing cartridge...")
+        timings = bridge.write_verified(0, bytes(encoded))
+
+        print("Refill complete!")
+        print(f"  read:   {read_done - start:.2f}s")
+        print(f"  encode: {encode_done - read_done:.2f}s")
+        print(f"  write:  {timings['write']:.2f}s")
+        print(f"  verify: {timings['verify']:.2f}s")
+        print(f"  total:  {time.monotonic() - start:.2f}s")
+    except Exception as e:
+        print(f"ERROR: {str(e)}")
+        sys.exit(1)
+    finally:
+        bridge.close()
+
+    sys.exit(0)
+
+if __name__ == "__main__":
+    main()
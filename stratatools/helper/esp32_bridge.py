@@ -10,9 +10,51 @@ This module provides a Python interface to the ESP32-C3 firmware
 that handles 1-wire protocol operations for Stratasys cartridge programming.
 """
 
+import collections
+import logging
+import re
 import serial
 import time
 
+from stratatools.checksum import Crc16_Checksum
+from stratatools.helper.cycle_budget import parse_stats
+from stratatools.helper.cycle_timeline import parse_trace
+
+# Channel tags used once the firmware framing is enabled (MUX ON).
+# Each line is <tag><more><payload>, more is '+' (continued) or ':' (final).
+CHANNEL_CONTROL = 'C'
+CHANNEL_EVENT = 'E'
+CHANNEL_DATA = 'D'
+CHANNEL_LOG = 'L'
+CHANNELS = (CHANNEL_CONTROL, CHANNEL_EVENT, CHANNEL_DATA, CHANNEL_LOG)
+
+# Sequence-numbered events from the auto-refill firmware:
+# EVENT:<seq>@<boot id>:<millis>:<event>, replayed with
+# EVENTS <since> <boot id>. The boot id is random per power-up (older
+# firmware sends <seq> alone).
+EVENT_PREFIX = "EVENT:"
+EVENTS_END_PREFIX = "EVENTS_END:"
+
+def split_sequence(field):
+    """
+    Split "<seq>@<boot id>" (or a bare "<seq>")
+
+    Returns:
+        (seq, boot id) tuple, boot id is None from older firmware; (None,
+        None) if field is not a sequence number
+    """
+    seq, _, boot_id = field.partition("@")
+    if not seq.isdigit():
+        return (None, None)
+    return (int(seq), boot_id.lower() or None)
+
+# Contact score below which the firmware refuses writes (contact_quality.h)
+CONTACT_POOR_SCORE = 40
+
+# Unchanged bytes between two patches that are cheaper to resend than
+# starting a new <offset>:<hex> entry
+PATCH_MERGE_GAP = 2
+
 class ESP32Bridge:
     """
     Interface to ESP32-C3 1-Wire Bridge
@@ -21,7 +63,7 @@ class ESP32Bridge:
     an ESP32-C3 running the bridge firmware.
     """
 
-    def __init__(self, port="/dev/ttyUSB0", baudrate=115200, timeout=2):
+    def __init__(self, port="/dev/ttyUSB0", baudrate=115200, timeout=2, multiplex=True):
         """
         Initialize the ESP32 bridge connection
 
@@ -29,7 +71,24 @@ class ESP32Bridge:
             port: Serial port device path
             baudrate: Serial communication speed (default 115200)
             timeout: Read timeout in seconds
+            multiplex: Ask the firmware for tagged channel framing
+                       (falls back to the plain protocol on older firmware)
         """
+        self.log = logging.getLogger(__name__)
+        self.multiplex = multiplex
+        self.multiplexed = False
+        self.version = (1, 0)
+        self.events = collections.deque()
+        self.event_seq = 0
+        self.boot_id = None
+
+        # Last image read from or written to the current cartridge; the
+        # firmware (v1.2+) caches the same image, so writes only send changes
+        self.rom = None
+        self.image = None
+        self.logs = collections.deque(maxlen=256)
+        self._partial = {}
+
         self.serial = serial.Serial(port, baudrate, timeout=timeout)
 
         # Don't reset on connection - ESP32 may already be running
@@ -45,6 +104,118 @@ class ESP32Bridge:
         while self.serial.in_waiting:
             self.serial.readline()
 
+    def _read_message(self):
+        """
+        Read one complete message from the link
+
+        In multiplexed mode continuation frames are reassembled per
+        channel, so a data transfer interleaved with events comes back
+        as a single message.
+
+        Returns:
+            (channel, payload) tuple, or (None, "") on timeout
+        """
+        while True:
+            line = self.serial.readline()
+            if not line:
+                return (None, "")
+
+            line = line.decode('ascii', errors='ignore').rstrip("\r\n")
+
+            if not self.multiplexed:
+                return (CHANNEL_CONTROL, line.strip())
+
+            if len(line) < 2 or line[0] not in CHANNELS or line[1] not in "+:":
+                # Unframed output, e.g. the boot banner after a reset
+                self.log.debug(f"Unframed line: {line[:100]}")
+                continue
+
+            channel = line[0]
+            self._partial.setdefault(channel, []).append(line[2:])
+
+            if line[1] == "+":
+                continue
+
+            return (channel, "".join(self._partial.pop(channel)))
+
+    def _is_event(self, payload):
+        """Check whether a plain-protocol line is a notification"""
+        return payload.startswith("CARTRIDGE_") or payload.startswith(EVENT_PREFIX)
+
+    def _parse_event(self, payload):
+        """
+        Split a numbered event line
+
+        Returns:
+            (seq, boot id, event) tuple, seq is None for an unnumbered event
+        """
+        if payload.startswith(EVENT_PREFIX):
+            parts = payload.split(":", 3)
+            if len(parts) == 4:
+                seq, boot_id = split_sequence(parts[1])
+                if seq is not None:
+                    return (seq, boot_id, parts[3])
+        return (None, None, payload)
+
+    def _restarted(self, boot_id, seq):
+        """
+        Check whether the firmware restarted since the last event seen
+
+        A new boot id starts the sequence over; firmware without boot ids
+        only shows a restart by sending sequence 1 again.
+        """
+        if boot_id is None:
+            return seq == 1
+        if boot_id == self.boot_id:
+            return False
+
+        restarted = self.boot_id is not None
+        self.boot_id = boot_id
+        return restarted
+
+    def _accept_event(self, payload):
+        """
+        Strip the sequence header from a numbered event
+
+        Returns:
+            Event string, or None for an event that was already delivered
+        """
+        seq, boot_id, event = self._parse_event(payload)
+        if seq is not None:
+            if self._restarted(boot_id, seq):
+                self.event_seq = 0
+            if seq <= self.event_seq:
+                return None
+            self.event_seq = seq
+
+        self._presence_changed(event)
+        return event
+
+    def _presence_changed(self, event):
+        """
+        Drop the cached image when a cartridge comes or goes
+
+        A reinserted cartridge may have been written elsewhere, so the
+        next PATCH must not be diffed against what was read before.
+        """
+        if event.startswith("CARTRIDGE_"):
+            self.image = None
+
+    def _queue_event(self, payload):
+        event = self._accept_event(payload)
+        if event:
+            self.events.append(event)
+
+    def _dispatch(self, channel, payload):
+        """Route an out-of-band message to the event queue or log"""
+        if channel == CHANNEL_EVENT:
+            self._queue_event(payload)
+        elif channel == CHANNEL_LOG:
+            self.logs.append(payload)
+            self.log.debug(f"Device: {payload}")
+        else:
+            self.log.debug(f"Unsolicited response: {payload[:100]}")
+
     def _send_command(self, command):
         """
         Send a command to the ESP32
@@ -56,8 +227,18 @@ class ESP32Bridge:
             Response string from ESP32
         """
         self.serial.write((command + "\n").encode())
-        response = self.serial.readline().decode('ascii', errors='ignore').strip()
-        return response
+
+        while True:
+            channel, payload = self._read_message()
+            if channel is None:
+                return ""
+            if channel in (CHANNEL_CONTROL, CHANNEL_DATA):
+                if not self.multiplexed and self._is_event(payload):
+                    # A notification that raced the response
+                    self._queue_event(payload)
+                    continue
+                return payload
+            self._dispatch(channel, payload)
 
     def initialize(self):
         """
@@ -69,7 +250,14 @@ class ESP32Bridge:
         # Try multiple times in case ESP32 is still booting
         for attempt in range(3):
             response = self._send_command("VERSION")
-            if response and ("ESP32" in response or "1-Wire Bridge" in response or "v1.0" in response):
+            if response and ("ESP32" in response or "1-Wire Bridge" in response or "Auto-Refill" in response
+                             or "v1.0" in response):
+                m = re.search(r"v(\d+)\.(\d+)", response)
+                if m:
+                    self.version = (int(m.group(1)), int(m.group(2)))
+                if self.multiplex:
+                    # Older firmware answers "ERROR Unknown command"
+                    self.multiplexed = self._send_command("MUX ON") == "OK"
                 return True
             if attempt < 2:
                 time.sleep(0.5)
@@ -95,27 +283,46 @@ class ESP32Bridge:
         """
         response = self._send_command("SEARCH")
         if response.startswith("ROM:"):
-            return response[4:].strip()
+            rom = response[4:].strip()
+            if rom != self.rom:
+                self.rom = rom
+                self.image = None
+            return rom
         return None
 
-    def onewire_read(self, length):
+    def onewire_read(self, length, address=0):
         """
         Read data from the EEPROM
 
         Args:
             length: Number of bytes to read (up to 512)
+            address: Start address (firmware v1.1+; older firmware reads
+                     from 0 and the prefix is dropped here)
 
         Returns:
             bytes object containing the read data, or None on error
         """
-        if length > 512:
-            length = 512
+        if address + length > 512:
+            length = 512 - address
+
+        if address == 0:
+            command = f"READ {length}"
+            skip = 0
+        elif self.version >= (1, 1):
+            command = f"READ {length} {address}"
+            skip = 0
+        else:
+            command = f"READ {address + length}"
+            skip = address
 
-        response = self._send_command(f"READ {length}")
+        response = self._send_command(command)
         if response.startswith("DATA:"):
             hex_data = response[5:].strip()
             try:
-                return bytes.fromhex(hex_data)
+                data = bytes.fromhex(hex_data)[skip:]
+                if address == 0:
+                    self.image = data
+                return data
             except ValueError as e:
                 print(f"ERROR: Failed to parse hex data: {e}")
                 print(f"Response was: {response[:100]}")
@@ -137,13 +344,325 @@ class ESP32Bridge:
         if len(data) > 512:
             return False
 
+        data = bytes(data)
+        if self.version >= (1, 2) and self.image is not None and len(self.image) >= len(data):
+            if self._write_patches(data):
+                return True
+
         hex_data = data.hex()
         response = self._send_command(f"WRITE {len(data)} {hex_data}")
-        return response.startswith("OK")
+        if response.startswith("OK"):
+            self._written(data)
+            return True
+        self.image = None
+        return False
+
+    def _written(self, data):
+        """Update the cached image after data was written from address 0"""
+        if self.image is not None and len(self.image) > len(data):
+            self.image = data + self.image[len(data):]
+        else:
+            self.image = data
+
+    def _patches(self, data):
+        """Return (offset, bytes) runs where data differs from the cached image"""
+        patches = []
+        start = None
+        gap = 0
+        for i, (old, new) in enumerate(zip(self.image[:len(data)], data)):
+            if old != new:
+                if start is None:
+                    start = i
+                gap = 0
+            elif start is not None:
+                gap += 1
+                if gap > PATCH_MERGE_GAP:
+                    patches.append((start, data[start:i - gap + 1]))
+                    start = None
+        if start is not None:
+            patches.append((start, data[start:len(data) - gap]))
+        return patches
+
+    def _write_patches(self, data):
+        """
+        Write only the bytes that differ from the firmware's cached image
+
+        Returns:
+            True if written and verified; False if a full write is needed
+            (cache evicted, stale, or the patch failed)
+        """
+        crc = Crc16_Checksum().checksum(self.image[:len(data)])
+        entries = ",".join(f"{offset}:{chunk.hex()}" for offset, chunk in self._patches(data))
+        command = f"PATCH {len(data)} {crc:04x} {entries}".rstrip()
+
+        if len(command) >= len(data) * 2:
+            return False
+
+        response = self._send_command(command)
+        if response.startswith("OK"):
+            self._written(data)
+            return True
+
+        self.log.debug(f"Patch not applied ({response[:100]}), writing full image")
+        return False
+
+    def contact_quality(self):
+        """
+        Contact state of the cartridge in the socket (firmware v1.3+)
+
+        The firmware times every bus reset (presence pulse, pull-up rise)
+        and keeps a rolling score; below CONTACT_POOR_SCORE it refuses
+        writes until the cartridge is reseated.
+
+        Returns:
+            dict with "score" (0-100), "delay_us", "width_us", "rise_us",
+            "resets", "missed", "rom", "family"; None on older firmware
+        """
+        if self.version < (1, 3):
+            return None
+
+        response = self._send_command("STATUS")
+        if not response.startswith("STATUS:"):
+            return None
+
+        fields = dict(entry.split("=", 1) for entry in response[7:].split(",") if "=" in entry)
+        try:
+            return {
+                "rom": None if fields.get("ROM") == "NONE" else fields.get("ROM", "").lower(),
+                "family": fields.get("FAMILY"),
+                "score": int(fields["CONTACT"]),
+                "delay_us": int(fields["DELAY"]),
+                "width_us": int(fields["WIDTH"]),
+                "rise_us": int(fields["RISE"]),
+                "resets": int(fields["RESETS"]),
+                "missed": int(fields["MISSED"]),
+            }
+        except (KeyError, ValueError):
+            return None
+
+    def stats(self):
+        """
+        Per-command timings kept by the firmware (see cycle_budget.py)
+
+        Returns:
+            parse_stats() dict, None if the firmware doesn't answer STATS
+        """
+        response = self._send_command("STATS")
+        if not response.startswith("STATS:"):
+            return None
+        return parse_stats(response)
+
+    def trace(self, since=0):
+        """
+        Commands the firmware timed after sequence number since (v1.4+)
+
+        Returns:
+            (last_seq, entries) from parse_trace(), None on older firmware
+        """
+        if self.version < (1, 4):
+            return None
+
+        response = self._send_command(f"TRACE {since}")
+        if not response.startswith("TRACE:"):
+            return None
+        return parse_trace(response)
+
+    def queue_job(self, rom_address, data):
+        """
+        Stage an image to be written when the cartridge with this ROM is
+        inserted (the bridge writes and verifies it on its own)
+
+        Args:
+            rom_address: ROM address as hex string
+            data: bytes object to write (up to 512 bytes)
+
+        Returns:
+            Number of staged jobs, or None if the job was rejected
+        """
+        if len(data) > 512:
+            return None
+
+        response = self._send_command(f"JOB {rom_address} {len(data)} {bytes(data).hex()}")
+        if response.startswith("OK"):
+            return int(response.split()[1])
+        self.log.error(f"Job rejected: {response[:100]}")
+        return None
+
+    def job_status(self):
+        """
+        Returns:
+            (pending, completed) tuple: staged images and uncollected results
+        """
+        response = self._send_command("JOBS")
+        if not response.startswith("JOBS:"):
+            return (0, 0)
+        _, pending, completed = response.split(":")
+        return (int(pending), int(completed))
+
+    def clear_jobs(self):
+        """Drop all staged images and uncollected results"""
+        return self._send_command("JOBS CLEAR").startswith("OK")
+
+    def job_results(self):
+        """
+        Collect the outcomes of jobs run since the last call
+
+        Returns:
+            List of (rom_address, status) tuples, status is "OK",
+            "WRITE_FAILED", "VERIFY_FAILED" or "BACKUP_FAILED"
+        """
+        response = self._send_command("RESULTS")
+        if not response.startswith("RESULTS:"):
+            return []
+        return [tuple(entry.split("=", 1)) for entry in response[8:].split(",") if entry]
+
+    def job_backups(self, since=0):
+        """
+        Images cartridges held before the bridge ran their jobs (the bridge
+        keeps the last few in RAM)
+
+        Args:
+            since: Only backups after this sequence number
+
+        Returns:
+            (last sequence number, [(seq, millis, rom, image), ...]), as
+            PicoStation.backups(); None on older firmware
+        """
+        if self.version < (1, 5):
+            return None
+
+        records = []
+        while True:
+            parts = self._send_command(f"BACKUP {since}").split(":")
+            if parts[0] != "BACKUP" or len(parts) not in (2, 5):
+                return None
+            if len(parts) == 2:
+                return (int(parts[1]), records)
+
+            since = int(parts[1])
+            records.append((since, int(parts[2]), parts[3].lower(), bytes.fromhex(parts[4])))
+
+    def next_event(self, timeout=0.1):
+        """
+        Wait for the next cartridge notification
+
+        Works with both framings: in multiplexed mode events come from
+        the event channel, otherwise any CARTRIDGE_* line is an event.
+
+        Args:
+            timeout: Seconds to wait if no event is already queued
+
+        Returns:
+            Event string (e.g. "CARTRIDGE_INSERTED:2362474d0100006b") or None
+        """
+        if self.events:
+            return self.events.popleft()
+
+        old_timeout = self.serial.timeout
+        self.serial.timeout = timeout
+        try:
+            while not self.events:
+                channel, payload = self._read_message()
+                if channel is None:
+                    break
+
+                if self.multiplexed:
+                    self._dispatch(channel, payload)
+                elif self._is_event(payload):
+                    self._queue_event(payload)
+                elif payload:
+                    self.logs.append(payload)
+        finally:
+            self.serial.timeout = old_timeout
+
+        return self.events.popleft() if self.events else None
+
+    def catch_up_events(self):
+        """
+        Fetch the events the firmware recorded since the last one seen
+
+        Used after (re)connecting: notifications sent while nobody was
+        listening are still in the firmware's event ring. Live events that
+        arrive meanwhile stay queued for next_event().
+
+        Returns:
+            List of replayed event strings, oldest first ([] if the
+            firmware keeps no event ring)
+        """
+        # Firmware that restarted since ignores a since from another boot
+        since = f"{self.event_seq} {self.boot_id}" if self.boot_id else f"{self.event_seq}"
+        self.serial.write(f"EVENTS {since}\n".encode())
+
+        replayed = []
+        seen = set()
+        while True:
+            channel, payload = self._read_message()
+            if channel is None or payload.startswith("ERROR"):
+                # Firmware without an event ring
+                return replayed
+
+            if payload.startswith(EVENTS_END_PREFIX):
+                seq, boot_id = split_sequence(payload[len(EVENTS_END_PREFIX):])
+                self.event_seq = seq or 0
+                self.boot_id = boot_id or self.boot_id
+                return replayed
+
+            seq, boot_id, event = self._parse_event(payload)
+            if seq is not None:
+                if seq not in seen:
+                    seen.add(seq)
+                    replayed.append(event)
+                    self._presence_changed(event)
+            elif self.multiplexed and channel != CHANNEL_CONTROL:
+                self._dispatch(channel, payload)
+            elif self._is_event(payload):
+                self._presence_changed(payload)
+                self.events.append(payload)
+
+    def notify_status(self, status):
+        """
+        Send a status notification (REFILLING, REFILL_DONE:..., ERROR:...)
+
+        Firmware that drives status LEDs acknowledges with one line; it is
+        consumed here so it cannot be mistaken for the next response.
+        """
+        return self._send_command(status)
+
+    def debug(self):
+        """
+        Run the firmware DEBUG command
+
+        Returns:
+            Multi-line diagnostic output
+        """
+        if self.multiplexed:
+            # Output arrives on the log channel, terminated by OK
+            self.logs.clear()
+            self._send_command("DEBUG")
+            output = "\n".join(self.logs)
+            self.logs.clear()
+            return output
+
+        # Plain protocol: collect lines until the link goes quiet
+        self.serial.write(b"DEBUG\n")
+        lines = []
+        while True:
+            line = self.serial.readline()
+            if not line:
+                break
+            lines.append(line.decode('ascii', errors='ignore').rstrip())
+        return "\n".join(lines)
 
     def close(self):
         """Close the serial connection"""
         if self.serial and self.serial.is_open:
+            if self.multiplexed:
+                # Leave the firmware in plain mode for the next client
+                try:
+                    self._send_command("MUX OFF")
+                except serial.SerialException:
+                    pass
+                self.multiplexed = False
             self.serial.close()
 
     def __del__(self):
@@ -0,0 +1,261 @@
+import unittest
+from unittest import mock
+
+from stratatools.helper.esp32_bridge import ESP32Bridge
+
+class FakeSerial:
+    def __init__(self, lines):
+        self.lines = [l.encode() + b"\n" for l in lines]
+        self.written = b""
+        self.timeout = 2
+        self.is_open = True
+
+    @property
+    def in_waiting(self):
+        return len(self.lines)
+
+    def write(self, data):
+        self.written += data
+
+    def readline(self):
+        return self.lines.pop(0) if self.lines else b""
+
+    def close(self):
+        self.is_open = False
+
+def make_bridge(lines, multiplexed=True):
+    with mock.patch("serial.Serial", return_value=FakeSerial([])), mock.patch("time.sleep"):
+        bridge = ESP32Bridge()
+    bridge.serial = FakeSerial(lines)
+    bridge.multiplexed = multiplexed
+    return bridge
+
+class TestESP32BridgeMux(unittest.TestCase):
+    def test_data_reassembled_around_events(self):
+        bridge = make_bridge([
+            "D+DATA:0001",
+            "E:CARTRIDGE_INSERTED:2362474d0100006b",
+            "L:noise",
+            "D:0203",
+        ])
+
+        assert bridge.onewire_read(4) == b"\x00\x01\x02\x03"
+        assert bridge.next_event(timeout=0) == "CARTRIDGE_INSERTED:2362474d0100006b"
+        assert list(bridge.logs) == ["noise"]
+
+    def test_unframed_lines_are_not_responses(self):
+        bridge = make_bridge(["Ready", "C:ROM:2362474d0100006b"])
+
+        assert bridge.onewire_macro_search() == "2362474d0100006b"
+
+    def test_plain_protocol_events(self):
+        bridge = make_bridge(["Cartridge removed", "CARTRIDGE_INSERTED:11010a01ba325d23"], multiplexed=False)
+
+        assert bridge.next_event(timeout=0) == "CARTRIDGE_INSERTED:11010a01ba325d23"
+        assert bridge.next_event(timeout=0) is None
+
+class TestESP32BridgeRead(unittest.TestCase):
+    def test_ranged_read(self):
+        bridge = make_bridge(["DATA:0a0b"], multiplexed=False)
+        bridge.version = (1, 1)
+
+        assert bridge.onewire_read(2, 0x58) == b"\x0a\x0b"
+        assert bridge.serial.written == b"READ 2 88\n"
+
+    def test_ranged_read_old_firmware(self):
+        bridge = make_bridge(["DATA:00010a0b"], multiplexed=False)
+
+        assert bridge.onewire_read(2, 2) == b"\x0a\x0b"
+        assert bridge.serial.written == b"READ 4\n"
+
+class TestESP32BridgeEvents(unittest.TestCase):
+    def test_numbered_events(self):
+        bridge = make_bridge([
+            "EVENT:4:1200:CARTRIDGE_INSERTED:2362474d0100006b",
+            "EVENT:4:1200:CARTRIDGE_INSERTED:2362474d0100006b",
+            "EVENT:1:80:CARTRIDGE_REMOVED:2362474d0100006b",
+        ], multiplexed=False)
+
+        assert bridge.next_event(timeout=0) == "CARTRIDGE_INSERTED:2362474d0100006b"
+        # Duplicate dropped; sequence 1 after a restart is accepted
+        assert bridge.next_event(timeout=0) == "CARTRIDGE_REMOVED:2362474d0100006b"
+        assert bridge.event_seq == 1
+
+    def test_boot_id_restarts_sequence(self):
+        bridge = make_bridge([
+            "EVENT:7@5f0c93a1:1200:CARTRIDGE_INSERTED:2362474d0100006b",
+            "EVENT:7@5f0c93a1:1200:CARTRIDGE_INSERTED:2362474d0100006b",
+            "EVENT:3@0be21c44:80:CARTRIDGE_REMOVED:2362474d0100006b",
+        ], multiplexed=False)
+
+        assert bridge.next_event(timeout=0) == "CARTRIDGE_INSERTED:2362474d0100006b"
+        # Duplicate dropped; a lower sequence from a new boot is accepted
+        assert bridge.next_event(timeout=0) == "CARTRIDGE_REMOVED:2362474d0100006b"
+        assert (bridge.event_seq, bridge.boot_id) == (3, "0be21c44")
+
+    def test_catch_up_names_boot(self):
+        bridge = make_bridge([
+            "EVENT:1@0be21c44:50:CARTRIDGE_INSERTED:2362474d0100006b",
+            "EVENTS_END:1@0be21c44",
+        ], multiplexed=False)
+        bridge.event_seq = 9
+        bridge.boot_id = "5f0c93a1"
+
+        assert bridge.catch_up_events() == ["CARTRIDGE_INSERTED:2362474d0100006b"]
+        assert bridge.serial.written == b"EVENTS 9 5f0c93a1\n"
+        assert (bridge.event_seq, bridge.boot_id) == (1, "0be21c44")
+
+    def test_event_racing_response(self):
+        bridge = make_bridge(["EVENT:2:500:CARTRIDGE_INSERTED:2362474d0100006b", "ROM:2362474d0100006b"],
+                             multiplexed=False)
+
+        assert bridge.onewire_macro_search() == "2362474d0100006b"
+        assert bridge.next_event(timeout=0) == "CARTRIDGE_INSERTED:2362474d0100006b"
+
+    def test_catch_up(self):
+        bridge = make_bridge([
+            "EVENT:6:9000:CARTRIDGE_REMOVED:2362474d0100006b",
+            "EVENT:6:9000:CARTRIDGE_REMOVED:2362474d0100006b",
+            "EVENT:7:9500:CARTRIDGE_INSERTED:11010a01ba325d23",
+            "EVENTS_END:7",
+        ], multiplexed=False)
+        bridge.event_seq = 5
+
+        assert bridge.catch_up_events() == [
+            "CARTRIDGE_REMOVED:2362474d0100006b",
+            "CARTRIDGE_INSERTED:11010a01ba325d23",
+        ]
+        assert bridge.serial.written == b"EVENTS 5\n"
+        assert bridge.event_seq == 7
+
+    def test_catch_up_without_event_ring(self):
+        bridge = make_bridge(["ERROR Unknown command"], multiplexed=False)
+
+        assert bridge.catch_up_events() == []
+        assert bridge.event_seq == 0
+
+class TestESP32BridgeJobs(unittest.TestCase):
+    def test_queue_job(self):
+        bridge = make_bridge(["OK 3"], multiplexed=False)
+
+        assert bridge.queue_job("2362474d0100006b", b"\x01\x02") == 3
+        assert bridge.serial.written == b"JOB 2362474d0100006b 2 0102\n"
+
+    def test_job_results(self):
+        bridge = make_bridge(["C:RESULTS:2362474d0100006b=OK,11010a01ba325d23=VERIFY_FAILED"])
+
+        assert bridge.job_results() == [("2362474d0100006b", "OK"), ("11010a01ba325d23", "VERIFY_FAILED")]
+
+    def test_job_backups(self):
+        bridge = make_bridge(["D+BACKUP:3:1200:2362474D0100006B:0001", "D:0203", "D:BACKUP:4:1300:11010a01ba325d23:ff",
+                              "C:BACKUP:4"])
+        bridge.version = (1, 5)
+
+        assert bridge.job_backups(2) == (4, [(3, 1200, "2362474d0100006b", b"\x00\x01\x02\x03"),
+                                             (4, 1300, "11010a01ba325d23", b"\xff")])
+        assert bridge.serial.written == b"BACKUP 2\nBACKUP 3\nBACKUP 4\n"
+
+    def test_job_backups_old_firmware(self):
+        bridge = make_bridge([])
+        bridge.version = (1, 4)
+        assert bridge.job_backups() is None
+
+    def test_no_job_results(self):
+        bridge = make_bridge(["RESULTS:"], multiplexed=False)
+
+        assert bridge.job_results() == []
+
+class TestESP32BridgePatch(unittest.TestCase):
+    def setUp(self):
+        self.image = bytes(range(256)) * 2
+        self.bridge = make_bridge(["ROM:2362474d0100006b", "DATA:" + self.image.hex()], multiplexed=False)
+        self.bridge.version = (1, 2)
+        self.bridge.onewire_macro_search()
+        self.bridge.onewire_read(512)
+        self.bridge.serial.written = b""
+
+    def test_patches(self):
+        data = bytearray(self.image)
+        data[0x58:0x5a] = b"\xff\xff"
+        data[0x5c] = 0xff
+        data[0x100] = 0xee
+
+        assert self.bridge._patches(bytes(data)) == [(0x58, bytes(data[0x58:0x5d])), (0x100, b"\xee")]
+
+    def test_patch_write(self):
+        data = bytearray(self.image)
+        data[0x58] = 0xff
+        self.bridge.serial.lines = [b"OK\n"]
+
+        assert self.bridge.onewire_write(bytes(data))
+        assert self.bridge.serial.written == b"PATCH 512 4631 88:ff\n"
+        assert self.bridge.image == bytes(data)
+
+    def test_falls_back_to_full_write(self):
+        data = bytearray(self.image)
+        data[0] = 0xff
+        self.bridge.serial.lines = [b"ERROR No cached image, READ first\n", b"OK\n"]
+
+        assert self.bridge.onewire_write(bytes(data))
+        commands = self.bridge.serial.written.split(b"\n")
+        assert commands[0] == b"PATCH 512 4631 0:ff"
+        assert commands[1].startswith(b"WRITE 512 ff01")
+
+    def test_patch_shorter_than_read(self):
+        data = bytearray(self.image[:0x71])
+        data[0x58] = 0xff
+        self.bridge.serial.lines = [b"OK\n"]
+
+        assert self.bridge.onewire_write(bytes(data))
+        assert self.bridge.serial.written.startswith(b"PATCH 113 ")
+        assert self.bridge.serial.written.endswith(b" 88:ff\n")
+        assert self.bridge.image == bytes(data) + self.image[0x71:]
+
+    def test_presence_change_drops_image(self):
+        self.bridge.serial.lines = [b"EVENT:3:900:CARTRIDGE_INSERTED:2362474d0100006b\n", b"OK\n"]
+        assert self.bridge.next_event(timeout=0) == "CARTRIDGE_INSERTED:2362474d0100006b"
+        assert self.bridge.image is None
+        assert self.bridge.onewire_write(self.image[:0x71])
+        assert self.bridge.serial.written.startswith(b"WRITE 113 ")
+
+    def test_large_change_written_in_full(self):
+        self.bridge.serial.lines = [b"OK\n"]
+
+        assert self.bridge.onewire_write(bytes(512))
+        assert self.bridge.serial.written.startswith(b"WRITE 512 ")
+
+class TestESP32BridgeContact(unittest.TestCase):
+    def test_contact_quality(self):
+        bridge = make_bridge(["STATUS:ROM=2362474D0100006B,FAMILY=DS2433,CONTACT=57,DELAY=31,WIDTH=118,"
+                              "RISE=7,RESETS=40,MISSED=2"], multiplexed=False)
+        bridge.version = (1, 3)
+
+        contact = bridge.contact_quality()
+        assert contact["score"] == 57
+        assert contact["rom"] == "2362474d0100006b"
+        assert contact["rise_us"] == 7
+        assert bridge.serial.written == b"STATUS\n"
+
+    def test_contact_quality_old_firmware(self):
+        bridge = make_bridge([], multiplexed=False)
+        bridge.version = (1, 2)
+
+        assert bridge.contact_quality() is None
+        assert bridge.serial.written == b""
+
+class TestESP32BridgeTimings(unittest.TestCase):
+    def test_trace(self):
+        bridge = make_bridge(["TRACE:9:8=READ/1200/310000/512,9=SEARCH/1600/12000/0"], multiplexed=False)
+        bridge.version = (1, 4)
+
+        last_seq, entries = bridge.trace(7)
+        assert last_seq == 9
+        assert [e["op"] for e in entries] == ["READ", "SEARCH"]
+        assert bridge.serial.written == b"TRACE 7\n"
+
+    def test_trace_old_firmware(self):
+        bridge = make_bridge([], multiplexed=False)
+        bridge.version = (1, 3)
+
+        assert bridge.trace() is None
+        assert bridge.serial.written == b""
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2024, ESP32-C3 Bridge Support
+# All rights reserved.
+
+"""
+Stage EEPROM images on the ESP32 Bridge
+
+Uploads encoded images keyed by ROM address. The bridge writes and
+verifies each one by itself as soon as the matching cartridge is
+inserted, so a crate of cartridges goes as fast as they can be swapped.
+Results are collected in batches until every job is done.
+
+The bridge reads each cartridge before writing it and keeps the last few
+of those images in RAM; they are fetched along with the results and
+saved as job_backups/<rom>-<seq>.bin (firmware v1.5+).
+
+Each image file is named after the ROM address of its cartridge, e.g.
+2362474d0100006b.bin.
+
+Usage:
+    stratatools_esp32_jobs /dev/ttyUSB0 images/*.bin
+"""
+
+import os
+import sys
+import time
+from stratatools.helper.control_socket import open_bridge
+
+# Seconds between result collections
+POLL_INTERVAL = 2.0
+
+# Where the bridge's pre-job images are saved
+BACKUP_DIR = "job_backups"
+
+def rom_from_filename(path):
+    """Return the ROM address an image file is named after, or None"""
+    rom = os.path.splitext(os.path.basename(path))[0].lower()
+    try:
+        if len(bytes.fromhex(rom)) == 8:
+            return rom
+    except ValueError:
+        pass
+    return None
+
+def save_backups(bridge, since):
+    """
+    Save the bridge's backups after since, never overwriting a file
+
+    Returns:
+        Sequence number to pass next time
+    """
+    result = bridge.job_backups(since)
+    if result is not None and result[0] < since:
+        # The bridge restarted and numbers its backups from 1 again
+        result = bridge.job_backups(0)
+    if result is None:
+        return since
+
+    last_seq, records = result
+    for seq, _, rom, image in records:
+        os.makedirs(BACKUP_DIR, exist_ok=True)
+        path = os.path.join(BACKUP_DIR, f"{rom}-{seq}.bin")
+        n = 1
+        while os.path.exists(path):
+            path = os.path.join(BACKUP_DIR, f"{rom}-{seq}-{n}.bin")
+            n += 1
+        with open(path, "wb") as f:
+            f.write(image)
+        print(f"{rom}: previous image saved to {path}")
+    return last_seq
+
+def main():
+    if len(sys.argv) < 3:
+        print("usage: esp32_jobs.py <serial port> <rom>.bin [<rom>.bin ...]")
+        sys.exit(1)
+
+    port = sys.argv[1]
+
+    images = {}
+    for path in sys.argv[2:]:
+        rom = rom_from_filename(path)
+        if rom is None:
+            print(f"ERROR: {path} is not named after a ROM address")
+            sys.exit(1)
+        with open(path, "rb") as f:
+            images[rom] = f.read()
+
+    remaining = set(images)
+    bridge = None
+
+    try:
+        # Connect to ESP32 bridge (through the refill daemon if it owns the port)
+        print(f"Connecting to ESP32 on {port}...")
+        bridge = open_bridge(port, timeout=2)
+
+        if not bridge.initialize():
+            print("ERROR: Failed to initialize ESP32 bridge")
+            sys.exit(1)
+
+        # Only backups of this run's jobs
+        backups = bridge.job_backups()
+        backup_seq = backups[0] if backups else 0
+        if backups is None:
+            print("WARNING: Bridge firmware keeps no pre-job backups (v1.5+ does)")
+
+        for rom, data in images.items():
+            if bridge.queue_job(rom, data) is None:
+                print(f"ERROR: Bridge rejected job for {rom} (queue full?)")
+                bridge.close()
+                sys.exit(1)
+            print(f"Staged {len(data)} bytes for {rom}")
+
+        print(f"{len(images)} job(s) staged - insert the cartridges, Ctrl+C to stop waiting")
+
+        while remaining:
+            time.sleep(POLL_INTERVAL)
+            results = bridge.job_results()
+            backup_seq = save_backups(bridge, backup_seq)
+            for rom, status in results:
+                print(f"{rom}: {status}")
+                # A failed job stays staged and is retried on reinsertion
+                if status == "OK":
+                    remaining.discard(rom)
+
+        bridge.close()
+        print("All jobs done!")
+        sys.exit(0)
+
+    except KeyboardInterrupt:
+        print(f"\n{len(remaining)} job(s) still staged on the bridge")
+        if bridge:
+            bridge.close()
+        sys.exit(1)
+
+    except Exception as e:
+        print(f"ERROR: {str(e)}")
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -14,7 +14,7 @@ Usage:
 """
 
 import sys
-from stratatools.helper.esp32_bridge import ESP32Bridge
+from stratatools.helper.control_socket import open_bridge
 
 def main():
     if len(sys.argv) != 3:
@@ -25,9 +25,9 @@ def main():
     output_file = sys.argv[2]
 
     try:
-        # Connect to ESP32 bridge
+        # Connect to ESP32 bridge (through the refill daemon if it owns the port)
         print(f"Connecting to ESP32 on {port}...")
-        bridge = ESP32Bridge(port=port, timeout=2)
+        bridge = open_bridge(port, timeout=2)
 
         # Verify connection
         if not bridge.initialize():
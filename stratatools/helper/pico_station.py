@@ -0,0 +1,490 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Pico 2 Multi-Socket Station
+
+A Pico 2 running the multi-socket firmware (pico2_autorefill, environment
+pico2_multi) services up to eight cartridges, each socket on its own PIO
+1-Wire engine. Commands and replies for a socket carry its number, so
+transfers on different sockets overlap on the one USB link:
+
+    host:     3:READ 512
+    host:     5:SEARCH
+    firmware: 5:ROM:2362474d0100006b
+    firmware: EVENT:12@5f0c93a1:84211:6:CARTRIDGE_INSERTED:11010a01ba325d23
+    firmware: 3:DATA:0102...
+
+PicoStation owns the serial port. A reader thread routes each reply to
+the socket that asked and each event to the socket it names.
+station.socket(n) returns a SocketBridge with the ESP32Bridge methods the
+refill daemon uses, so every socket is driven like a bridge of its own.
+The daemon addresses sockets as "<port>#<n>" ("<port>#0-7" for a range).
+
+station.backups() fetches the images the station saved before each write
+(see pico2_autorefill/src/backup_log.h).
+"""
+
+import collections
+import logging
+import queue
+import re
+import serial
+import threading
+import time
+
+from stratatools.helper.esp32_bridge import EVENT_PREFIX, EVENTS_END_PREFIX, split_sequence
+
+MAX_SOCKETS = 8
+
+# "<port>#<n>" selects one socket of a station
+SOCKET_SEPARATOR = "#"
+
+BACKUP_PREFIX = "BACKUP:"
+BACKUPS_END_PREFIX = "BACKUPS_END:"
+
+# Seconds to wait for the whole backup log
+BACKUPS_TIMEOUT = 60
+
+_SOCKET_REPLY = re.compile(r"^(\d):(.*)$")
+
+# VERSION reply (the boot banner, "Stratasys Multi-Socket Auto-Refill
+# v1.2", goes to the log)
+_VERSION_REPLY = re.compile(r"^Pico2 Multi-Socket Auto-Refill v\d")
+
+def split_port(port):
+    """
+    Split "<port>#<n>"
+
+    Returns:
+        (serial port, socket number), socket number is None for a plain port
+    """
+    device, separator, socket_number = port.rpartition(SOCKET_SEPARATOR)
+    if not separator or not socket_number.isdigit():
+        return (port, None)
+    return (device, int(socket_number))
+
+def expand_ports(ports):
+    """Expand "<port>#<first>-<last>" into one entry per socket"""
+    expanded = []
+    for port in ports:
+        m = re.match(r"^(.*)#(\d)-(\d)$", port)
+        if m:
+            expanded.extend(f"{m.group(1)}{SOCKET_SEPARATOR}{n}"
+                            for n in range(int(m.group(2)), int(m.group(3)) + 1))
+        else:
+            expanded.append(port)
+    return expanded
+
+class PicoStation:
+    """
+    Shared serial link to a multi-socket station
+    """
+
+    def __init__(self, port, baudrate=115200, timeout=5, link=None):
+        """
+        Args:
+            port: Serial port device path
+            baudrate: Serial communication speed
+            timeout: Seconds to wait for a reply
+            link: Already open serial object (tests)
+        """
+        self.log = logging.getLogger(__name__)
+        self.port = port
+        self.timeout = timeout
+        self.serial = link or serial.Serial(port, baudrate, timeout=0.1)
+
+        self.write_lock = threading.Lock()
+        self.replies = [queue.Queue() for _ in range(MAX_SOCKETS)]
+        self.control = queue.Queue()
+        self.backup_lines = queue.Queue()
+        self.logs = collections.deque(maxlen=256)
+
+        # Live events per socket; replayed ones are kept apart until each
+        # open socket collects them with catch_up_events()
+        self.events = [collections.deque() for _ in range(MAX_SOCKETS)]
+        self.event_ready = threading.Condition()
+        self.event_seq = 0
+        self.boot_id = None
+        self.replay = None
+        self.replayed = None
+
+        self.version = None
+        self.socket_count = 0
+        self.open_sockets = set()
+        self.error = None
+        self.closed = False
+
+        self.reader = threading.Thread(target=self._read_loop, daemon=True)
+        self.reader.start()
+
+    def _read_loop(self):
+        while not self.closed:
+            try:
+                line = self.serial.readline()
+            except (serial.SerialException, OSError) as e:
+                self.error = e
+                break
+
+            if line:
+                self._route(line.decode('ascii', errors='ignore').strip())
+
+        # Wake everything waiting on the link
+        with self.event_ready:
+            self.event_ready.notify_all()
+
+    def _route(self, line):
+        if line.startswith(EVENT_PREFIX):
+            parts = line.split(":", 4)
+            if len(parts) == 5 and parts[3].isdigit():
+                seq, boot_id = split_sequence(parts[1])
+                if seq is not None:
+                    self._event(seq, boot_id, int(parts[3]), parts[4])
+            return
+
+        if line.startswith(BACKUP_PREFIX):
+            self.backup_lines.put(line[len(BACKUP_PREFIX):])
+            return
+
+        if line.startswith((EVENTS_END_PREFIX, BACKUPS_END_PREFIX)):
+            self.control.put(line)
+            return
+
+        m = _SOCKET_REPLY.match(line)
+        if m:
+            self.replies[int(m.group(1))].put(m.group(2))
+        elif line.startswith(("SOCKETS:", "ERROR")) or line == "OK" or _VERSION_REPLY.match(line):
+            self.control.put(line)
+        elif line:
+            # Boot banner, STATUS output (which ends with "Last event:")
+            self.logs.append(line)
+            if line.startswith("Last event:"):
+                self.control.put(line)
+
+    def _event(self, seq, boot_id, socket_number, event):
+        with self.event_ready:
+            if self.replay is not None:
+                self.replay.append((seq, socket_number, event))
+                return
+
+            # A new boot id (or, from older firmware, sequence 1 again)
+            # means the station restarted
+            if boot_id is None:
+                restarted = seq == 1
+            else:
+                restarted = self.boot_id is not None and boot_id != self.boot_id
+                self.boot_id = boot_id
+            if restarted:
+                self.event_seq = 0
+
+            if seq <= self.event_seq:
+                return
+            self.event_seq = seq
+
+            if socket_number < MAX_SOCKETS:
+                self.events[socket_number].append(event)
+                self.event_ready.notify_all()
+
+    def _write(self, line):
+        if self.error:
+            raise serial.SerialException(f"{self.port}: {self.error}")
+        with self.write_lock:
+            self.serial.write((line + "\n").encode())
+
+    def command(self, line, timeout=None):
+        """Send a station command, returns its reply ("" on timeout)"""
+        while not self.control.empty():
+            self.control.get_nowait()
+
+        self._write(line)
+        try:
+            return self.control.get(timeout=timeout or self.timeout)
+        except queue.Empty:
+            return ""
+
+    def socket_command(self, socket_number, line):
+        """Send a command to one socket, returns its reply ("" on timeout)"""
+        replies = self.replies[socket_number]
+        while not replies.empty():
+            replies.get_nowait()
+
+        self._write(f"{socket_number}:{line}")
+        try:
+            return replies.get(timeout=self.timeout)
+        except queue.Empty:
+            if self.error:
+                raise serial.SerialException(f"{self.port}: {self.error}")
+            return ""
+
+    def initialize(self):
+        """
+        Check the firmware and read the socket count (once per link)
+
+        Returns:
+            True if a multi-socket station answered
+        """
+        if self.version is not None:
+            return True
+
+        for attempt in range(3):
+            response = self.command("VERSION")
+            if "Multi-Socket" in response:
+                m = re.search(r"v(\d+)\.(\d+)", response)
+                self.version = (int(m.group(1)), int(m.group(2))) if m else (1, 0)
+
+                sockets = self.command("SOCKETS")
+                if sockets.startswith("SOCKETS:"):
+                    self.socket_count = int(sockets.split(":")[1])
+                return True
+            if attempt < 2:
+                time.sleep(0.5)
+
+        return False
+
+    def catch_up(self):
+        """
+        Fetch events recorded since the last one seen and set them aside
+        for each open socket (see SocketBridge.catch_up_events)
+
+        Replays for sockets that haven't collected their share yet are
+        kept; a socket that reconnects later triggers a new replay.
+        """
+        with self.event_ready:
+            self.replay = []
+
+        # A station that restarted since ignores a since from another boot
+        since = f"{self.event_seq} {self.boot_id}" if self.boot_id else f"{self.event_seq}"
+        try:
+            end = self.command(f"EVENTS {since}")
+        finally:
+            with self.event_ready:
+                replay, self.replay = self.replay, None
+
+        if self.replayed is None:
+            self.replayed = {}
+        for socket_number in self.open_sockets:
+            self.replayed.setdefault(socket_number, [])
+        if not end.startswith(EVENTS_END_PREFIX):
+            return
+
+        seen = set()
+        for seq, socket_number, event in replay:
+            if seq not in seen and socket_number in self.replayed:
+                seen.add(seq)
+                self.replayed[socket_number].append(event)
+        seq, boot_id = split_sequence(end[len(EVENTS_END_PREFIX):])
+        self.event_seq = seq or 0
+        self.boot_id = boot_id or self.boot_id
+
+    def backups(self, since=0):
+        """
+        Images saved by the station before each write
+
+        Args:
+            since: Only records after this sequence number
+
+        Returns:
+            (last sequence number, [(seq, millis, rom, image), ...]),
+            None if the station didn't answer
+        """
+        while not self.backup_lines.empty():
+            self.backup_lines.get_nowait()
+
+        # The records arrive before the end line
+        end = self.command(f"BACKUPS {since}", timeout=BACKUPS_TIMEOUT)
+        if not end.startswith(BACKUPS_END_PREFIX):
+            return None
+
+        records = []
+        while not self.backup_lines.empty():
+            parts = self.backup_lines.get_nowait().split(":")
+            try:
+                records.append((int(parts[0]), int(parts[1]), parts[2].lower(), bytes.fromhex(parts[3])))
+            except (IndexError, ValueError):
+                self.log.error(f"{self.port}: bad backup record")
+        return (int(end[len(BACKUPS_END_PREFIX):]), records)
+
+    def clear_backups(self):
+        return self.command("BACKUPS CLEAR") == "OK"
+
+    def next_event(self, socket_number, timeout):
+        with self.event_ready:
+            # Events for other sockets wake every waiter; keep waiting
+            events = self.events[socket_number]
+            self.event_ready.wait_for(lambda: events or self.error or self.closed, timeout)
+            if self.error and not events:
+                raise serial.SerialException(f"{self.port}: {self.error}")
+            return events.popleft() if events else None
+
+    def socket(self, socket_number):
+        """Per-socket bridge view"""
+        self.open_sockets.add(socket_number)
+        return SocketBridge(self, socket_number)
+
+    def release(self, socket_number):
+        """Close the link once no socket uses it"""
+        self.open_sockets.discard(socket_number)
+        if not self.open_sockets:
+            self.close()
+
+    def close(self):
+        self.closed = True
+        if self.serial and self.serial.is_open:
+            self.serial.close()
+
+class SocketBridge:
+    """
+    One socket of a PicoStation, with the ESP32Bridge interface
+    """
+
+    def __init__(self, station, socket_number):
+        self.station = station
+        self.socket_number = socket_number
+        self.log = station.log
+        self.rom = None
+        self.image = None
+        self.resume_boot_id = None
+
+    @property
+    def events(self):
+        return self.station.events[self.socket_number]
+
+    @property
+    def event_seq(self):
+        return self.station.event_seq
+
+    @event_seq.setter
+    def event_seq(self, seq):
+        # The sockets share the station's sequence; never go back, and
+        # ignore a sequence number from another boot (set boot_id first)
+        if self.resume_boot_id in (None, self.station.boot_id):
+            self.station.event_seq = max(self.station.event_seq, seq)
+
+    @property
+    def boot_id(self):
+        return self.station.boot_id
+
+    @boot_id.setter
+    def boot_id(self, boot_id):
+        # Resuming: the link may already have seen a newer boot
+        self.resume_boot_id = boot_id
+        if self.station.boot_id is None:
+            self.station.boot_id = boot_id
+
+    def _command(self, line):
+        return self.station.socket_command(self.socket_number, line)
+
+    def _clear_buffer(self):
+        """Nothing to clear - kept for ESP32Bridge compatibility"""
+        pass
+
+    def initialize(self):
+        return self.station.initialize() and self.socket_number < self.station.socket_count
+
+    def onewire_reset_bus(self):
+        return self._command("RESET").startswith("OK")
+
+    def onewire_macro_search(self):
+        response = self._command("SEARCH")
+        if response.startswith("ROM:"):
+            rom = response[4:].strip()
+            if rom != self.rom:
+                self.rom = rom
+                self.image = None
+            return rom
+        return None
+
+    def onewire_search(self):
+        return self.onewire_macro_search()
+
+    def onewire_read(self, length, address=0):
+        if address + length > 512:
+            length = 512 - address
+
+        response = self._command(f"READ {length} {address}")
+        if not response.startswith("DATA:"):
+            self.log.error(f"Socket {self.socket_number} read failed: {response[:100]}")
+            return None
+
+        try:
+            data = bytes.fromhex(response[5:].strip())
+        except ValueError as e:
+            self.log.error(f"Socket {self.socket_number} returned bad data: {e}")
+            return None
+
+        if address == 0:
+            self.image = data
+        return data
+
+    def onewire_write(self, data):
+        if len(data) > 512:
+            return False
+
+        data = bytes(data)
+        if self._command(f"WRITE {len(data)} {data.hex()}").startswith("OK"):
+            self.image = data
+            return True
+        self.image = None
+        return False
+
+    # Staged jobs are an ESP32 bridge feature; answer like firmware
+    # without a job queue
+    def queue_job(self, rom_address, data):
+        return None
+
+    def job_status(self):
+        return (0, 0)
+
+    def clear_jobs(self):
+        return False
+
+    def job_results(self):
+        return []
+
+    # The PIO engine doesn't time the presence pulse
+    def contact_quality(self):
+        return None
+
+    # Nor does the station keep command timings
+    def stats(self):
+        return None
+
+    def trace(self, since=0):
+        return None
+
+    def next_event(self, timeout=0.1):
+        return self.station.next_event(self.socket_number, timeout)
+
+    def catch_up_events(self):
+        """
+        Events recorded for this socket since the last one seen
+
+        The station replays its ring for all open sockets at once; each
+        then collects its share. Once every share is collected the next
+        catch-up (after a socket reconnects) asks the station again.
+        """
+        station = self.station
+        with station.event_ready:
+            replayed = station.replayed
+        if replayed is None or self.socket_number not in replayed:
+            station.catch_up()
+
+        with station.event_ready:
+            events = station.replayed.pop(self.socket_number, [])
+            if not station.replayed:
+                station.replayed = None
+        return events
+
+    def notify_status(self, status):
+        return self._command(status)
+
+    def debug(self):
+        self.station.logs.clear()
+        self.station.command("STATUS")
+        return "\n".join(self.station.logs)
+
+    def close(self):
+        self.station.release(self.socket_number)
@@ -0,0 +1,183 @@
+import queue
+import threading
+import unittest
+
+from stratatools.helper.pico_station import PicoStation, split_port, expand_ports
+
+class FakeLink:
+    """Serial link to a scripted station: replies[command] is sent on write"""
+
+    def __init__(self, replies=None):
+        self.replies = replies or {}
+        self.incoming = queue.Queue()
+        self.written = []
+        self.is_open = True
+
+    def write(self, data):
+        for line in data.decode().splitlines():
+            self.written.append(line)
+            for reply in self.replies.get(line, []):
+                self.send(reply)
+
+    def send(self, line):
+        self.incoming.put((line + "\n").encode())
+
+    def readline(self):
+        try:
+            return self.incoming.get(timeout=0.02)
+        except queue.Empty:
+            return b""
+
+    def close(self):
+        self.is_open = False
+
+def make_station(replies=None):
+    link = FakeLink(replies)
+    return PicoStation("/dev/ttyACM0", timeout=2, link=link), link
+
+class TestPorts(unittest.TestCase):
+    def test_split_port(self):
+        assert split_port("/dev/ttyACM0#3") == ("/dev/ttyACM0", 3)
+        assert split_port("COM4") == ("COM4", None)
+
+    def test_expand_ports(self):
+        assert expand_ports(["/dev/ttyACM0#0-2", "COM4"]) == [
+            "/dev/ttyACM0#0", "/dev/ttyACM0#1", "/dev/ttyACM0#2", "COM4"]
+
+class TestPicoStation(unittest.TestCase):
+    def tearDown(self):
+        self.station.close()
+
+    def test_initialize(self):
+        self.station, link = make_station({
+            "VERSION": ["Pico2 Multi-Socket Auto-Refill v1.1"],
+            "SOCKETS": ["SOCKETS:8:00100000"],
+        })
+
+        assert self.station.socket(2).initialize()
+        assert self.station.socket_count == 8
+        assert not self.station.socket(9).initialize()
+
+    def test_overlapping_transfers(self):
+        # Socket 3's read is still running when socket 5 answers
+        self.station, link = make_station({
+            "5:SEARCH": ["5:ROM:2362474d0100006b", "3:DATA:0a0b"],
+        })
+        read = {}
+
+        reader = threading.Thread(target=lambda: read.update(data=self.station.socket(3).onewire_read(2)))
+        reader.start()
+        while "3:READ 2 0" not in link.written:
+            pass
+
+        assert self.station.socket(5).onewire_macro_search() == "2362474d0100006b"
+        reader.join()
+        assert read["data"] == b"\x0a\x0b"
+
+    def test_socket_error(self):
+        self.station, link = make_station({"1:WRITE 1 ff": ["1:ERROR Verify failed"]})
+
+        assert not self.station.socket(1).onewire_write(b"\xff")
+
+    def test_events_routed_by_socket(self):
+        self.station, link = make_station()
+        link.send("EVENT:4:1200:2:CARTRIDGE_INSERTED:2362474d0100006b")
+        link.send("EVENT:4:1200:2:CARTRIDGE_INSERTED:2362474d0100006b")
+        link.send("EVENT:5:1300:6:REFILL_DONE:SUCCESS")
+
+        assert self.station.socket(2).next_event(timeout=1) == "CARTRIDGE_INSERTED:2362474d0100006b"
+        assert self.station.socket(6).next_event(timeout=1) == "REFILL_DONE:SUCCESS"
+        # Duplicate dropped
+        assert self.station.socket(2).next_event(timeout=0.1) is None
+        assert self.station.event_seq == 5
+
+    def test_boot_id_restarts_sequence(self):
+        self.station, link = make_station()
+        link.send("EVENT:9@5f0c93a1:1200:2:CARTRIDGE_INSERTED:2362474d0100006b")
+        link.send("EVENT:2@0be21c44:60:2:CARTRIDGE_REMOVED:2362474d0100006b")
+
+        assert self.station.socket(2).next_event(timeout=1) == "CARTRIDGE_INSERTED:2362474d0100006b"
+        assert self.station.socket(2).next_event(timeout=1) == "CARTRIDGE_REMOVED:2362474d0100006b"
+        assert (self.station.event_seq, self.station.boot_id) == (2, "0be21c44")
+
+    def test_resume_from_another_boot(self):
+        self.station, link = make_station()
+        link.send("EVENT:1@0be21c44:60:3:CARTRIDGE_INSERTED:2362474d0100006b")
+        socket3 = self.station.socket(3)
+        assert socket3.next_event(timeout=1) == "CARTRIDGE_INSERTED:2362474d0100006b"
+
+        # The daemon remembers sequence 40 from before the restart
+        socket3.boot_id = "5f0c93a1"
+        socket3.event_seq = 40
+        assert self.station.event_seq == 1
+
+    def test_catch_up_per_socket(self):
+        self.station, link = make_station({"EVENTS 5": [
+            "EVENT:6:9000:1:CARTRIDGE_REMOVED:2362474d0100006b",
+            "EVENT:7:9500:4:CARTRIDGE_INSERTED:11010a01ba325d23",
+            "EVENTS_END:7",
+        ]})
+        socket1 = self.station.socket(1)
+        socket4 = self.station.socket(4)
+        socket4.event_seq = 5
+
+        assert socket4.catch_up_events() == ["CARTRIDGE_INSERTED:11010a01ba325d23"]
+        assert socket1.catch_up_events() == ["CARTRIDGE_REMOVED:2362474d0100006b"]
+        assert link.written == ["EVENTS 5"]
+        assert socket1.event_seq == 7
+
+    def test_catch_up_after_reconnect(self):
+        self.station, link = make_station({
+            "EVENTS 0": ["EVENTS_END:3"],
+            "EVENTS 3": ["EVENT:4:9000:2:CARTRIDGE_INSERTED:2362474d0100006b", "EVENTS_END:4"],
+        })
+        socket2 = self.station.socket(2)
+        socket5 = self.station.socket(5)
+
+        assert socket2.catch_up_events() == []
+        assert socket5.catch_up_events() == []
+        assert self.station.replayed is None
+        socket2.close()
+
+        # The same socket opened again asks the station again
+        assert self.station.socket(2).catch_up_events() == ["CARTRIDGE_INSERTED:2362474d0100006b"]
+        assert link.written == ["EVENTS 0", "EVENTS 3"]
+
+    def test_banner_not_taken_as_reply(self):
+        self.station, link = make_station({"VERSION": ["Pico2 Multi-Socket Auto-Refill v1.2"]})
+        link.send("Stratasys Multi-Socket Auto-Refill v1.2")
+
+        while "Stratasys Multi-Socket Auto-Refill v1.2" not in self.station.logs:
+            pass
+        assert self.station.command("VERSION") == "Pico2 Multi-Socket Auto-Refill v1.2"
+
+    def test_event_waits_for_own_socket(self):
+        self.station, link = make_station()
+        socket3 = self.station.socket(3)
+        link.send("EVENT:1:100:5:CARTRIDGE_INSERTED:11010a01ba325d23")
+        threading.Timer(0.2, link.send, ["EVENT:2:300:3:CARTRIDGE_INSERTED:2362474d0100006b"]).start()
+
+        assert socket3.next_event(timeout=2) == "CARTRIDGE_INSERTED:2362474d0100006b"
+
+    def test_backups(self):
+        self.station, link = make_station({"BACKUPS 3": [
+            "BACKUP:4:1200:2362474D0100006B:00FF",
+            "0:ROM:11010a01ba325d23",
+            "BACKUP:5:1300:11010a01ba325d23:0102",
+            "BACKUPS_END:5",
+        ], "BACKUPS CLEAR": ["OK"]})
+
+        last, records = self.station.backups(3)
+        assert last == 5
+        assert records == [(4, 1200, "2362474d0100006b", b"\x00\xff"),
+                           (5, 1300, "11010a01ba325d23", b"\x01\x02")]
+        assert self.station.clear_backups()
+
+    def test_link_closed_with_last_socket(self):
+        self.station, link = make_station()
+        sockets = [self.station.socket(0), self.station.socket(1)]
+
+        sockets[0].close()
+        assert link.is_open
+        sockets[1].close()
+        assert not link.is_open
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Fetch Pre-Refill Backups from a Multi-Socket Station
+
+The station keeps the image each cartridge held before every write. This
+saves them as <rom>-<seq>.bin, ready to be written back with
+stratatools_esp32_write (port "<port>#<n>"). The last sequence number
+fetched is kept in the output directory, so a later run only fetches the
+new backups. The tool opens the serial port itself: stop the refill
+daemon first.
+
+Usage:
+    stratatools_station_backups /dev/ttyACM0 backups/
+    stratatools_station_backups /dev/ttyACM0 backups/ --all --clear
+"""
+
+import argparse
+import os
+import sys
+
+from stratatools.helper.pico_station import PicoStation
+
+# Last sequence number fetched into a directory
+LAST_SEQ_FILE = ".last_seq"
+
+def read_last_seq(directory):
+    try:
+        with open(os.path.join(directory, LAST_SEQ_FILE)) as f:
+            return int(f.read().strip())
+    except (OSError, ValueError):
+        return 0
+
+def save_records(directory, records):
+    """Write each record as <rom>-<seq>.bin, returns the paths"""
+    paths = []
+    for seq, _, rom, image in records:
+        path = os.path.join(directory, f"{rom}-{seq}.bin")
+        with open(path, "wb") as f:
+            f.write(image)
+        paths.append(path)
+    return paths
+
+def main():
+    parser = argparse.ArgumentParser(description="Fetch pre-refill backups from a multi-socket station")
+    parser.add_argument("port", help="Serial port of the station (no #socket suffix)")
+    parser.add_argument("directory", help="Where to save the images")
+    parser.add_argument("--all", action="store_true", help="Fetch every backup, not only new ones")
+    parser.add_argument("--clear", action="store_true", help="Delete the station's log once saved")
+    args = parser.parse_args()
+
+    os.makedirs(args.directory, exist_ok=True)
+    since = 0 if args.all else read_last_seq(args.directory)
+
+    station = None
+    try:
+        print(f"Connecting to station on {args.port}...")
+        station = PicoStation(args.port)
+
+        if not station.initialize():
+            print("ERROR: No multi-socket station answered")
+            sys.exit(1)
+
+        result = station.backups(since)
+        if result is None:
+            print("ERROR: Station did not send its backup log")
+            sys.exit(1)
+
+        last_seq, records = result
+        for path in save_records(args.directory, records):
+            print(f"Saved {path}")
+        print(f"{len(records)} backup(s) fetched")
+
+        with open(os.path.join(args.directory, LAST_SEQ_FILE), "w") as f:
+            f.write(f"{last_seq}\n")
+
+        if args.clear:
+            print("Backup log cleared" if station.clear_backups() else "ERROR: Failed to clear the backup log")
+
+        station.close()
+        sys.exit(0)
+
+    except Exception as e:
+        print(f"ERROR: {str(e)}")
+        if station:
+            station.close()
+        sys.exit(1)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+
+#
+# See the LICENSE file
+#
+
+"""
+Station Metadata
+
+The cartridge record only uses 0x00-0x70 of a DS2433. A refill station
+can keep a small block of its own in the last page (0x1E0-0x1FF), so the
+next station learns the machine type and refill history from the
+cartridge itself instead of an index lookup or a trial decode:
+
+    offset : len
+    0x00   : 0x02 - Magic "SM"
+    0x02   : 0x01 - Format version (1)
+    0x03   : 0x01 - Machine type (MACHINE_CODES)
+    0x04   : 0x02 - Refill count (uint16)
+    0x06   : 0x08 - Station that refilled last (ASCII, zero padded)
+    0x0E   : 0x10 - Digest of the record written (SHA-256, truncated)
+    0x1E   : 0x02 - CRC16 of the EEPROM UID and 0x00-0x1D
+
+The UID is part of the CRC, so a block copied along with an image from
+another cartridge does not validate. The digest only matches until the
+printer updates the record; a mismatch means the cartridge was used
+since its last refill.
+
+The block is one whole page, so with delta writes (PATCH) it costs a
+single extra page program on top of the record's own pages.
+"""
+
+import hashlib
+import struct
+
+from stratatools.checksum import Crc16_Checksum
+
+METADATA_ADDRESS = 0x1E0
+METADATA_SIZE = 0x20
+
+# Bytes of the image the printer owns (see manager.py)
+RECORD_SIZE = 0x71
+
+MAGIC = b"SM"
+FORMAT_VERSION = 1
+
+# Stable one-byte codes: append only
+MACHINE_CODES = ("fox", "fox2", "ktype", "prodigy", "quantum", "uprint", "uprintse")
+
+# Families with a spare page at METADATA_ADDRESS (DS2433, DS28EC20)
+FAMILIES = (0x23, 0x43)
+
+STATION_SIZE = 8
+DIGEST_SIZE = 16
+
+_LAYOUT = "<2sBBH8s16s"
+
+def fits(rom_address):
+    """True if the cartridge EEPROM has room for the block"""
+    try:
+        return int(rom_address[:2], 16) in FAMILIES
+    except ValueError:
+        return False
+
+def record_digest(image):
+    """Digest of the cartridge record part of an image"""
+    return hashlib.sha256(bytes(image[:RECORD_SIZE])).digest()[:DIGEST_SIZE]
+
+class StationMetadata:
+    """
+    Machine type, refill count, last station and record digest
+    """
+
+    def __init__(self, machine_type, refills=0, station="", digest=bytes(DIGEST_SIZE)):
+        self.machine_type = machine_type
+        self.refills = refills
+        self.station = station
+        self.digest = digest
+
+    @classmethod
+    def for_refill(cls, previous, machine_type, station, image):
+        """Block to write along with a refilled image"""
+        refills = previous.refills + 1 if previous else 1
+        return cls(machine_type, min(refills, 0xFFFF), station, record_digest(image))
+
+    def matches(self, image):
+        """True if the record is still the one this block was written with"""
+        return self.digest == record_digest(image)
+
+    def pack(self, eeprom_uid):
+        """
+        Args:
+            eeprom_uid: ROM address (bytes)
+
+        Returns:
+            The METADATA_SIZE bytes to write at METADATA_ADDRESS
+        """
+        block = bytearray(METADATA_SIZE)
+        struct.pack_into(_LAYOUT, block, 0,
+                         MAGIC,
+                         FORMAT_VERSION,
+                         MACHINE_CODES.index(self.machine_type),
+                         self.refills,
+                         self.station.encode("ascii", errors="replace")[:STATION_SIZE],
+                         self.digest)
+        struct.pack_into("<H", block, METADATA_SIZE - 2,
+                         Crc16_Checksum().checksum(bytes(eeprom_uid) + block[:METADATA_SIZE - 2]))
+        return bytes(block)
+
+    @classmethod
+    def unpack(cls, eeprom_uid, block):
+        """
+        Args:
+            eeprom_uid: ROM address (bytes)
+            block: The bytes at METADATA_ADDRESS (a whole image is accepted)
+
+        Returns:
+            StationMetadata, or None if there is no valid block
+        """
+        if len(block) >= METADATA_ADDRESS + METADATA_SIZE:
+            block = block[METADATA_ADDRESS:METADATA_ADDRESS + METADATA_SIZE]
+        block = bytes(block)
+        if len(block) != METADATA_SIZE:
+            return None
+
+        crc = struct.unpack_from("<H", block, METADATA_SIZE - 2)[0]
+        if Crc16_Checksum().checksum(bytes(eeprom_uid) + block[:METADATA_SIZE - 2]) != crc:
+            return None
+
+        magic, version, code, refills, station, digest = struct.unpack_from(_LAYOUT, block, 0)
+        if magic != MAGIC or version != FORMAT_VERSION or code >= len(MACHINE_CODES):
+            return None
+
+        return cls(MACHINE_CODES[code], refills, station.rstrip(b"\x00").decode("ascii", errors="replace"), digest)
+
+    def __repr__(self):
+        return (f"StationMetadata({self.machine_type}, refills={self.refills}, "
+                f"station={self.station!r}, digest={self.digest.hex()})")
@@ -0,0 +1,55 @@
+import unittest
+
+from stratatools.helper.station_metadata import (StationMetadata, METADATA_ADDRESS, METADATA_SIZE,
+                                                 fits, record_digest)
+
+UID = bytes.fromhex("2362474d0100006b")
+
+class TestStationMetadata(unittest.TestCase):
+    def test_pack_unpack(self):
+        image = bytes(range(256)) * 2
+        meta = StationMetadata("prodigy", 3, "station-a", record_digest(image))
+        block = meta.pack(UID)
+        assert len(block) == METADATA_SIZE
+
+        back = StationMetadata.unpack(UID, block)
+        assert back.machine_type == "prodigy"
+        assert back.refills == 3
+        assert back.station == "station-"  # truncated to 8 characters
+        assert back.matches(image)
+
+        # A whole image is accepted too
+        full = bytearray(image)
+        full[METADATA_ADDRESS:] = block
+        assert StationMetadata.unpack(UID, full).machine_type == "prodigy"
+
+    def test_invalid(self):
+        block = StationMetadata("fox", 1, "a").pack(UID)
+
+        assert StationMetadata.unpack(UID, bytes(METADATA_SIZE)) is None
+        assert StationMetadata.unpack(UID, b"\xff" * METADATA_SIZE) is None
+
+        # Bound to the cartridge it was written to
+        assert StationMetadata.unpack(bytes.fromhex("2362474d0100006c"), block) is None
+
+        corrupt = bytearray(block)
+        corrupt[4] ^= 1
+        assert StationMetadata.unpack(UID, corrupt) is None
+
+    def test_for_refill(self):
+        image = bytearray(512)
+        first = StationMetadata.for_refill(None, "fox", "a", image)
+        assert first.refills == 1
+
+        second = StationMetadata.for_refill(first, "fox", "b", image)
+        assert second.refills == 2
+        assert second.station == "b"
+
+        # The printer used the cartridge: the record no longer matches
+        image[0x58] ^= 0xFF
+        assert not second.matches(image)
+
+    def test_fits(self):
+        assert fits("2362474d0100006b")
+        assert fits("43000000000000aa")
+        assert not fits("2d00000000000011")
@@ -7,7 +7,10 @@ import struct
 import time
 
 from . import cartridge_pb2
+from . import codec
 from . import material
+from .checksum import Crc16_Checksum
+from .crypto import Desx_Crypto
 
 #
 # CartridgeManager is used to create, encrypt and decrypt Stratasys cartridge
@@ -33,11 +36,19 @@ from . import material
 #       15 0x58: 0x10 - unknown, looks like DEX IV, but why?
 #       16 0x48: 0x10 - ^
 
+# Key fragment, key CRC and current material quantity with its CRCs:
+# the only bytes needed to learn how much material is left
+QUANTITY_BLOCK_START = 0x48
+QUANTITY_BLOCK_END = 0x64
+
 class Manager:
     def __init__(self, crypto, checksum):
         self.crypto = crypto
         self.checksum = checksum
 
+        # The native codec implements exactly this pair
+        self.native = codec.NATIVE and type(crypto) is Desx_Crypto and type(checksum) is Crc16_Checksum
+
     #
     # Encode a cartridge object into a data that can be burn onto a cartridge
     #
@@ -54,6 +65,61 @@ class Manager:
         cartridge = self.unpack(cartridge_packed)
         return cartridge
 
+    #
+    # Decode several eeproms at once
+    #
+    # items is a list of (machine_number, eeprom_uid, cartridge_crypted);
+    # returns a cartridge object, or the exception it failed with, per item.
+    # With the native codec the decryption runs on its worker pool, outside
+    # the GIL (threads=0: one thread per core).
+    #
+    def decode_batch(self, items, threads=0):
+        if self.native:
+            decrypted = codec.decrypt_batch(items, threads)
+        else:
+            decrypted = []
+            for machine_number, eeprom_uid, cartridge_crypted in items:
+                try:
+                    decrypted.append(self.decrypt(machine_number, eeprom_uid, bytearray(cartridge_crypted)))
+                except Exception as e:
+                    decrypted.append(e)
+
+        cartridges = []
+        for cartridge_packed in decrypted:
+            if isinstance(cartridge_packed, Exception):
+                cartridges.append(cartridge_packed)
+                continue
+            try:
+                cartridges.append(self.unpack(cartridge_packed))
+            except Exception as e:
+                cartridges.append(e)
+        return cartridges
+
+    #
+    # Decode only the current material quantity
+    #
+    # quantity_block holds the EEPROM bytes from QUANTITY_BLOCK_START to
+    # QUANTITY_BLOCK_END, so a reader can skip the rest of the EEPROM
+    #
+    def decode_quantity(self, machine_number, eeprom_uid, quantity_block):
+        block = bytearray(quantity_block)
+
+        def offset(address):
+            return address - QUANTITY_BLOCK_START
+
+        # Validate crypted current material quantity checksum
+        if self.checksum.checksum(block[offset(0x58):offset(0x60)]) != struct.unpack_from("<H", block, offset(0x60))[0]:
+            raise Exception("invalid current material quantity checksum")
+
+        key = self.build_key(block[offset(0x48):offset(0x50)], machine_number, eeprom_uid)
+        quantity = self.crypto.decrypt(key, block[offset(0x58):offset(0x60)])
+
+        # A wrong machine type decrypts to garbage and fails here
+        if self.checksum.checksum(quantity) != struct.unpack_from("<H", block, offset(0x62))[0]:
+            raise Exception("invalid current material quantity checksum")
+
+        return struct.unpack("<d", bytes(quantity))[0]
+
     #
     # Pack a cartridge into a format suitable to be encrypted then burn
     # onto the cartridge EEPROM
@@ -200,6 +266,14 @@ class Manager:
     # Decrypt a crypted cartridge into a packed cartridge
     #
     def decrypt(self, machine_number, eeprom_uid, cartridge_crypted):
+        # Same checks and result in native code, without holding the GIL
+        if self.native:
+            cartridge_packed = codec.decrypt(machine_number, eeprom_uid, cartridge_crypted)
+            if isinstance(cartridge_crypted, bytearray):
+                cartridge_crypted[:] = cartridge_packed
+                return cartridge_crypted
+            return cartridge_packed
+
         cartridge_packed = cartridge_crypted
 
         # Validate key fragment checksum
@@ -1,7 +1,7 @@
 import binascii
 import unittest
 
-from stratatools.manager import Manager
+from stratatools.manager import Manager, QUANTITY_BLOCK_START, QUANTITY_BLOCK_END
 from stratatools.crypto import Desx_Crypto
 from stratatools.cartridge_pb2 import Cartridge
 from stratatools.checksum import Crc16_Checksum
@@ -55,3 +55,21 @@ class TestManager(unittest.TestCase):
         unpacked_cartridge = manager.unpack(manager.pack(expected_cartridge))
 
         assert expected_cartridge == unpacked_cartridge
+
+    def test_decode_quantity(self):
+        cartridge = Cartridge()
+        Merge(CARTRIDGE_TEXT, cartridge)
+
+        crypto = Desx_Crypto()
+        checksum = Crc16_Checksum()
+        manager = Manager(crypto, checksum)
+
+        machine_number = binascii.unhexlify("5394D7657CED641D")
+        eeprom_uid = binascii.unhexlify("2362474d0100006b")
+        eeprom = manager.encode(machine_number, eeprom_uid, cartridge)
+        block = eeprom[QUANTITY_BLOCK_START:QUANTITY_BLOCK_END]
+
+        self.assertAlmostEqual(22.2, manager.decode_quantity(machine_number, eeprom_uid, block), places=5)
+
+        with self.assertRaises(Exception):
+            manager.decode_quantity(binascii.unhexlify("F3A91DBE6B0B2255"), eeprom_uid, block)